@@ -0,0 +1,453 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "Stats.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#define STEG_POSIX 1
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#if defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter)
+#define STEG_IO_URING 1
+#endif
+#endif
+
+/**
+ * @file AsyncIO.h
+ * @brief Reads, writes and fsyncs of files completed in the background [io_uring]
+ * @details Operations are queued by one thread [the coordinator of the batch pipeline] and their completions are
+ *          collected with wait(). Other threads report the end of their work with post(), it wakes wait() as
+ *          a completion does. The ring is set up with raw system calls, liburing is not needed.
+ *          Without io_uring [other systems, old kernels, seccomp] every operation runs synchronously when it is
+ *          queued, callers do not see the difference. A ring the kernel stops accepting [io_uring_enter fails
+ *          for good] is given up the same way: operations it has not taken run synchronously from then on.
+ */
+
+namespace aio {
+
+    /// Result of an operation [bytes transferred, 0 for fsync, -errno on failure] or of post()
+    struct Completion {
+        uint64_t tag = 0;
+        int64_t result = 0;
+    };
+
+    /**
+     * @class Ring
+     * @brief Queue of file operations of a single coordinating thread
+     * @var
+     * <b>operations</b> -> queued operations, index of an operation is its io_uring user_data<br>
+     * <b>queued</b> -> operations waiting for a free submission entry<br>
+     * <b>ready</b> -> completions not handed out by wait() yet<br>
+     * <b>posted</b> -> completions posted by other threads [guarded by lock]<br>
+     * <b>failure</b> -> errno of the io_uring_enter that made the ring be given up, 0 while it is used
+     * @details Reads and writes always transfer the whole range: short transfers and EINTR/EAGAIN are submitted
+     *          again, a read stops early only at the end of the file. Buffers have to live until the completion.
+     * @attention read(), write(), fsync() and wait() are called from one thread, post() from any thread
+     */
+
+    class Ring {
+    public:
+        explicit Ring(unsigned entries) {
+#if defined(STEG_IO_URING)
+            setup(entries);
+#else
+            (void)entries;
+#endif
+        }
+
+        Ring(const Ring&) = delete;
+        auto operator=(const Ring&) -> Ring& = delete;
+
+        ~Ring() {
+#if defined(STEG_IO_URING)
+            teardown();
+#endif
+        }
+
+        /// Checking whether operations go through io_uring [false -> they run synchronously]
+        auto native() const -> bool { return ringDescriptor >= 0 && failure.load(std::memory_order_relaxed) == 0; }
+
+        auto read(int descriptor, void* data, std::size_t size, uint64_t offset, uint64_t tag) -> void {
+            queue({Kind::Read, descriptor, static_cast<unsigned char*>(data), size, offset, tag});
+        }
+
+        auto write(int descriptor, const void* data, std::size_t size, uint64_t offset, uint64_t tag) -> void {
+            queue({Kind::Write, descriptor, const_cast<unsigned char*>(static_cast<const unsigned char*>(data)), size,
+                   offset, tag});
+        }
+
+        auto fsync(int descriptor, uint64_t tag) -> void {
+            queue({Kind::Fsync, descriptor, nullptr, 0, 0, tag});
+        }
+
+        /// Reporting a completion from another thread [end of work done outside of the ring]
+        auto post(uint64_t tag, int64_t result) -> void {
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                posted.push_back({tag, result});
+            }
+#if defined(STEG_IO_URING)
+            if (native()) {
+                uint64_t one = 1;
+                while (::write(eventDescriptor, &one, sizeof(one)) < 0 && errno == EINTR) {}
+                return;
+            }
+#endif
+            wakeup.notify_one();
+        }
+
+        /**
+         * @brief Submitting queued operations and waiting for completions
+         * @function wait
+         * @param done -> completions, at least one of them [replaced]<br>
+         * @attention Caller makes sure a completion is coming [an operation in flight or a post() to come]
+         */
+
+        auto wait(std::vector<Completion>& done) -> void {
+            done.clear();
+#if defined(STEG_IO_URING)
+            if (native()) {
+                while (native() && ready.empty() && !takePosted(ready)) {
+                    if (submit(true)) reap();
+                }
+                if (native()) submit(false);
+            }
+            if (!native() && ringDescriptor >= 0) drain();
+#endif
+            if (ready.empty()) {
+                std::unique_lock<std::mutex> guard(lock);
+                wakeup.wait(guard, [this] { return !posted.empty(); });
+            }
+            takePosted(ready);
+            done.swap(ready);
+        }
+
+    private:
+        enum class Kind : uint8_t { Read, Write, Fsync };
+
+        struct Operation {
+            Kind kind = Kind::Read;
+            int descriptor = -1;
+            unsigned char* data = nullptr;
+            std::size_t size = 0;
+            uint64_t offset = 0;
+            uint64_t tag = 0;
+            std::size_t done = 0;
+            std::chrono::steady_clock::time_point started{};
+        };
+
+        /// user_data of the read of the eventfd waking the ring on post()
+        static constexpr uint64_t wakeTag = ~uint64_t{0};
+
+        std::vector<Operation> operations;
+        std::vector<unsigned> freeOperations;
+        std::deque<unsigned> queued;
+        std::vector<Completion> ready;
+        std::vector<Completion> posted;
+        std::mutex lock;
+        std::condition_variable wakeup;
+        std::atomic<int> failure{0};
+        int ringDescriptor = -1;
+
+        auto takePosted(std::vector<Completion>& target) -> bool {
+            std::lock_guard<std::mutex> guard(lock);
+            if (posted.empty()) return false;
+            target.insert(target.end(), posted.begin(), posted.end());
+            posted.clear();
+            return true;
+        }
+
+        auto queue(const Operation& operation) -> void {
+#if defined(STEG_IO_URING)
+            if (native()) {
+                unsigned index = static_cast<unsigned>(operations.size());
+                if (!freeOperations.empty()) {
+                    index = freeOperations.back();
+                    freeOperations.pop_back();
+                    operations[index] = operation;
+                } else {
+                    operations.push_back(operation);
+                }
+                queued.push_back(index);
+                return;
+            }
+#endif
+            ready.push_back({operation.tag, runNow(operation)});
+        }
+
+        /// Running the operation synchronously [no io_uring]
+        static auto runNow(const Operation& operation) -> int64_t {
+#if defined(STEG_POSIX)
+            if (operation.kind == Kind::Fsync) {
+                stats::Timer timer(stats::Phase::Fsync);
+                return ::fsync(operation.descriptor) == 0 ? 0 : -errno;
+            }
+            std::size_t done = operation.done;
+            while (done < operation.size) {
+                ssize_t count = operation.kind == Kind::Read
+                    ? ::pread(operation.descriptor, operation.data + done, operation.size - done,
+                              static_cast<off_t>(operation.offset + done))
+                    : ::pwrite(operation.descriptor, operation.data + done, operation.size - done,
+                               static_cast<off_t>(operation.offset + done));
+                if (count < 0 && errno == EINTR) continue;
+                if (count < 0) return -errno;
+                if (count == 0) break;
+                done += static_cast<std::size_t>(count);
+            }
+            finished(operation.kind, done);
+            return static_cast<int64_t>(done);
+#else
+            (void)operation;
+            return -ENOSYS;
+#endif
+        }
+
+        static auto finished(Kind kind, std::size_t bytes) -> void {
+            if (kind == Kind::Read) stats::addRead(bytes);
+            else if (kind == Kind::Write) stats::addWritten(bytes);
+        }
+
+#if defined(STEG_IO_URING)
+        int eventDescriptor = -1;
+        uint64_t eventValue = 0;
+        bool armed = false;
+        unsigned submitted = 0;
+
+        /// Refusals of io_uring_enter [EAGAIN/EBUSY] in a row before the ring is given up, 1 ms apart
+        static constexpr unsigned maxRefusals = 64;
+
+        void* sqMapping = MAP_FAILED;
+        void* cqMapping = MAP_FAILED;
+        std::size_t sqMappingSize = 0;
+        std::size_t cqMappingSize = 0;
+        io_uring_sqe* sqes = nullptr;
+        std::size_t sqesSize = 0;
+        unsigned sqEntries = 0;
+        unsigned* sqHead = nullptr;
+        unsigned* sqTail = nullptr;
+        unsigned* sqMask = nullptr;
+        unsigned* sqArray = nullptr;
+        unsigned* cqHead = nullptr;
+        unsigned* cqTail = nullptr;
+        unsigned* cqMask = nullptr;
+        io_uring_cqe* cqes = nullptr;
+
+        /// Mapping rings of a new io_uring instance, nothing is kept when any step fails [synchronous mode]
+        auto setup(unsigned entries) -> void {
+            io_uring_params params{};
+            int descriptor = static_cast<int>(::syscall(__NR_io_uring_setup, entries, &params));
+            if (descriptor < 0) return;
+            sqMappingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+            cqMappingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+            const bool single = params.features & IORING_FEAT_SINGLE_MMAP;
+            if (single) sqMappingSize = cqMappingSize = std::max(sqMappingSize, cqMappingSize);
+            sqMapping = ::mmap(nullptr, sqMappingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, descriptor,
+                               IORING_OFF_SQ_RING);
+            cqMapping = single ? sqMapping
+                               : ::mmap(nullptr, cqMappingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                                        descriptor, IORING_OFF_CQ_RING);
+            sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+            void* sqeMapping = ::mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, descriptor,
+                                      IORING_OFF_SQES);
+            eventDescriptor = ::eventfd(0, EFD_CLOEXEC);
+            if (sqMapping == MAP_FAILED || cqMapping == MAP_FAILED || sqeMapping == MAP_FAILED || eventDescriptor < 0) {
+                if (sqeMapping != MAP_FAILED) ::munmap(sqeMapping, sqesSize);
+                ringDescriptor = descriptor;
+                unmap();
+                return;
+            }
+            ringDescriptor = descriptor;
+            auto* sq = static_cast<unsigned char*>(sqMapping);
+            auto* cq = static_cast<unsigned char*>(cqMapping);
+            sqes = static_cast<io_uring_sqe*>(sqeMapping);
+            sqEntries = params.sq_entries;
+            sqHead = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+            sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+            sqMask = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+            sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+            cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+            cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+            cqMask = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+            cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+        }
+
+        auto unmap() -> void {
+            if (sqes) ::munmap(sqes, sqesSize);
+            if (cqMapping != MAP_FAILED && cqMapping != sqMapping) ::munmap(cqMapping, cqMappingSize);
+            if (sqMapping != MAP_FAILED) ::munmap(sqMapping, sqMappingSize);
+            if (eventDescriptor >= 0) ::close(eventDescriptor);
+            if (ringDescriptor >= 0) ::close(ringDescriptor);
+            sqes = nullptr;
+            sqMapping = cqMapping = MAP_FAILED;
+            eventDescriptor = ringDescriptor = -1;
+        }
+
+        /// Waking the read of the eventfd still in flight, so the kernel is done with eventValue before it goes away
+        auto teardown() -> void {
+            if (ringDescriptor < 0) return;
+            if (armed) {
+                uint64_t one = 1;
+                while (::write(eventDescriptor, &one, sizeof(one)) < 0 && errno == EINTR) {}
+                while (armed && native() && submit(true)) reap();
+                for (unsigned i = 0; armed && i < maxRefusals; ++i) {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                    reap();
+                }
+            }
+            unmap();
+        }
+
+        auto prepare(uint8_t opcode, int descriptor, void* data, std::size_t size, uint64_t offset, uint64_t userData) -> bool {
+            const unsigned tail = *sqTail;
+            if (tail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE) >= sqEntries) return false;
+            io_uring_sqe& sqe = sqes[tail & *sqMask];
+            std::memset(&sqe, 0, sizeof(sqe));
+            sqe.opcode = opcode;
+            sqe.fd = descriptor;
+            sqe.addr = reinterpret_cast<uint64_t>(data);
+            sqe.len = static_cast<uint32_t>(std::min<std::size_t>(size, 1u << 30));
+            sqe.off = offset;
+            sqe.user_data = userData;
+            sqArray[tail & *sqMask] = tail & *sqMask;
+            __atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+            ++submitted;
+            return true;
+        }
+
+        /**
+         * @brief Moving queued operations into free submission entries and entering the kernel
+         * @function submit
+         * @param block -> waiting for at least one completion<br>
+         * @details A refused submission [EAGAIN/EBUSY, the kernel is short of resources or of completion space]
+         *          is tried again after the completions are collected, up to maxRefusals times. Returns false when
+         *          the ring is given up [see giveUp].
+         */
+
+        auto submit(bool block) -> bool {
+            if (!armed && prepare(IORING_OP_READ, eventDescriptor, &eventValue, sizeof(eventValue), 0, wakeTag)) {
+                armed = true;
+            }
+            while (!queued.empty()) {
+                Operation& operation = operations[queued.front()];
+                const uint8_t opcode = operation.kind == Kind::Read ? IORING_OP_READ
+                                       : operation.kind == Kind::Write ? IORING_OP_WRITE : IORING_OP_FSYNC;
+                if (!prepare(opcode, operation.descriptor, operation.data + operation.done, operation.size - operation.done,
+                             operation.offset + operation.done, queued.front())) break;
+                if (operation.kind == Kind::Fsync && stats::enabled()) operation.started = std::chrono::steady_clock::now();
+                queued.pop_front();
+            }
+            if (submitted == 0 && !block) return true;
+            for (unsigned refused = 0;;) {
+                long result = ::syscall(__NR_io_uring_enter, ringDescriptor, submitted, block ? 1u : 0u,
+                                        block ? IORING_ENTER_GETEVENTS : 0u, nullptr, 0);
+                if (result >= 0) {
+                    submitted -= static_cast<unsigned>(result);
+                    return true;
+                }
+                if (errno == EINTR) continue;
+                if ((errno != EAGAIN && errno != EBUSY) || ++refused > maxRefusals) return giveUp(errno);
+                if (!block) return true;
+                reap();
+                if (!ready.empty()) return true;
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        }
+
+        /**
+         * @brief Switching to synchronous operations after io_uring_enter failed
+         * @function giveUp
+         * @param error -> errno of the failed call<br>
+         * @details Entries the kernel has not taken are taken back from the submission ring and run synchronously
+         *          with the rest of the queue, as does every operation queued later. Operations the kernel already
+         *          took are collected by drain() as they complete [their buffers are still in use until then].
+         */
+
+        auto giveUp(int error) -> bool {
+            failure.store(error, std::memory_order_relaxed);
+            const unsigned head = __atomic_load_n(sqHead, __ATOMIC_ACQUIRE);
+            std::deque<unsigned> taken;
+            for (unsigned entry = head; entry != *sqTail; ++entry) {
+                const uint64_t userData = sqes[sqArray[entry & *sqMask]].user_data;
+                if (userData == wakeTag) armed = false;
+                else taken.push_back(static_cast<unsigned>(userData));
+            }
+            __atomic_store_n(sqTail, head, __ATOMIC_RELEASE);
+            submitted = 0;
+            queued.insert(queued.begin(), taken.begin(), taken.end());
+            runQueued();
+            return false;
+        }
+
+        /// Running the queue synchronously once the ring is given up
+        auto runQueued() -> void {
+            while (!queued.empty()) {
+                const unsigned index = queued.front();
+                queued.pop_front();
+                ready.push_back({operations[index].tag, runNow(operations[index])});
+                freeOperations.push_back(index);
+            }
+        }
+
+        /// Collecting operations a given-up ring still has in flight, waiting for them or for a post() 1 ms at a time
+        auto drain() -> void {
+            for (;;) {
+                reap();
+                runQueued();
+                if (!ready.empty() || freeOperations.size() == operations.size()) return;
+                std::unique_lock<std::mutex> guard(lock);
+                if (wakeup.wait_for(guard, std::chrono::milliseconds(1), [this] { return !posted.empty(); })) return;
+            }
+        }
+
+        /// Collecting completion entries, unfinished transfers are queued again
+        auto reap() -> void {
+            unsigned head = *cqHead;
+            const unsigned tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+            for (; head != tail; ++head) {
+                const io_uring_cqe& cqe = cqes[head & *cqMask];
+                if (cqe.user_data == wakeTag) {
+                    armed = false;
+                    continue;
+                }
+                const auto index = static_cast<unsigned>(cqe.user_data);
+                Operation& operation = operations[index];
+                if (cqe.res == -EINTR || cqe.res == -EAGAIN) {
+                    queued.push_back(index);
+                    continue;
+                }
+                if (cqe.res > 0 && operation.kind != Kind::Fsync) {
+                    operation.done += static_cast<std::size_t>(cqe.res);
+                    if (operation.done < operation.size) {
+                        queued.push_back(index);
+                        continue;
+                    }
+                }
+                const int64_t result = cqe.res < 0 ? cqe.res : static_cast<int64_t>(operation.done);
+                if (cqe.res >= 0) finished(operation.kind, operation.done);
+                if (operation.kind == Kind::Fsync) stats::addTime(stats::Phase::Fsync, std::chrono::steady_clock::now() - operation.started);
+                ready.push_back({operation.tag, result});
+                freeOperations.push_back(index);
+            }
+            __atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+        }
+#endif
+    };
+}
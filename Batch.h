@@ -0,0 +1,423 @@
+#pragma once
+
+#include <algorithm>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "AsyncIO.h"
+#include "BufferPool.h"
+#include "FileCopy.h"
+#include "LSBKernels.h"
+#include "Stats.h"
+#include "Steg.h"
+#include "ThreadPool.h"
+
+#if defined(STEG_POSIX)
+#include <sys/stat.h>
+#endif
+
+/**
+ * @struct BatchJob
+ * @brief Single line of the batch manifest
+ * @var
+ * <b>line</b> -> line number in the manifest<br>
+ * <b>operation</b> -> 'e' [encrypt] or 'd' [decrypt]<br>
+ * <b>carrier</b> -> path of the file(image)<br>
+ * <b>payload</b> -> message to encrypt [encrypt only]<br>
+ * <b>output</b> -> encrypted file(image) [encrypt] or file receiving the message [decrypt, optional]<br>
+ * <b>ok</b> -> result of the job<br>
+ * <b>result</b> -> decrypted message or reason of the failure
+ */
+
+struct BatchJob {
+    std::size_t line = 0;
+    char operation = 0;
+    std::string carrier;
+    std::string payload;
+    std::string output;
+    bool ok = false;
+    std::string result;
+};
+
+namespace batch {
+
+    /**
+     * @struct Options
+     * @brief Limits of the encrypt pipeline
+     * @var
+     * <b>depth</b> -> encrypt jobs in flight at once [reading, embedding or writing]<br>
+     * <b>memoryBytes</b> -> ceiling of the prefixes held by jobs in flight, a single larger prefix still runs alone<br>
+     * <b>fsync</b> -> every encrypted file is synced before its job is reported as done
+     */
+
+    struct Options {
+        std::size_t depth = 32;
+        std::size_t memoryBytes = std::size_t{256} << 20;
+        bool fsync = false;
+    };
+
+    /// Splitting line of the manifest [or of a daemon request] into its tab separated fields
+    inline auto splitFields(const std::string& text) -> std::vector<std::string> {
+        std::vector<std::string> fields;
+        std::size_t start = 0;
+        for (std::size_t tab; (tab = text.find('\t', start)) != std::string::npos; start = tab + 1)
+            fields.push_back(text.substr(start, tab - start));
+        fields.push_back(text.substr(start));
+        return fields;
+    }
+
+    /**
+     * @brief Reading jobs from the manifest
+     * @function readManifest
+     * @param in -> manifest stream<br>
+     * @param jobs -> parsed jobs<br>
+     * @details Every line is one job with tab separated fields:<br>
+     *          &emsp;e &lt;TAB&gt; carrier &lt;TAB&gt; message &lt;TAB&gt; output<br>
+     *          &emsp;d &lt;TAB&gt; carrier [&lt;TAB&gt; output]<br>
+     *          Empty lines and lines starting with '#' are skipped. Returns false on the first malformed line.
+     */
+
+    inline auto readManifest(std::istream& in, std::vector<BatchJob>& jobs) -> bool {
+        std::string text;
+        for (std::size_t line = 1; std::getline(in, text); ++line) {
+            if (!text.empty() && text.back() == '\r') text.pop_back();
+            if (text.empty() || text[0] == '#') continue;
+
+            auto fields = splitFields(text);
+
+            BatchJob job;
+            job.line = line;
+            job.carrier = fields.size() > 1 ? fields[1] : "";
+            if ((fields[0] == "e" || fields[0] == "encrypt") && fields.size() == 4) {
+                job.operation = 'e';
+                job.payload = fields[2];
+                job.output = fields[3];
+            } else if ((fields[0] == "d" || fields[0] == "decrypt") && (fields.size() == 2 || fields.size() == 3)) {
+                job.operation = 'd';
+                if (fields.size() == 3) job.output = fields[2];
+            } else {
+                std::cerr << "Malformed manifest line " << line << ": " << text << std::endl;
+                return false;
+            }
+            jobs.push_back(std::move(job));
+        }
+        return true;
+    }
+
+    /**
+     * @brief Running single encrypt job
+     * @function encrypt
+     * @param job -> job to run, result is stored in it<br>
+     */
+
+    inline auto encrypt(BatchJob& job) -> void {
+        steg::Status status = steg::encodeFile(job.carrier, job.output,
+                                               reinterpret_cast<const unsigned char*>(job.payload.data()), job.payload.size());
+        job.ok = status == steg::Status::Ok;
+        job.result = job.ok ? job.output : steg::describe(status);
+    }
+
+    /**
+     * @brief Running single decrypt job
+     * @function decrypt
+     * @param job -> job to run, result is stored in it<br>
+     * @details Message is read with steg::decodeFile [only the byte range holding it]
+     */
+
+    inline auto decrypt(BatchJob& job) -> void {
+        std::vector<unsigned char> message;
+        steg::Status status = steg::decodeFile(job.carrier, message);
+        if (status != steg::Status::Ok) {
+            job.result = steg::describe(status);
+            return;
+        }
+        if (!job.output.empty()) {
+            std::ofstream out(job.output, std::ios::binary);
+            if (!out.write(reinterpret_cast<const char*>(message.data()), static_cast<std::streamsize>(message.size()))) {
+                job.result = "unable to write " + job.output;
+                return;
+            }
+            job.result = job.output;
+        } else {
+            job.result.assign(message.begin(), message.end());
+        }
+        job.ok = true;
+    }
+
+#if defined(STEG_POSIX)
+
+    /**
+     * @class Pipeline
+     * @brief Encrypt jobs going through read, embed and write stages at once
+     * @var
+     * <b>ring</b> -> reads of headers and prefixes, writes of prefixes and fsyncs [aio::Ring, io_uring]<br>
+     * <b>slots</b> -> state of the jobs in flight, index of a slot is the tag of its operations<br>
+     * <b>waiting</b> -> slots whose prefix does not fit under the memory ceiling yet<br>
+     * <b>memory</b> -> bytes of the prefixes held by jobs in flight
+     * @details Every job walks the steps of encodeFile with its I/O done by the ring:<br>
+     *              &emsp;&emsp;Head -> first steg::headBytes of the carrier, steg::planPatch finds the prefix<br>
+     *              &emsp;&emsp;Prefix -> rest of the prefix [headers and pixel data holding header and message]<br>
+     *              &emsp;&emsp;Embed -> steg::applyPatch and the kernel copy of the untouched rest on the shared pool<br>
+     *              &emsp;&emsp;Write -> prefix written in front of the copied rest<br>
+     *              &emsp;&emsp;Sync -> fsync of the encrypted file [Options::fsync]<br>
+     *          Reads of the next carriers, embedding of the current ones and writes of the finished ones overlap,
+     *          at most Options::depth jobs and Options::memoryBytes of prefixes are in flight. Plain rasters,
+     *          which are written again as a whole, run steg::encodeFile on the pool.
+     */
+
+    class Pipeline {
+    public:
+        explicit Pipeline(const Options& options)
+            : options(options), ring(static_cast<unsigned>(std::max<std::size_t>(options.depth, 1) + 1)),
+              slots(std::max<std::size_t>(options.depth, 1)) {}
+
+        auto run(std::vector<BatchJob*>& jobs) -> void {
+            std::vector<aio::Completion> done;
+            std::size_t next = 0;
+            std::size_t active = 0;
+            while (next < jobs.size() || active > 0) {
+                for (std::size_t index = 0; index < slots.size() && next < jobs.size(); ++index) {
+                    if (slots[index]) continue;
+                    slots[index] = std::make_unique<Slot>(*jobs[next++]);
+                    ++active;
+                    start(index);
+                }
+                ring.wait(done);
+                for (const auto& completion : done) advance(completion.tag, completion.result);
+                for (auto& slot : slots) {
+                    if (slot && slot->step == Step::Done) {
+                        slot.reset();
+                        --active;
+                    }
+                }
+            }
+        }
+
+    private:
+        enum class Step : uint8_t { Head, Prefix, Embed, Write, Sync, Done };
+
+        struct Slot {
+            explicit Slot(BatchJob& job) : job(job), message(job.payload) {}
+
+            BatchJob& job;
+            std::istringstream message;
+            Step step = Step::Head;
+            int source = -1;
+            int output = -1;
+            uint64_t fileSize = 0;
+            bool whole = false;
+            std::size_t known = 0;
+            buffers::Buffer head;
+            buffers::Buffer prefix;
+            steg::Patch patch;
+        };
+
+        Options options;
+        aio::Ring ring;
+        std::vector<std::unique_ptr<Slot>> slots;
+        std::deque<std::size_t> waiting;
+        std::size_t memory = 0;
+
+        auto start(std::size_t index) -> void {
+            Slot& slot = *slots[index];
+            slot.source = ::open(slot.job.carrier.c_str(), O_RDONLY);
+            struct stat status{};
+            if (slot.source < 0 || ::fstat(slot.source, &status) != 0 || status.st_size <= 0) {
+                fail(index, steg::describe(steg::Status::IoError));
+                ring.post(index, 0);
+                return;
+            }
+            slot.fileSize = static_cast<uint64_t>(status.st_size);
+            slot.head = buffers::acquire(static_cast<std::size_t>(std::min<uint64_t>(slot.fileSize, steg::headBytes)));
+            ring.read(slot.source, slot.head.data(), slot.head.size(), 0, index);
+        }
+
+        /// Moving the job of the slot to its next step once an operation of the current one completes
+        auto advance(std::size_t index, int64_t result) -> void {
+            Slot& slot = *slots[index];
+            switch (slot.step) {
+                case Step::Head: {
+                    if (result != static_cast<int64_t>(slot.head.size())) return fail(index, steg::describe(steg::Status::IoError));
+                    auto status = steg::planPatch(slot.head.data(), slot.head.size(), slot.fileSize, slot.message, {}, slot.patch);
+                    if (status != steg::Status::Ok) return fail(index, steg::describe(status));
+                    if (slot.patch.prefixBytes == 0) return embedWhole(index);
+                    if (memory > 0 && memory + slot.patch.prefixBytes > options.memoryBytes) {
+                        waiting.push_back(index);
+                        return;
+                    }
+                    return readPrefix(index);
+                }
+                case Step::Prefix:
+                    if (result != static_cast<int64_t>(slot.prefix.size() - slot.known)) {
+                        return fail(index, steg::describe(steg::Status::IoError));
+                    }
+                    return embed(index);
+                case Step::Embed: {
+                    if (slot.whole) return finish(index);
+                    auto status = static_cast<steg::Status>(result);
+                    if (status != steg::Status::Ok) return fail(index, steg::describe(status));
+                    slot.step = Step::Write;
+                    ring.write(slot.output, slot.prefix.data(), slot.prefix.size(), 0, index);
+                    return;
+                }
+                case Step::Write:
+                    if (result != static_cast<int64_t>(slot.prefix.size())) return fail(index, "unable to write " + slot.job.output);
+                    release(slot);
+                    if (options.fsync) {
+                        slot.step = Step::Sync;
+                        ring.fsync(slot.output, index);
+                        return;
+                    }
+                    return finish(index);
+                case Step::Sync:
+                    if (result < 0) return fail(index, "unable to write " + slot.job.output);
+                    return finish(index);
+                case Step::Done:
+                    return;
+            }
+        }
+
+        /// Reading the prefix past the bytes of the head, memory is reserved for it
+        auto readPrefix(std::size_t index) -> void {
+            Slot& slot = *slots[index];
+            memory += slot.patch.prefixBytes;
+            slot.prefix = buffers::acquire(slot.patch.prefixBytes);
+            slot.known = std::min(slot.head.size(), slot.prefix.size());
+            std::memcpy(slot.prefix.data(), slot.head.data(), slot.known);
+            slot.head = buffers::Buffer();
+            slot.step = Step::Prefix;
+            if (slot.known == slot.prefix.size()) return embed(index);
+            ring.read(slot.source, slot.prefix.data() + slot.known, slot.prefix.size() - slot.known, slot.known, index);
+        }
+
+        /// Embedding into the prefix and copying the rest of the carrier into the output on the pool
+        auto embed(std::size_t index) -> void {
+            Slot& slot = *slots[index];
+            ::close(slot.source);
+            slot.source = -1;
+            slot.step = Step::Embed;
+            ThreadPool::shared().submit([this, index, &slot] {
+                auto status = steg::applyPatch(slot.patch, slot.prefix.data(), slot.message);
+                if (status == steg::Status::Ok) {
+                    uint64_t size = 0;
+                    slot.output = filecopy::openPatched(slot.job.carrier, slot.job.output, slot.prefix.size(), size);
+                    if (slot.output < 0) status = steg::Status::IoError;
+                }
+                ring.post(index, static_cast<int64_t>(status));
+            });
+        }
+
+        /// Running the whole encodeFile on the pool [plain rasters are written again as a whole]
+        auto embedWhole(std::size_t index) -> void {
+            Slot& slot = *slots[index];
+            ::close(slot.source);
+            slot.source = -1;
+            slot.step = Step::Embed;
+            slot.whole = true;
+            ThreadPool::shared().submit([this, index, &slot] {
+                auto status = steg::encodeFile(slot.job.carrier, slot.job.output, slot.message);
+                slot.job.ok = status == steg::Status::Ok;
+                slot.job.result = slot.job.ok ? slot.job.output : steg::describe(status);
+                ring.post(index, 0);
+            });
+        }
+
+        auto finish(std::size_t index) -> void {
+            Slot& slot = *slots[index];
+            if (!slot.whole) {
+                slot.job.ok = ::close(slot.output) == 0;
+                slot.output = -1;
+                slot.job.result = slot.job.ok ? slot.job.output : "unable to write " + slot.job.output;
+            }
+            close(slot);
+        }
+
+        auto fail(std::size_t index, const std::string& reason) -> void {
+            Slot& slot = *slots[index];
+            slot.job.ok = false;
+            slot.job.result = reason;
+            close(slot);
+        }
+
+        auto close(Slot& slot) -> void {
+            if (slot.source >= 0) ::close(slot.source);
+            if (slot.output >= 0) ::close(slot.output);
+            slot.source = slot.output = -1;
+            release(slot);
+            slot.step = Step::Done;
+        }
+
+        /// Giving back memory of the prefix, jobs waiting for it read their prefixes
+        auto release(Slot& slot) -> void {
+            if (slot.prefix.empty() || slot.step == Step::Done) return;
+            memory -= slot.patch.prefixBytes;
+            slot.prefix = buffers::Buffer();
+            while (!waiting.empty()
+                   && (memory == 0 || memory + slots[waiting.front()]->patch.prefixBytes <= options.memoryBytes)) {
+                auto index = waiting.front();
+                waiting.pop_front();
+                readPrefix(index);
+            }
+        }
+    };
+
+#endif
+
+    /**
+     * @brief Running all jobs of the manifest
+     * @function run
+     * @param manifest -> path of the manifest<br>
+     * @param options -> limits of the encrypt pipeline<br>
+     * @details Decrypt jobs run on a ThreadPool sized to the number of cores, encrypt jobs go through Pipeline
+     *          [reads, embedding and writes of several jobs overlap], so process startup and kernel selection
+     *          are paid once per batch. Results are printed in manifest order once every job is finished:<br>
+     *          &emsp;line &lt;TAB&gt; ok|failed &lt;TAB&gt; carrier &lt;TAB&gt; output, message or reason<br>
+     *          Returns false when the manifest cannot be read or any job failed.
+     */
+
+    inline auto run(const std::string& manifest, const Options& options = {}) -> bool {
+        std::ifstream in(manifest);
+        if (!in) {
+            std::cerr << "Unable to open file! Path provided: " << manifest << std::endl;
+            return false;
+        }
+        std::vector<BatchJob> jobs;
+        if (!readManifest(in, jobs)) {
+            return false;
+        }
+
+        /// Selecting kernel before the workers start [done once, not per job]
+        kernels::active();
+        /// Shared pool is also used by jobs splitting large images into bands, so cores are not oversubscribed
+        auto& pool = ThreadPool::shared();
+#if defined(STEG_POSIX)
+        std::vector<BatchJob*> encrypts;
+        for (auto& job : jobs) {
+            if (job.operation == 'e') encrypts.push_back(&job);
+            else pool.submit([&job] { decrypt(job); });
+        }
+        Pipeline(options).run(encrypts);
+#else
+        (void)options;
+        for (auto& job : jobs) {
+            pool.submit([&job] { job.operation == 'e' ? encrypt(job) : decrypt(job); });
+        }
+#endif
+        pool.wait();
+
+        /// Reporting results per job
+        std::size_t failed = 0;
+        for (const auto& job : jobs) {
+            failed += !job.ok;
+            std::cout << job.line << '\t' << (job.ok ? "ok" : "failed") << '\t' << job.carrier << '\t' << job.result << '\n';
+        }
+        std::cout << jobs.size() - failed << " of " << jobs.size() << " jobs succeeded." << std::endl;
+        return failed == 0;
+    }
+}
@@ -0,0 +1,156 @@
+#pragma once
+
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace bits {
+
+    /**
+     * @brief Converting 64-bit word between host and big-endian byte order
+     * @function toBigEndian
+     * @param word -> 64-bit word<br>
+     * @details Payload bits are stored MSB-first, so the first payload byte has to land in the top byte of the word
+     */
+
+    inline auto toBigEndian(uint64_t word) -> uint64_t {
+        if constexpr (std::endian::native == std::endian::big) return word;
+#if defined(_MSC_VER)
+        return _byteswap_uint64(word);
+#else
+        return __builtin_bswap64(word);
+#endif
+    }
+
+    /**
+     * @class BitReader
+     * @brief Packed bit reader over payload bytes
+     * @var
+     * <b>data</b> -> payload bytes<br>
+     * <b>size</b> -> number of payload bytes<br>
+     * <b>next</b> -> index of the next byte that was not loaded into the word yet<br>
+     * <b>word</b> -> buffered bits, left-aligned (next bit to read is the MSB)<br>
+     * <b>available</b> -> number of valid bits in the word<br>
+     * <b>consumed</b> -> number of bits already read
+     * @details Serves payload bits MSB-first (same order as std::bitset<8> positions 7..0),
+     *          refilling a whole 64-bit word at a time, so reading n bits costs O(n) instead of
+     *          erasing characters from the front of a '0'/'1' string.
+     * @attention Reading past the end of the payload returns zero bits, check empty() or remaining() first
+     */
+
+    class BitReader {
+    public:
+        BitReader(const unsigned char* data, std::size_t size) : data(data), size(size) {}
+
+        /// Reading next 'count' bits [1..32], first bit ends up as the most significant one of the result
+        auto read(int count) -> uint32_t {
+            if (available < count) refill();
+            auto value = static_cast<uint32_t>(word >> (64 - count));
+            word = count < available ? word << count : 0;
+            available = count < available ? available - count : 0;
+            consumed += count;
+            return value;
+        }
+
+        /// Moving read position to the given bit of the payload
+        auto seek(uint64_t bitPosition) -> void {
+            next = static_cast<std::size_t>(bitPosition / 8);
+            word = 0;
+            available = 0;
+            consumed = bitPosition - bitPosition % 8;
+            if (bitPosition % 8 != 0) read(static_cast<int>(bitPosition % 8));
+        }
+
+        auto position() const -> uint64_t { return consumed; }
+        auto remaining() const -> uint64_t { return consumed < size * 8ull ? size * 8ull - consumed : 0; }
+        auto empty() const -> bool { return remaining() == 0; }
+
+    private:
+        auto refill() -> void {
+            /// Fast path: whole word is empty and 8 more bytes are available
+            if (available == 0 && next + 8 <= size) {
+                uint64_t raw;
+                std::memcpy(&raw, data + next, sizeof(raw));
+                word = toBigEndian(raw);
+                available = 64;
+                next += 8;
+                return;
+            }
+            while (available <= 56 && next < size) {
+                word |= static_cast<uint64_t>(data[next++]) << (56 - available);
+                available += 8;
+            }
+        }
+
+        const unsigned char* data;
+        std::size_t size;
+        std::size_t next = 0;
+        uint64_t word = 0;
+        int available = 0;
+        uint64_t consumed = 0;
+    };
+
+    /**
+     * @class BitWriter
+     * @brief Packed bit writer storing extracted payload bits
+     * @var
+     * <b>data</b> -> destination payload bytes<br>
+     * <b>next</b> -> index of the byte where the buffered word will be stored<br>
+     * <b>word</b> -> bits that were not stored yet, left-aligned<br>
+     * <b>filled</b> -> number of valid bits in the word [0..63]
+     * @details Counterpart of BitReader, bits are written MSB-first starting at any bit of the destination
+     *          and stored 8 bytes at a time. Bits of the first and the last byte that lie outside of the
+     *          written range are preserved.
+     * @attention flush() has to be called once all bits are written
+     */
+
+    class BitWriter {
+    public:
+        BitWriter(unsigned char* data, uint64_t bitOffset = 0)
+            : data(data), next(static_cast<std::size_t>(bitOffset / 8)), filled(static_cast<int>(bitOffset % 8)) {
+            /// Keeping bits of the first byte which come before the written range
+            if (filled) word = static_cast<uint64_t>(data[next] >> (8 - filled)) << (64 - filled);
+        }
+
+        /// Appending the lowest 'count' bits [1..32] of value, most significant one first
+        auto write(uint32_t value, int count) -> void {
+            uint64_t bitsToWrite = value & ((uint64_t{1} << count) - 1);
+            int space = 64 - filled;
+            if (count < space) {
+                word |= bitsToWrite << (space - count);
+                filled += count;
+                return;
+            }
+            int rest = count - space;
+            word |= bitsToWrite >> rest;
+            storeWord();
+            word = rest ? bitsToWrite << (64 - rest) : 0;
+            filled = rest;
+        }
+
+        /// Storing buffered bits, the last partial byte keeps its trailing bits
+        auto flush() -> void {
+            for (; filled >= 8; filled -= 8, word <<= 8)
+                data[next++] = static_cast<unsigned char>(word >> 56);
+            if (filled) {
+                auto keep = static_cast<unsigned char>(0xFF >> filled);
+                data[next] = static_cast<unsigned char>((word >> 56) & ~keep) | (data[next] & keep);
+            }
+            word = 0;
+            filled = 0;
+        }
+
+    private:
+        auto storeWord() -> void {
+            uint64_t raw = toBigEndian(word);
+            std::memcpy(data + next, &raw, sizeof(raw));
+            next += sizeof(raw);
+        }
+
+        unsigned char* data;
+        std::size_t next;
+        uint64_t word = 0;
+        int filled;
+    };
+}
@@ -0,0 +1,234 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <new>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#endif
+
+/**
+ * @file BufferPool.h
+ * @brief Pixel buffers reused across jobs instead of being allocated and zeroed for every image
+ * @details Buffers are handed out uninitialized [the caller overwrites them with file data right away] and
+ *          come back to the pool when their handle is destroyed. Sizes are rounded up to classes, so carriers of
+ *          the same size [typical for batch and daemon use] reuse the same memory:<br>
+ *              &emsp;&emsp;- below hugePage -> next power of two, at least 4 KB, 64-byte aligned [SIMD kernels]<br>
+ *              &emsp;&emsp;- from hugePage -> next multiple of hugePage, aligned to it and advised for transparent huge pages<br>
+ *          Idle buffers are kept only up to the memory ceiling, buffers released beyond it are freed.
+ */
+
+namespace buffers {
+
+    inline constexpr std::size_t alignment = 64;
+    inline constexpr std::size_t smallest = std::size_t{4} << 10;
+    inline constexpr std::size_t hugePage = std::size_t{2} << 20;
+
+    /// Size class of a buffer holding the given number of bytes
+    constexpr auto classOf(std::size_t size) -> std::size_t {
+        if (size >= hugePage) return (size + hugePage - 1) / hugePage * hugePage;
+        std::size_t capacity = smallest;
+        while (capacity < size) capacity <<= 1;
+        return capacity;
+    }
+
+    class Pool;
+
+    /**
+     * @class Buffer
+     * @brief Handle of a pooled buffer, memory goes back to its pool when the handle is destroyed
+     * @var
+     * <b>pool</b> -> pool the memory came from<br>
+     * <b>memory</b> -> first byte of the buffer<br>
+     * <b>used</b> -> number of bytes requested<br>
+     * <b>capacity</b> -> size class of the buffer (in 'bytes')
+     * @details Copy takes a new buffer from the same pool and copies the bytes [e.g. carrier encoded without
+     *          changing its cached original]
+     */
+
+    class Buffer {
+    public:
+        Buffer() = default;
+
+        Buffer(const Buffer& other);
+        auto operator=(const Buffer& other) -> Buffer&;
+
+        Buffer(Buffer&& other) noexcept { *this = std::move(other); }
+
+        auto operator=(Buffer&& other) noexcept -> Buffer& {
+            if (this != &other) {
+                reset();
+                std::swap(pool, other.pool);
+                std::swap(memory, other.memory);
+                std::swap(used, other.used);
+                std::swap(capacity, other.capacity);
+            }
+            return *this;
+        }
+
+        ~Buffer() { reset(); }
+
+        auto data() -> unsigned char* { return memory; }
+        auto data() const -> const unsigned char* { return memory; }
+        auto size() const -> std::size_t { return used; }
+        auto empty() const -> bool { return used == 0; }
+
+        /// Returning memory to the pool
+        auto reset() -> void;
+
+    private:
+        friend class Pool;
+
+        Pool* pool = nullptr;
+        unsigned char* memory = nullptr;
+        std::size_t used = 0;
+        std::size_t capacity = 0;
+    };
+
+    /**
+     * @class Pool
+     * @brief Idle buffers sorted by size class
+     * @var
+     * <b>limit</b> -> largest number of bytes held by idle buffers [memory ceiling]<br>
+     * <b>idle</b> -> idle buffers of every size class<br>
+     * <b>idleBytes</b> -> number of bytes held by idle buffers<br>
+     * <b>hits</b>, <b>misses</b> -> number of buffers taken from the pool and allocated
+     * @attention Thread-safe, bands and batch jobs take buffers from several threads at once
+     */
+
+    class Pool {
+    public:
+        explicit Pool(std::size_t limit) : limit(limit) {}
+
+        Pool(const Pool&) = delete;
+        auto operator=(const Pool&) -> Pool& = delete;
+
+        ~Pool() {
+            for (auto& [capacity, list] : idle) {
+                for (unsigned char* memory : list) std::free(memory);
+            }
+        }
+
+        /**
+         * @brief Taking buffer of at least the given size
+         * @function acquire
+         * @param size -> number of bytes needed<br>
+         * @details Content of the buffer is undefined. Throws std::bad_alloc when memory cannot be allocated.
+         */
+
+        auto acquire(std::size_t size) -> Buffer {
+            Buffer buffer;
+            buffer.pool = this;
+            buffer.used = size;
+            buffer.capacity = classOf(size);
+            {
+                std::lock_guard lock(mutex);
+                auto found = idle.find(buffer.capacity);
+                if (found != idle.end() && !found->second.empty()) {
+                    buffer.memory = found->second.back();
+                    found->second.pop_back();
+                    idleBytes -= buffer.capacity;
+                    ++hits;
+                    return buffer;
+                }
+                ++misses;
+            }
+
+            /// Allocating outside of the lock, huge pages are only advised [memory is not touched here]
+            const std::size_t align = buffer.capacity >= hugePage ? hugePage : alignment;
+            buffer.memory = static_cast<unsigned char*>(std::aligned_alloc(align, buffer.capacity));
+            if (!buffer.memory) throw std::bad_alloc();
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+            if (align == hugePage) ::madvise(buffer.memory, buffer.capacity, MADV_HUGEPAGE);
+#endif
+            return buffer;
+        }
+
+        /// Changing the memory ceiling, idle buffers above it are freed
+        auto setLimit(std::size_t bytes) -> void {
+            std::lock_guard lock(mutex);
+            limit = bytes;
+            for (auto& [capacity, list] : idle) {
+                while (idleBytes > limit && !list.empty()) {
+                    std::free(list.back());
+                    list.pop_back();
+                    idleBytes -= capacity;
+                }
+            }
+        }
+
+        /// Number of idle bytes, hits and misses
+        auto summary() -> std::string {
+            std::lock_guard lock(mutex);
+            return std::to_string(idleBytes) + " pooled bytes\t" + std::to_string(hits) + " buffer hits\t"
+                 + std::to_string(misses) + " buffer misses";
+        }
+
+        /**
+         * @brief Pool shared by the whole process
+         * @function shared
+         * @details Memory ceiling is 256 MB, STEG_POOL_MB environment variable overrides it [0 disables pooling]
+         */
+
+        static auto shared() -> Pool& {
+            static Pool pool([] {
+                const char* forced = std::getenv("STEG_POOL_MB");
+                return (forced ? static_cast<std::size_t>(std::strtoul(forced, nullptr, 10)) : std::size_t{256}) << 20;
+            }());
+            return pool;
+        }
+
+    private:
+        friend class Buffer;
+
+        auto release(unsigned char* memory, std::size_t capacity) -> void {
+            {
+                std::lock_guard lock(mutex);
+                if (idleBytes + capacity <= limit) {
+                    idle[capacity].push_back(memory);
+                    idleBytes += capacity;
+                    return;
+                }
+            }
+            std::free(memory);
+        }
+
+        std::size_t limit;
+        std::unordered_map<std::size_t, std::vector<unsigned char*>> idle;
+        std::size_t idleBytes = 0;
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        std::mutex mutex;
+    };
+
+    inline Buffer::Buffer(const Buffer& other) {
+        if (!other.pool) return;
+        *this = other.pool->acquire(other.used);
+        std::memcpy(memory, other.memory, used);
+    }
+
+    inline auto Buffer::operator=(const Buffer& other) -> Buffer& {
+        if (this != &other) *this = Buffer(other);
+        return *this;
+    }
+
+    inline auto Buffer::reset() -> void {
+        if (pool && memory) pool->release(memory, capacity);
+        pool = nullptr;
+        memory = nullptr;
+        used = 0;
+        capacity = 0;
+    }
+
+    /// Taking buffer from the shared pool
+    inline auto acquire(std::size_t size) -> Buffer { return Pool::shared().acquire(size); }
+}
@@ -0,0 +1,233 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "FileReadOrWrite.h"
+#include "PayloadHeader.h"
+#include "RangeFile.h"
+#include "Steg.h"
+#include "ThreadPool.h"
+
+/**
+ * @struct CarrierEntry
+ * @brief Single carrier of the catalog
+ * @var
+ * <b>capacity</b> -> number of message bytes encrypt can store in the carrier<br>
+ * <b>carrierBytes</b> -> size of the image(pixel) data (in 'bytes')<br>
+ * <b>format</b> -> image::Format of the file<br>
+ * <b>density</b> -> payload bits per carrier byte used for the format<br>
+ * <b>path</b> -> path of the file(image)
+ */
+
+struct CarrierEntry {
+    uint64_t capacity = 0;
+    uint64_t carrierBytes = 0;
+    image::Format format = image::Format::Unknown;
+    uint8_t density = 0;
+    std::string path;
+};
+
+namespace catalog {
+
+    /// Name of the index file written into the indexed directory
+    inline constexpr const char* indexName = "steg.index";
+
+    inline constexpr std::array<char, 4> magic{'S', 'G', 'I', 'X'};
+    inline constexpr uint32_t version = 2; // 2: capacities leave room for the payload checksum
+
+    /**
+     * @struct Record
+     * @brief Fixed-size record of the index file
+     * @details Index file layout [little-endian]:<br>
+     *          &emsp;magic 'SGIX' | version (4 bytes) | number of records (8 bytes)<br>
+     *          &emsp;records sorted by capacity (24 bytes each)<br>
+     *          &emsp;paths of the carriers [pathOffset is counted from the start of this block]<br>
+     *          Records have a fixed size, so a query can binary search them with pread without loading the index
+     */
+
+    struct Record {
+        uint64_t capacity;
+        uint64_t carrierBytes;
+        uint32_t pathOffset;
+        uint16_t pathLength;
+        uint8_t format;
+        uint8_t density;
+    };
+    static_assert(sizeof(Record) == 24);
+
+    inline constexpr std::size_t headerSize = 16;
+
+    /**
+     * @brief Reading capacity of a carrier from its headers
+     * @function probe
+     * @param path -> path of the file(image)<br>
+     * @details Only BMP/PPM headers are read [pread], pixel data is not touched. Returns nothing when the file
+     *          is not a supported carrier or its pixel data does not fit into the file.
+     */
+
+    inline auto probe(const std::string& path) -> std::optional<CarrierEntry> {
+        CarrierEntry entry;
+        entry.path = path;
+        entry.format = image::formatOf(path);
+        if (entry.format == image::Format::Unknown) return std::nullopt;
+
+        /// Capacity follows the default plan of the pixel layout [32-bit BMP and 16-bit PPM use some bytes only]
+        steg::Info info;
+        if (steg::inspect(path, info) != steg::Status::Ok
+            || (info.format == steg::Format::BMP) != (entry.format == image::Format::BMP)) return std::nullopt;
+        entry.carrierBytes = info.carrierBytes;
+        entry.density = info.density;
+        entry.capacity = info.capacity;
+        return entry;
+    }
+
+    /**
+     * @brief Building catalog of all carriers in the directory
+     * @function build
+     * @param directory -> directory with carriers<br>
+     * @param entries -> carriers sorted by capacity<br>
+     * @details Headers of all .bmp/.ppm files are probed in parallel on the shared ThreadPool, the sorted
+     *          index is written into the directory as steg.index
+     */
+
+    inline auto build(const std::string& directory, std::vector<CarrierEntry>& entries) -> bool {
+        std::error_code error;
+        std::vector<std::string> paths;
+        for (const auto& item : std::filesystem::directory_iterator(directory, error)) {
+            if (item.is_regular_file(error) && image::formatOf(item.path().string()) != image::Format::Unknown)
+                paths.push_back(item.path().string());
+        }
+        if (error) {
+            std::cerr << "Unable to read directory! Path provided: " << directory << std::endl;
+            return false;
+        }
+
+        /// Probing headers in parallel
+        std::vector<std::optional<CarrierEntry>> probed(paths.size());
+        ThreadPool::shared().forEach(paths.size(), [&](std::size_t i) { probed[i] = probe(paths[i]); });
+        entries.clear();
+        for (auto& entry : probed) {
+            if (entry) entries.push_back(std::move(*entry));
+        }
+        std::sort(entries.begin(), entries.end(), [](const CarrierEntry& a, const CarrierEntry& b) {
+            return a.capacity != b.capacity ? a.capacity < b.capacity : a.path < b.path;
+        });
+
+        /// Writing index [header, records, paths]
+        std::vector<Record> records;
+        std::string pathBlock;
+        for (const auto& entry : entries) {
+            records.push_back({entry.capacity, entry.carrierBytes, static_cast<uint32_t>(pathBlock.size()),
+                               static_cast<uint16_t>(entry.path.size()), static_cast<uint8_t>(entry.format), entry.density});
+            pathBlock += entry.path;
+        }
+        auto indexPath = (std::filesystem::path(directory) / indexName).string();
+        std::ofstream out(indexPath, std::ios::binary);
+        uint64_t count = records.size();
+        out.write(magic.data(), magic.size());
+        out.write(reinterpret_cast<const char*>(&version), sizeof(version));
+        out.write(reinterpret_cast<const char*>(&count), sizeof(count));
+        out.write(reinterpret_cast<const char*>(records.data()), static_cast<std::streamsize>(records.size() * sizeof(Record)));
+        out.write(pathBlock.data(), static_cast<std::streamsize>(pathBlock.size()));
+        if (!out.flush()) {
+            std::cerr << "Error writing index! Path provided: " << indexPath << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    /**
+     * @brief Finding the smallest carrier that can store the payload
+     * @function find
+     * @param directory -> directory indexed by build()<br>
+     * @param size -> payload size (in 'bytes')<br>
+     * @param entry -> found carrier<br>
+     * @details Binary search over the records of the index file, O(log n) preads of 24 bytes and one read of the
+     *          path, neither carriers nor the whole index are loaded. Returns false when no carrier is big enough.
+     */
+
+    inline auto find(const std::string& directory, uint64_t size, CarrierEntry& entry) -> bool {
+        auto indexPath = (std::filesystem::path(directory) / indexName).string();
+        RangeFile file;
+        std::array<char, headerSize> header{};
+        uint32_t fileVersion = 0;
+        uint64_t count = 0;
+        if (!file.open(indexPath) || !file.readAt(0, header.size(), header.data())
+            || !std::equal(magic.begin(), magic.end(), header.begin())) {
+            std::cerr << "Unable to read index, run -index first! Path provided: " << indexPath << std::endl;
+            return false;
+        }
+        std::memcpy(&fileVersion, header.data() + 4, sizeof(fileVersion));
+        std::memcpy(&count, header.data() + 8, sizeof(count));
+        if (fileVersion != version || count > (file.size() - headerSize) / sizeof(Record)) {
+            std::cerr << "Unsupported index version, run -index again! Path provided: " << indexPath << std::endl;
+            return false;
+        }
+
+        /// Lower bound of the payload size over capacities
+        Record record{};
+        uint64_t low = 0, high = count;
+        while (low < high) {
+            uint64_t middle = low + (high - low) / 2;
+            if (!file.readAt(headerSize + middle * sizeof(Record), sizeof(Record), &record)) return false;
+            if (record.capacity < size) low = middle + 1;
+            else high = middle;
+        }
+        if (low == count) return false;
+
+        if (!file.readAt(headerSize + low * sizeof(Record), sizeof(Record), &record)) return false;
+        entry.capacity = record.capacity;
+        entry.carrierBytes = record.carrierBytes;
+        entry.format = static_cast<image::Format>(record.format);
+        entry.density = record.density;
+        entry.path.resize(record.pathLength);
+        return file.readAt(headerSize + count * sizeof(Record) + record.pathOffset, record.pathLength, entry.path.data());
+    }
+
+    /**
+     * @brief Indexing the directory and printing its carriers
+     * @function index
+     * @param directory -> directory with carriers<br>
+     * @flags -index directory
+     */
+
+    inline auto index(const std::string& directory) -> bool {
+        std::vector<CarrierEntry> entries;
+        if (!build(directory, entries)) {
+            return false;
+        }
+        for (const auto& entry : entries) {
+            std::cout << entry.capacity << " bytes\t" << int(entry.density) << " LSB\t" << entry.path << '\n';
+        }
+        std::cout << entries.size() << " carriers indexed into "
+                  << (std::filesystem::path(directory) / indexName).string() << std::endl;
+        return true;
+    }
+
+    /**
+     * @brief Printing the smallest indexed carrier that can store the payload
+     * @function pick
+     * @param directory -> directory indexed by build()<br>
+     * @param size -> payload size (in 'bytes')<br>
+     * @flags -pick directory message <i>OR</i> -pick directory --payload-file file
+     */
+
+    inline auto pick(const std::string& directory, uint64_t size) -> bool {
+        CarrierEntry entry;
+        if (!find(directory, size, entry)) {
+            std::cerr << "No indexed carrier can store " << size << " bytes!" << std::endl;
+            return false;
+        }
+        std::cout << entry.path << '\t' << entry.capacity << " bytes" << std::endl;
+        return true;
+    }
+}
@@ -0,0 +1,172 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "LSBKernels.h"
+
+/**
+ * @file Checksum.h
+ * @brief CRC32C [Castagnoli polynomial] of the payload
+ * @details Same CRC as the crc32 instruction of SSE4.2, which computes it 8 bytes per instruction. Processors without
+ *          it use slicing-by-8 [8 tables of 256 entries, 8 bytes per step]. Values follow the zlib convention
+ *          [update starts from 0, crc of "123456789" is 0xE3069283].
+ *          Bands of a payload are checksummed on their own threads and joined in order by combine, which shifts
+ *          the first CRC past the bytes of the second one in O(log n) polynomial products.
+ */
+
+namespace crc {
+
+    /// Reflected Castagnoli polynomial
+    inline constexpr uint32_t polynomial = 0x82F63B78u;
+
+    /// Tables of slicing-by-8, table k gives the CRC of a byte followed by k zero bytes
+    inline constexpr auto tables = [] {
+        std::array<std::array<uint32_t, 256>, 8> table{};
+        for (uint32_t value = 0; value < 256; ++value) {
+            uint32_t crc = value;
+            for (int bit = 0; bit < 8; ++bit) crc = crc & 1 ? (crc >> 1) ^ polynomial : crc >> 1;
+            table[0][value] = crc;
+        }
+        for (std::size_t k = 1; k < 8; ++k)
+            for (std::size_t value = 0; value < 256; ++value)
+                table[k][value] = (table[k - 1][value] >> 8) ^ table[0][table[k - 1][value] & 0xFF];
+        return table;
+    }();
+
+    /// Slicing-by-8 on the raw [not inverted] CRC register, bytes are read one by one so any byte order works
+    inline auto updateTable(uint32_t crc, const unsigned char* data, std::size_t size) -> uint32_t {
+        for (; size >= 8; data += 8, size -= 8) {
+            uint32_t low = crc ^ (uint32_t(data[0]) | uint32_t(data[1]) << 8 | uint32_t(data[2]) << 16 | uint32_t(data[3]) << 24);
+            uint32_t high = uint32_t(data[4]) | uint32_t(data[5]) << 8 | uint32_t(data[6]) << 16 | uint32_t(data[7]) << 24;
+            crc = tables[7][low & 0xFF] ^ tables[6][(low >> 8) & 0xFF] ^ tables[5][(low >> 16) & 0xFF] ^ tables[4][low >> 24]
+                ^ tables[3][high & 0xFF] ^ tables[2][(high >> 8) & 0xFF] ^ tables[1][(high >> 16) & 0xFF] ^ tables[0][high >> 24];
+        }
+        for (; size; ++data, --size) crc = (crc >> 8) ^ tables[0][(crc ^ *data) & 0xFF];
+        return crc;
+    }
+
+#if defined(STEG_X86)
+
+    /// crc32 instruction of SSE4.2 on the raw CRC register, 8 bytes per instruction on 64-bit targets
+    STEG_TARGET("sse4.2")
+    inline auto updateSSE42(uint32_t crc, const unsigned char* data, std::size_t size) -> uint32_t {
+#if defined(__x86_64__) || defined(_M_X64)
+        uint64_t wide = crc;
+        for (; size >= 8; data += 8, size -= 8) {
+            uint64_t word;
+            std::memcpy(&word, data, 8);
+            wide = _mm_crc32_u64(wide, word);
+        }
+        crc = static_cast<uint32_t>(wide);
+#else
+        for (; size >= 4; data += 4, size -= 4) {
+            uint32_t word;
+            std::memcpy(&word, data, 4);
+            crc = _mm_crc32_u32(crc, word);
+        }
+#endif
+        for (; size; ++data, --size) crc = _mm_crc32_u8(crc, *data);
+        return crc;
+    }
+
+#endif
+
+    /// Update function on the raw CRC register
+    using UpdateFn = uint32_t (*)(uint32_t crc, const unsigned char* data, std::size_t size);
+
+    /**
+     * @brief Update function used for every checksum
+     * @function active
+     * @details Selected once: crc32 instruction when the processor has SSE4.2, slicing-by-8 otherwise.
+     *          STEG_KERNEL=scalar [see kernels::active] pins slicing-by-8 as well.
+     */
+
+    inline auto active() -> UpdateFn {
+        static const UpdateFn update = [] {
+#if defined(STEG_X86)
+            const char* forced = std::getenv("STEG_KERNEL");
+            if (kernels::detectCpu().sse42 && !(forced && std::string(forced) == "scalar")) return updateSSE42;
+#endif
+            return updateTable;
+        }();
+        return update;
+    }
+
+    /// Name of the update function in use ["sse4.2" or "slicing-by-8"]
+    inline auto activeName() -> const char* {
+#if defined(STEG_X86)
+        if (active() == updateSSE42) return "sse4.2";
+#endif
+        return "slicing-by-8";
+    }
+
+    /// CRC32C of crc's data followed by the given bytes [crc is 0 for no data yet]
+    inline auto update(uint32_t crc, const unsigned char* data, std::size_t size) -> uint32_t {
+        return ~active()(~crc, data, size);
+    }
+
+    /// Product of two polynomials modulo the CRC polynomial [bit 31 is x^0, as in reflected CRC registers]
+    constexpr auto multiply(uint32_t first, uint32_t second) -> uint32_t {
+        uint32_t product = 0;
+        for (uint32_t mask = 1u << 31; mask; mask >>= 1) {
+            if (first & mask) product ^= second;
+            second = second & 1 ? (second >> 1) ^ polynomial : second >> 1;
+        }
+        return product;
+    }
+
+    /// x^(2^k) modulo the CRC polynomial for k in [0, 32), the powers repeat after that
+    inline constexpr auto powers = [] {
+        std::array<uint32_t, 32> table{};
+        table[0] = 1u << 30;
+        for (std::size_t k = 1; k < table.size(); ++k) table[k] = multiply(table[k - 1], table[k - 1]);
+        return table;
+    }();
+
+    /**
+     * @brief CRC32C of two buffers one after another from their own CRCs
+     * @function combine
+     * @param first -> CRC of the first buffer<br>
+     * @param second -> CRC of the second buffer<br>
+     * @param secondBytes -> size of the second buffer<br>
+     * @details First CRC is multiplied by x^(8 * secondBytes) [product of the powers of its set bits], same as
+     *          crc32_combine of zlib
+     */
+
+    constexpr auto combine(uint32_t first, uint32_t second, uint64_t secondBytes) -> uint32_t {
+        uint32_t shift = 1u << 31;
+        for (std::size_t k = 3; secondBytes; secondBytes >>= 1, ++k)
+            if (secondBytes & 1) shift = multiply(powers[k & 31], shift);
+        return multiply(shift, first) ^ second;
+    }
+
+    static_assert(combine(0xE3069283u, 0, 0) == 0xE3069283u);
+
+    /**
+     * @struct Part
+     * @brief CRC of a run of bytes and its size, runs of one buffer are joined in order
+     */
+
+    struct Part {
+        uint32_t value = 0;
+        uint64_t bytes = 0;
+    };
+
+    inline auto partOf(const unsigned char* data, std::size_t size) -> Part {
+        return {update(0, data, size), size};
+    }
+
+    inline auto join(const Part& first, const Part& second) -> Part {
+        return {combine(first.value, second.value, second.bytes), first.bytes + second.bytes};
+    }
+
+    inline auto join(const std::vector<Part>& parts) -> Part {
+        Part whole;
+        for (const auto& part : parts) whole = join(whole, part);
+        return whole;
+    }
+}
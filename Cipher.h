@@ -0,0 +1,682 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "LSBKernels.h"
+
+/**
+ * @file Cipher.h
+ * @brief ChaCha20-Poly1305 [RFC 8439] of the payload with a key derived from a passphrase or a keyfile
+ * @details Encrypted payload is stored as:<br>
+ *          &emsp;cost | salt (16 bytes) | ciphertext | tag (16 bytes)<br>
+ *          Key is PBKDF2-HMAC-SHA256 of the secret [passphrase or keyfile contents] and the random salt with
+ *          2^cost iterations. Every message gets its own salt and so its own key, so the nonce is fixed to zero.
+ *          Cost and salt are the additional authenticated data, the tag covers them and the ciphertext.
+ *          Keystream is generated 8 blocks at a time with AVX2 and 4 with SSE2 [one block per 32-bit lane],
+ *          the scalar block function is the fallback and serves partial blocks. Sealer encrypts and authenticates
+ *          the payload piece by piece as it is pulled for embedding [stream::PayloadStream], so the cipher runs
+ *          on bytes that are in cache anyway.
+ */
+
+namespace cipher {
+
+    inline constexpr std::size_t keyBytes = 32;
+    inline constexpr std::size_t saltBytes = 16;
+    inline constexpr std::size_t tagBytes = 16;
+    /// Cost byte and salt stored in front of the ciphertext
+    inline constexpr std::size_t prefixBytes = 1 + saltBytes;
+    /// Bytes an encrypted payload is longer than the plaintext
+    inline constexpr std::size_t overheadBytes = prefixBytes + tagBytes;
+    /// PBKDF2 iterations are 2^cost [about 0.1 s per key for the default]
+    inline constexpr uint8_t defaultCost = 17;
+    /// Highest cost accepted from an image, higher values would let a crafted image stall the decoder
+    inline constexpr uint8_t maxCost = 24;
+
+    inline auto load32(const unsigned char* bytes) -> uint32_t {
+        return uint32_t(bytes[0]) | uint32_t(bytes[1]) << 8 | uint32_t(bytes[2]) << 16 | uint32_t(bytes[3]) << 24;
+    }
+
+    inline auto load64(const unsigned char* bytes) -> uint64_t {
+        return uint64_t(load32(bytes)) | uint64_t(load32(bytes + 4)) << 32;
+    }
+
+    inline auto store32(unsigned char* bytes, uint32_t value) -> void {
+        for (int i = 0; i < 4; ++i) bytes[i] = static_cast<unsigned char>(value >> (8 * i));
+    }
+
+    inline auto store64(unsigned char* bytes, uint64_t value) -> void {
+        for (int i = 0; i < 8; ++i) bytes[i] = static_cast<unsigned char>(value >> (8 * i));
+    }
+
+    constexpr auto rotl(uint32_t value, int bits) -> uint32_t { return value << bits | value >> (32 - bits); }
+
+    /**
+     * @class Sha256
+     * @brief SHA-256 [FIPS 180-4], used only for key derivation
+     */
+
+    class Sha256 {
+    public:
+        static constexpr std::size_t digestBytes = 32;
+        static constexpr std::size_t blockBytes = 64;
+
+        auto update(const unsigned char* data, std::size_t size) -> void {
+            total += size;
+            if (buffered) {
+                std::size_t take = std::min(size, blockBytes - buffered);
+                std::memcpy(buffer.data() + buffered, data, take);
+                buffered += take;
+                data += take;
+                size -= take;
+                if (buffered < blockBytes) return;
+                compress(buffer.data());
+                buffered = 0;
+            }
+            for (; size >= blockBytes; data += blockBytes, size -= blockBytes) compress(data);
+            std::memcpy(buffer.data(), data, size);
+            buffered = size;
+        }
+
+        auto finish() -> std::array<unsigned char, digestBytes> {
+            const uint64_t bits = total * 8;
+            const unsigned char one = 0x80;
+            update(&one, 1);
+            const unsigned char zero = 0;
+            while (buffered != blockBytes - 8) update(&zero, 1);
+            std::array<unsigned char, 8> length{};
+            for (int i = 0; i < 8; ++i) length[i] = static_cast<unsigned char>(bits >> (56 - 8 * i));
+            update(length.data(), length.size());
+            std::array<unsigned char, digestBytes> digest{};
+            for (int i = 0; i < 8; ++i)
+                for (int j = 0; j < 4; ++j) digest[4 * i + j] = static_cast<unsigned char>(state[i] >> (24 - 8 * j));
+            return digest;
+        }
+
+    private:
+        static constexpr std::array<uint32_t, 64> rounds{
+            0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+            0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+            0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+            0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+            0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+            0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+            0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+            0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+
+        static constexpr auto rotr(uint32_t value, int bits) -> uint32_t { return value >> bits | value << (32 - bits); }
+
+        auto compress(const unsigned char* block) -> void {
+            std::array<uint32_t, 64> w{};
+            for (int i = 0; i < 16; ++i)
+                w[i] = uint32_t(block[4 * i]) << 24 | uint32_t(block[4 * i + 1]) << 16 | uint32_t(block[4 * i + 2]) << 8 | block[4 * i + 3];
+            for (int i = 16; i < 64; ++i) {
+                uint32_t s0 = rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+                uint32_t s1 = rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+                w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+            }
+            uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+            uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+            for (int i = 0; i < 64; ++i) {
+                uint32_t t1 = h + (rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25)) + ((e & f) ^ (~e & g)) + rounds[i] + w[i];
+                uint32_t t2 = (rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+                h = g; g = f; f = e; e = d + t1;
+                d = c; c = b; b = a; a = t1 + t2;
+            }
+            state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+            state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+        }
+
+        std::array<uint32_t, 8> state{0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+                                      0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+        std::array<unsigned char, blockBytes> buffer{};
+        std::size_t buffered = 0;
+        uint64_t total = 0;
+    };
+
+    /**
+     * @brief Deriving the key from the secret and the salt
+     * @function deriveKey
+     * @param secret -> passphrase or keyfile contents<br>
+     * @param salt -> saltBytes random bytes stored with the payload<br>
+     * @param cost -> PBKDF2-HMAC-SHA256 runs 2^cost iterations<br>
+     * @details One output block of PBKDF2 is exactly the key. Inner and outer HMAC states are hashed once and
+     *          copied for every iteration, so an iteration costs two SHA-256 blocks.
+     */
+
+    inline auto deriveKey(std::string_view secret, const unsigned char* salt, uint8_t cost) -> std::array<unsigned char, keyBytes> {
+        std::array<unsigned char, Sha256::blockBytes> block{};
+        if (secret.size() > block.size()) {
+            Sha256 hash;
+            hash.update(reinterpret_cast<const unsigned char*>(secret.data()), secret.size());
+            auto digest = hash.finish();
+            std::copy(digest.begin(), digest.end(), block.begin());
+        } else {
+            std::copy(secret.begin(), secret.end(), block.begin());
+        }
+        Sha256 inner, outer;
+        std::array<unsigned char, Sha256::blockBytes> pad{};
+        for (std::size_t i = 0; i < pad.size(); ++i) pad[i] = block[i] ^ 0x36;
+        inner.update(pad.data(), pad.size());
+        for (std::size_t i = 0; i < pad.size(); ++i) pad[i] = block[i] ^ 0x5c;
+        outer.update(pad.data(), pad.size());
+        auto hmac = [&](const unsigned char* data, std::size_t size) {
+            Sha256 hash = inner;
+            hash.update(data, size);
+            auto digest = hash.finish();
+            hash = outer;
+            hash.update(digest.data(), digest.size());
+            return hash.finish();
+        };
+
+        /// U1 = HMAC(salt | block number 1), Ui = HMAC(Ui-1), key is the XOR of all of them
+        std::array<unsigned char, saltBytes + 4> first{};
+        std::copy(salt, salt + saltBytes, first.begin());
+        first[saltBytes + 3] = 1;
+        auto u = hmac(first.data(), first.size());
+        auto key = u;
+        for (uint64_t i = 1; i < (uint64_t{1} << cost); ++i) {
+            u = hmac(u.data(), u.size());
+            for (std::size_t j = 0; j < key.size(); ++j) key[j] ^= u[j];
+        }
+        return key;
+    }
+
+    /// Keystream function: XORs blocks of keystream for counters state[12], state[12] + 1, ... into the bytes
+    using XorFn = void (*)(const uint32_t* state, const unsigned char* in, unsigned char* out, std::size_t blocks);
+
+    /// ChaCha20 block function [10 double rounds], keystream of one block
+    inline auto block(const uint32_t* state, unsigned char* out) -> void {
+        std::array<uint32_t, 16> x{};
+        std::copy(state, state + 16, x.begin());
+        auto quarter = [&](int a, int b, int c, int d) {
+            x[a] += x[b]; x[d] = rotl(x[d] ^ x[a], 16);
+            x[c] += x[d]; x[b] = rotl(x[b] ^ x[c], 12);
+            x[a] += x[b]; x[d] = rotl(x[d] ^ x[a], 8);
+            x[c] += x[d]; x[b] = rotl(x[b] ^ x[c], 7);
+        };
+        for (int round = 0; round < 10; ++round) {
+            quarter(0, 4, 8, 12); quarter(1, 5, 9, 13); quarter(2, 6, 10, 14); quarter(3, 7, 11, 15);
+            quarter(0, 5, 10, 15); quarter(1, 6, 11, 12); quarter(2, 7, 8, 13); quarter(3, 4, 9, 14);
+        }
+        for (int i = 0; i < 16; ++i) store32(out + 4 * i, x[i] + state[i]);
+    }
+
+    inline auto xorScalar(const uint32_t* state, const unsigned char* in, unsigned char* out, std::size_t blocks) -> void {
+        std::array<uint32_t, 16> current{};
+        std::copy(state, state + 16, current.begin());
+        std::array<unsigned char, 64> stream{};
+        for (std::size_t i = 0; i < blocks; ++i, ++current[12], in += 64, out += 64) {
+            block(current.data(), stream.data());
+            for (std::size_t j = 0; j < 64; ++j) out[j] = in[j] ^ stream[j];
+        }
+    }
+
+#if defined(STEG_X86)
+
+    template <int bits>
+    STEG_TARGET("sse2")
+    inline auto rotl128(__m128i value) -> __m128i {
+        return _mm_or_si128(_mm_slli_epi32(value, bits), _mm_srli_epi32(value, 32 - bits));
+    }
+
+    /// Quarter round of 4 blocks, one per lane
+    STEG_TARGET("sse2")
+    inline auto quarterSSE2(__m128i& a, __m128i& b, __m128i& c, __m128i& d) -> void {
+        a = _mm_add_epi32(a, b); d = rotl128<16>(_mm_xor_si128(d, a));
+        c = _mm_add_epi32(c, d); b = rotl128<12>(_mm_xor_si128(b, c));
+        a = _mm_add_epi32(a, b); d = rotl128<8>(_mm_xor_si128(d, a));
+        c = _mm_add_epi32(c, d); b = rotl128<7>(_mm_xor_si128(b, c));
+    }
+
+    /**
+     * @brief Keystream of 4 blocks at a time with SSE2
+     * @function xorSSE2
+     * @details Lane k of vector i holds word i of block k, so the quarter rounds are plain vertical adds, XORs and
+     *          shifts. A 4x4 transpose of every 4 words gives 16-byte pieces of the 4 blocks in stored order.
+     */
+
+    STEG_TARGET("sse2")
+    inline auto xorSSE2(const uint32_t* state, const unsigned char* in, unsigned char* out, std::size_t blocks) -> void {
+        uint32_t counter = state[12];
+        for (; blocks >= 4; blocks -= 4, counter += 4, in += 256, out += 256) {
+            __m128i s[16], x[16];
+            for (int i = 0; i < 16; ++i) s[i] = _mm_set1_epi32(static_cast<int>(state[i]));
+            s[12] = _mm_add_epi32(_mm_set1_epi32(static_cast<int>(counter)), _mm_set_epi32(3, 2, 1, 0));
+            for (int i = 0; i < 16; ++i) x[i] = s[i];
+            for (int round = 0; round < 10; ++round) {
+                quarterSSE2(x[0], x[4], x[8], x[12]); quarterSSE2(x[1], x[5], x[9], x[13]);
+                quarterSSE2(x[2], x[6], x[10], x[14]); quarterSSE2(x[3], x[7], x[11], x[15]);
+                quarterSSE2(x[0], x[5], x[10], x[15]); quarterSSE2(x[1], x[6], x[11], x[12]);
+                quarterSSE2(x[2], x[7], x[8], x[13]); quarterSSE2(x[3], x[4], x[9], x[14]);
+            }
+            for (int i = 0; i < 16; ++i) x[i] = _mm_add_epi32(x[i], s[i]);
+            for (int group = 0; group < 4; ++group) {
+                __m128i t0 = _mm_unpacklo_epi32(x[4 * group], x[4 * group + 1]);
+                __m128i t1 = _mm_unpacklo_epi32(x[4 * group + 2], x[4 * group + 3]);
+                __m128i t2 = _mm_unpackhi_epi32(x[4 * group], x[4 * group + 1]);
+                __m128i t3 = _mm_unpackhi_epi32(x[4 * group + 2], x[4 * group + 3]);
+                const __m128i pieces[4] = {_mm_unpacklo_epi64(t0, t1), _mm_unpackhi_epi64(t0, t1),
+                                           _mm_unpacklo_epi64(t2, t3), _mm_unpackhi_epi64(t2, t3)};
+                for (int k = 0; k < 4; ++k) {
+                    auto* source = reinterpret_cast<const __m128i*>(in + 64 * k + 16 * group);
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 64 * k + 16 * group),
+                                     _mm_xor_si128(_mm_loadu_si128(source), pieces[k]));
+                }
+            }
+        }
+        if (blocks) {
+            std::array<uint32_t, 16> rest{};
+            std::copy(state, state + 16, rest.begin());
+            rest[12] = counter;
+            xorScalar(rest.data(), in, out, blocks);
+        }
+    }
+
+    /// Quarter round of 8 blocks, one per lane, rotations by 16 and 8 are byte shuffles
+    STEG_TARGET("avx2")
+    inline auto quarterAVX2(__m256i& a, __m256i& b, __m256i& c, __m256i& d) -> void {
+        const __m256i rotate16 = _mm256_setr_epi8(2, 3, 0, 1, 6, 7, 4, 5, 10, 11, 8, 9, 14, 15, 12, 13,
+                                                  2, 3, 0, 1, 6, 7, 4, 5, 10, 11, 8, 9, 14, 15, 12, 13);
+        const __m256i rotate8 = _mm256_setr_epi8(3, 0, 1, 2, 7, 4, 5, 6, 11, 8, 9, 10, 15, 12, 13, 14,
+                                                 3, 0, 1, 2, 7, 4, 5, 6, 11, 8, 9, 10, 15, 12, 13, 14);
+        a = _mm256_add_epi32(a, b); d = _mm256_shuffle_epi8(_mm256_xor_si256(d, a), rotate16);
+        c = _mm256_add_epi32(c, d); b = _mm256_xor_si256(b, c);
+        b = _mm256_or_si256(_mm256_slli_epi32(b, 12), _mm256_srli_epi32(b, 20));
+        a = _mm256_add_epi32(a, b); d = _mm256_shuffle_epi8(_mm256_xor_si256(d, a), rotate8);
+        c = _mm256_add_epi32(c, d); b = _mm256_xor_si256(b, c);
+        b = _mm256_or_si256(_mm256_slli_epi32(b, 7), _mm256_srli_epi32(b, 25));
+    }
+
+    /**
+     * @brief Keystream of 8 blocks at a time with AVX2
+     * @function xorAVX2
+     * @details Same layout as xorSSE2 with 8 lanes. The 4x4 transpose
+     *          works within 128-bit halves [blocks 0-3 low, 4-7 high], halves of two groups are joined into
+     *          32-byte pieces.
+     */
+
+    STEG_TARGET("avx2")
+    inline auto xorAVX2(const uint32_t* state, const unsigned char* in, unsigned char* out, std::size_t blocks) -> void {
+        uint32_t counter = state[12];
+        for (; blocks >= 8; blocks -= 8, counter += 8, in += 512, out += 512) {
+            __m256i s[16], x[16];
+            for (int i = 0; i < 16; ++i) s[i] = _mm256_set1_epi32(static_cast<int>(state[i]));
+            s[12] = _mm256_add_epi32(_mm256_set1_epi32(static_cast<int>(counter)), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+            for (int i = 0; i < 16; ++i) x[i] = s[i];
+            for (int round = 0; round < 10; ++round) {
+                quarterAVX2(x[0], x[4], x[8], x[12]); quarterAVX2(x[1], x[5], x[9], x[13]);
+                quarterAVX2(x[2], x[6], x[10], x[14]); quarterAVX2(x[3], x[7], x[11], x[15]);
+                quarterAVX2(x[0], x[5], x[10], x[15]); quarterAVX2(x[1], x[6], x[11], x[12]);
+                quarterAVX2(x[2], x[7], x[8], x[13]); quarterAVX2(x[3], x[4], x[9], x[14]);
+            }
+            for (int i = 0; i < 16; ++i) x[i] = _mm256_add_epi32(x[i], s[i]);
+
+            /// pieces[group][k] -> words 4 * group .. 4 * group + 3 of block k [low half] and block k + 4 [high half]
+            __m256i pieces[4][4];
+            for (int group = 0; group < 4; ++group) {
+                __m256i t0 = _mm256_unpacklo_epi32(x[4 * group], x[4 * group + 1]);
+                __m256i t1 = _mm256_unpacklo_epi32(x[4 * group + 2], x[4 * group + 3]);
+                __m256i t2 = _mm256_unpackhi_epi32(x[4 * group], x[4 * group + 1]);
+                __m256i t3 = _mm256_unpackhi_epi32(x[4 * group + 2], x[4 * group + 3]);
+                pieces[group][0] = _mm256_unpacklo_epi64(t0, t1);
+                pieces[group][1] = _mm256_unpackhi_epi64(t0, t1);
+                pieces[group][2] = _mm256_unpacklo_epi64(t2, t3);
+                pieces[group][3] = _mm256_unpackhi_epi64(t2, t3);
+            }
+            for (int k = 0; k < 4; ++k) {
+                const std::size_t offsets[4] = {64u * k, 64u * k + 32, 64u * (k + 4), 64u * (k + 4) + 32};
+                const __m256i streams[4] = {_mm256_permute2x128_si256(pieces[0][k], pieces[1][k], 0x20),
+                                            _mm256_permute2x128_si256(pieces[2][k], pieces[3][k], 0x20),
+                                            _mm256_permute2x128_si256(pieces[0][k], pieces[1][k], 0x31),
+                                            _mm256_permute2x128_si256(pieces[2][k], pieces[3][k], 0x31)};
+                for (int j = 0; j < 4; ++j) {
+                    auto* source = reinterpret_cast<const __m256i*>(in + offsets[j]);
+                    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + offsets[j]),
+                                        _mm256_xor_si256(_mm256_loadu_si256(source), streams[j]));
+                }
+            }
+        }
+        if (blocks) {
+            std::array<uint32_t, 16> rest{};
+            std::copy(state, state + 16, rest.begin());
+            rest[12] = counter;
+            xorSSE2(rest.data(), in, out, blocks);
+        }
+    }
+
+#endif
+
+    /**
+     * @struct Kernel
+     * @brief Keystream function for one instruction set
+     */
+
+    struct Kernel {
+        const char* name;
+        XorFn apply;
+    };
+
+    /**
+     * @brief Keystream function used for every payload
+     * @function active
+     * @details Selected once like kernels::active: STEG_KERNEL=scalar or sse2 pins that one, otherwise AVX2 when
+     *          the processor has it, then SSE2, then the scalar block function
+     */
+
+    inline auto active() -> const Kernel& {
+        static const Kernel kernel = [] {
+#if defined(STEG_X86)
+            const kernels::CpuFeatures cpu = kernels::detectCpu();
+            const char* forced = std::getenv("STEG_KERNEL");
+            const std::string name = forced ? forced : "";
+            if (name == "scalar") return Kernel{"scalar", xorScalar};
+            if (cpu.avx2 && name != "sse2") return Kernel{"avx2", xorAVX2};
+            if (cpu.sse2) return Kernel{"sse2", xorSSE2};
+#endif
+            return Kernel{"scalar", xorScalar};
+        }();
+        return kernel;
+    }
+
+    /**
+     * @class ChaCha20
+     * @brief Keystream of one key and nonce XORed into consecutive pieces of a payload
+     * @var
+     * <b>state</b> -> constants, key, counter of the next block, nonce<br>
+     * <b>rest</b> -> keystream of a block of which only the first used bytes were XORed
+     */
+
+    class ChaCha20 {
+    public:
+        ChaCha20(const unsigned char* key, uint32_t counter) {
+            state[0] = 0x61707865; state[1] = 0x3320646e; state[2] = 0x79622d32; state[3] = 0x6b206574;
+            for (int i = 0; i < 8; ++i) state[4 + i] = load32(key + 4 * i);
+            state[12] = counter;
+        }
+
+        /// XORing the next size bytes of keystream into the data
+        auto apply(unsigned char* data, std::size_t size) -> void {
+            for (; size && used < rest.size(); --size) *data++ ^= rest[used++];
+            const std::size_t blocks = size / 64;
+            if (blocks) {
+                active().apply(state.data(), data, data, blocks);
+                state[12] += static_cast<uint32_t>(blocks);
+                data += blocks * 64;
+                size -= blocks * 64;
+            }
+            if (size) {
+                block(state.data(), rest.data());
+                ++state[12];
+                for (used = 0; used < size; ++used) data[used] ^= rest[used];
+            }
+        }
+
+    private:
+        std::array<uint32_t, 16> state{};
+        std::array<unsigned char, 64> rest{};
+        std::size_t used = 64;
+    };
+
+    /**
+     * @class Poly1305
+     * @brief One-time authenticator over 130-bit arithmetic in three 44/44/42-bit limbs
+     * @details Every 16-byte block costs 9 64x64-bit multiplications [poly1305-donna-64 layout]
+     */
+
+    class Poly1305 {
+    public:
+        explicit Poly1305(const unsigned char* key) {
+            const uint64_t t0 = load64(key), t1 = load64(key + 8);
+            r[0] = t0 & 0xffc0fffffffull;
+            r[1] = ((t0 >> 44) | (t1 << 20)) & 0xfffffc0ffffull;
+            r[2] = (t1 >> 24) & 0x00ffffffc0full;
+            pad[0] = load64(key + 16);
+            pad[1] = load64(key + 24);
+        }
+
+        auto update(const unsigned char* data, std::size_t size) -> void {
+            if (buffered) {
+                std::size_t take = std::min(size, buffer.size() - buffered);
+                std::memcpy(buffer.data() + buffered, data, take);
+                buffered += take;
+                data += take;
+                size -= take;
+                if (buffered < buffer.size()) return;
+                blocks(buffer.data(), 1, uint64_t{1} << 40);
+                buffered = 0;
+            }
+            blocks(data, size / 16, uint64_t{1} << 40);
+            data += size / 16 * 16;
+            std::memcpy(buffer.data(), data, size % 16);
+            buffered = size % 16;
+        }
+
+        /// Zeros up to the next multiple of 16 bytes [padding of RFC 8439]
+        auto padToBlock() -> void {
+            static constexpr std::array<unsigned char, 16> zeros{};
+            if (buffered) update(zeros.data(), zeros.size() - buffered);
+        }
+
+        auto finish() -> std::array<unsigned char, tagBytes> {
+            if (buffered) {
+                buffer[buffered] = 1;
+                std::fill(buffer.begin() + static_cast<std::ptrdiff_t>(buffered) + 1, buffer.end(), 0);
+                blocks(buffer.data(), 1, 0);
+            }
+            uint64_t h0 = h[0], h1 = h[1], h2 = h[2];
+            uint64_t c = h1 >> 44; h1 &= mask44; h2 += c;
+            c = h2 >> 42; h2 &= mask42; h0 += c * 5;
+            c = h0 >> 44; h0 &= mask44; h1 += c;
+            c = h1 >> 44; h1 &= mask44; h2 += c;
+            c = h2 >> 42; h2 &= mask42; h0 += c * 5;
+            c = h0 >> 44; h0 &= mask44; h1 += c;
+
+            /// h - p when it is not negative, h otherwise [constant time]
+            uint64_t g0 = h0 + 5; c = g0 >> 44; g0 &= mask44;
+            uint64_t g1 = h1 + c; c = g1 >> 44; g1 &= mask44;
+            uint64_t g2 = h2 + c - (uint64_t{1} << 42);
+            c = (g2 >> 63) - 1;
+            h0 = (h0 & ~c) | (g0 & c);
+            h1 = (h1 & ~c) | (g1 & c);
+            h2 = (h2 & ~c) | (g2 & c);
+
+            h0 += pad[0] & mask44; c = h0 >> 44; h0 &= mask44;
+            h1 += (((pad[0] >> 44) | (pad[1] << 20)) & mask44) + c; c = h1 >> 44; h1 &= mask44;
+            h2 += ((pad[1] >> 24) & mask42) + c; h2 &= mask42;
+            std::array<unsigned char, tagBytes> tag{};
+            store64(tag.data(), h0 | (h1 << 44));
+            store64(tag.data() + 8, (h1 >> 20) | (h2 << 24));
+            return tag;
+        }
+
+    private:
+        static constexpr uint64_t mask44 = 0xfffffffffffull;
+        static constexpr uint64_t mask42 = 0x3ffffffffffull;
+
+#if defined(__SIZEOF_INT128__)
+        using Wide = unsigned __int128;
+        static auto multiply(uint64_t a, uint64_t b) -> Wide { return Wide(a) * b; }
+        static auto shift(Wide value, int bits) -> uint64_t { return static_cast<uint64_t>(value >> bits); }
+        static auto low(Wide value) -> uint64_t { return static_cast<uint64_t>(value); }
+#else
+        /// 128-bit value of compilers without a 128-bit integer
+        struct Wide {
+            uint64_t low = 0, high = 0;
+            auto operator+(const Wide& other) const -> Wide {
+                Wide sum{low + other.low, high + other.high};
+                sum.high += sum.low < low;
+                return sum;
+            }
+            auto operator+(uint64_t other) const -> Wide { return *this + Wide{other, 0}; }
+        };
+        static auto multiply(uint64_t a, uint64_t b) -> Wide {
+            const uint64_t a0 = a & 0xffffffffu, a1 = a >> 32, b0 = b & 0xffffffffu, b1 = b >> 32;
+            const uint64_t p00 = a0 * b0, p01 = a0 * b1, p10 = a1 * b0, p11 = a1 * b1;
+            const uint64_t middle = (p00 >> 32) + (p01 & 0xffffffffu) + (p10 & 0xffffffffu);
+            return {(middle << 32) | (p00 & 0xffffffffu), p11 + (p01 >> 32) + (p10 >> 32) + (middle >> 32)};
+        }
+        static auto shift(const Wide& value, int bits) -> uint64_t { return (value.low >> bits) | (value.high << (64 - bits)); }
+        static auto low(const Wide& value) -> uint64_t { return value.low; }
+#endif
+
+        /// h = (h + block + hibit) * r for every block, hibit is 2^128 for whole blocks [1 is appended by finish otherwise]
+        auto blocks(const unsigned char* data, std::size_t count, uint64_t hibit) -> void {
+            const uint64_t r0 = r[0], r1 = r[1], r2 = r[2];
+            const uint64_t s1 = r1 * 20, s2 = r2 * 20;
+            uint64_t h0 = h[0], h1 = h[1], h2 = h[2];
+            for (; count; --count, data += 16) {
+                const uint64_t t0 = load64(data), t1 = load64(data + 8);
+                h0 += t0 & mask44;
+                h1 += ((t0 >> 44) | (t1 << 20)) & mask44;
+                h2 += ((t1 >> 24) & mask42) | hibit;
+                Wide d0 = multiply(h0, r0) + multiply(h1, s2) + multiply(h2, s1);
+                Wide d1 = multiply(h0, r1) + multiply(h1, r0) + multiply(h2, s2);
+                Wide d2 = multiply(h0, r2) + multiply(h1, r1) + multiply(h2, r0);
+                uint64_t c = shift(d0, 44); h0 = low(d0) & mask44;
+                d1 = d1 + c; c = shift(d1, 44); h1 = low(d1) & mask44;
+                d2 = d2 + c; c = shift(d2, 42); h2 = low(d2) & mask42;
+                h0 += c * 5; c = h0 >> 44; h0 &= mask44;
+                h1 += c;
+            }
+            h[0] = h0; h[1] = h1; h[2] = h2;
+        }
+
+        std::array<uint64_t, 3> r{};
+        std::array<uint64_t, 3> h{};
+        std::array<uint64_t, 2> pad{};
+        std::array<unsigned char, 16> buffer{};
+        std::size_t buffered = 0;
+    };
+
+    /**
+     * @class Aead
+     * @brief ChaCha20-Poly1305 of one key, the payload is passed piece by piece
+     * @details Keystream block 0 is the Poly1305 key, payload is XORed from block 1 on [RFC 8439, nonce 0].
+     *          Pieces are split into 4 KB runs which are XORed and authenticated one after another, so both
+     *          passes find the run in L1 cache.
+     */
+
+    class Aead {
+    public:
+        Aead(const std::array<unsigned char, keyBytes>& key, const unsigned char* aad, std::size_t aadBytes)
+            : stream(key.data(), 0), mac(firstBlock(stream).data()), aadBytes(aadBytes) {
+            mac.update(aad, aadBytes);
+            mac.padToBlock();
+        }
+
+        /// Encrypting the next piece of plaintext in place
+        auto encrypt(unsigned char* data, std::size_t size) -> void {
+            forRuns(data, size, [&](unsigned char* run, std::size_t bytes) {
+                stream.apply(run, bytes);
+                mac.update(run, bytes);
+            });
+        }
+
+        /// Decrypting the next piece of ciphertext in place
+        auto decrypt(unsigned char* data, std::size_t size) -> void {
+            forRuns(data, size, [&](unsigned char* run, std::size_t bytes) {
+                mac.update(run, bytes);
+                stream.apply(run, bytes);
+            });
+        }
+
+        /// Tag over the additional data and every piece so far [call once, at the end]
+        auto tag() -> std::array<unsigned char, tagBytes> {
+            mac.padToBlock();
+            std::array<unsigned char, 16> lengths{};
+            store64(lengths.data(), aadBytes);
+            store64(lengths.data() + 8, textBytes);
+            mac.update(lengths.data(), lengths.size());
+            return mac.finish();
+        }
+
+    private:
+        static constexpr std::size_t runBytes = 4096;
+
+        static auto firstBlock(ChaCha20& stream) -> std::array<unsigned char, 64> {
+            std::array<unsigned char, 64> key{};
+            stream.apply(key.data(), key.size());
+            return key;
+        }
+
+        template <typename Body>
+        auto forRuns(unsigned char* data, std::size_t size, Body&& body) -> void {
+            textBytes += size;
+            for (std::size_t done = 0; done < size; done += runBytes) body(data + done, std::min(runBytes, size - done));
+        }
+
+        ChaCha20 stream;
+        Poly1305 mac;
+        uint64_t aadBytes = 0;
+        uint64_t textBytes = 0;
+    };
+
+    /// Cost byte and fresh random salt of a new payload
+    inline auto newPrefix(uint8_t cost) -> std::array<unsigned char, prefixBytes> {
+        std::array<unsigned char, prefixBytes> prefix{};
+        prefix[0] = cost;
+        std::random_device random;
+        for (std::size_t i = 1; i < prefix.size(); i += 4) {
+            const uint32_t word = random();
+            for (std::size_t j = 0; j < 4 && i + j < prefix.size(); ++j) prefix[i + j] = static_cast<unsigned char>(word >> (8 * j));
+        }
+        return prefix;
+    }
+
+    /**
+     * @class Sealer
+     * @brief Encryption of one payload pulled piece by piece
+     * @details prefix() goes in front of the ciphertext, tag() after it
+     */
+
+    class Sealer {
+    public:
+        explicit Sealer(std::string_view secret, uint8_t cost = defaultCost)
+            : head(newPrefix(cost)), aead(deriveKey(secret, head.data() + 1, cost), head.data(), head.size()) {}
+
+        auto prefix() const -> const std::array<unsigned char, prefixBytes>& { return head; }
+        auto seal(unsigned char* data, std::size_t size) -> void { aead.encrypt(data, size); }
+        auto tag() -> std::array<unsigned char, tagBytes> { return aead.tag(); }
+
+    private:
+        std::array<unsigned char, prefixBytes> head;
+        Aead aead;
+    };
+
+    /**
+     * @brief Decrypting a whole stored payload in place
+     * @function open
+     * @param secret -> passphrase or keyfile contents<br>
+     * @param payload -> prefix, ciphertext and tag, plaintext when true is returned<br>
+     * @details Every 4 KB run is authenticated and decrypted in one go. Returns false when the payload is too short,
+     *          its cost is out of range or the tag does not match [wrong secret or modified payload], the
+     *          payload is cleared then so no unauthenticated plaintext is left.
+     */
+
+    inline auto open(std::string_view secret, std::vector<unsigned char>& payload) -> bool {
+        if (payload.size() < overheadBytes || payload[0] > maxCost) return false;
+        const std::size_t textBytes = payload.size() - overheadBytes;
+        unsigned char* text = payload.data() + prefixBytes;
+        Aead aead(deriveKey(secret, payload.data() + 1, payload[0]), payload.data(), prefixBytes);
+        aead.decrypt(text, textBytes);
+        const auto tag = aead.tag();
+        unsigned char difference = 0;
+        for (std::size_t i = 0; i < tagBytes; ++i) difference |= tag[i] ^ text[textBytes + i];
+        if (difference) {
+            std::fill(payload.begin(), payload.end(), 0);
+            payload.clear();
+            return false;
+        }
+        std::memmove(payload.data(), text, textBytes);
+        payload.resize(textBytes);
+        return true;
+    }
+}
@@ -0,0 +1,307 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <istream>
+#include <streambuf>
+#include <vector>
+
+/**
+ * @file Compression.h
+ * @brief Built-in LZ compression of payloads [LZ4-style sequences, no external library]
+ * @details Payload is split into independent blocks of at most blockBytes, every block is stored as:<br>
+ *          &emsp;size word (4 bytes, little-endian) | block data<br>
+ *          Low 31 bits of the size word give the size of the block data, the high bit marks a block stored raw
+ *          [it did not get smaller]. Compressed data is a list of sequences:<br>
+ *          &emsp;token | extra literal length | literals | offset (2 bytes, little-endian) | extra match length<br>
+ *          High nibble of the token is the literal length and low nibble the match length minus minMatch, 15 is
+ *          continued by bytes of 255 ended by a smaller one. Last sequence of a block has literals only.
+ *          Blocks never refer to each other, so both sides stream with memory bounded by one block.
+ */
+
+namespace lz {
+
+    inline constexpr std::size_t blockBytes = std::size_t{64} << 10;
+    inline constexpr std::size_t minMatch = 4;
+    inline constexpr uint32_t rawBlock = uint32_t{1} << 31;
+    inline constexpr int hashLog = 14;
+    /// Largest decompressed payload, a crafted payload of many tiny blocks can not ask for more memory
+    inline constexpr uint64_t maxOutputBytes = uint64_t{1} << 31;
+
+    /// Largest size of a compressed block of the given size
+    constexpr auto bound(std::size_t size) -> std::size_t { return size + size / 255 + 16; }
+
+    inline auto read32(const unsigned char* p) -> uint32_t {
+        uint32_t value;
+        std::memcpy(&value, p, sizeof(value));
+        return value;
+    }
+
+    inline auto read64(const unsigned char* p) -> uint64_t {
+        uint64_t value;
+        std::memcpy(&value, p, sizeof(value));
+        return value;
+    }
+
+    inline auto writeLength(unsigned char*& out, std::size_t length) -> void {
+        for (; length >= 255; length -= 255) *out++ = 255;
+        *out++ = static_cast<unsigned char>(length);
+    }
+
+    /// Number of equal bytes at a and b, b + result never passes end
+    inline auto matchLength(const unsigned char* a, const unsigned char* b, const unsigned char* end) -> std::size_t {
+        const unsigned char* start = b;
+        while (b + 8 <= end) {
+            uint64_t difference = read64(a) ^ read64(b);
+            if (difference) return static_cast<std::size_t>(b - start) + (std::countr_zero(difference) >> 3);
+            a += 8;
+            b += 8;
+        }
+        while (b < end && *a == *b) ++a, ++b;
+        return static_cast<std::size_t>(b - start);
+    }
+
+    /**
+     * @brief Compressing single block
+     * @function compressBlock
+     * @param in -> block bytes<br>
+     * @param size -> block size, at most blockBytes<br>
+     * @param out -> output with room for bound(size) bytes<br>
+     * @details Greedy parse over a hash table of 4-byte sequences, positions without a match are skipped faster
+     *          the longer the run of literals is [incompressible data costs little time]. Returns compressed size.
+     */
+
+    inline auto compressBlock(const unsigned char* in, std::size_t size, unsigned char* out) -> std::size_t {
+        std::vector<uint16_t> table(std::size_t{1} << hashLog, 0);
+        auto hash = [](uint32_t sequence) { return (sequence * 2654435761u) >> (32 - hashLog); };
+        const unsigned char* const start = out;
+        const unsigned char* const end = in + size;
+        const unsigned char* anchor = in;
+
+        auto emit = [&](const unsigned char* literals, std::size_t literalLength, std::size_t offset, std::size_t length) {
+            unsigned char& token = *out++;
+            token = static_cast<unsigned char>(std::min<std::size_t>(literalLength, 15) << 4);
+            if (literalLength >= 15) writeLength(out, literalLength - 15);
+            std::memcpy(out, literals, literalLength);
+            out += literalLength;
+            if (length == 0) return;
+            *out++ = static_cast<unsigned char>(offset);
+            *out++ = static_cast<unsigned char>(offset >> 8);
+            token |= static_cast<unsigned char>(std::min<std::size_t>(length - minMatch, 15));
+            if (length - minMatch >= 15) writeLength(out, length - minMatch - 15);
+        };
+
+        if (size > minMatch) {
+            const unsigned char* const last = end - minMatch;
+            for (const unsigned char* p = in + 1; p <= last;) {
+                uint32_t sequence = read32(p);
+                auto& slot = table[hash(sequence)];
+                const unsigned char* candidate = in + slot;
+                slot = static_cast<uint16_t>(p - in);
+                if (candidate >= p || read32(candidate) != sequence) {
+                    p += 1 + ((p - anchor) >> 6);
+                    continue;
+                }
+                std::size_t length = minMatch + matchLength(candidate + minMatch, p + minMatch, end);
+                emit(anchor, static_cast<std::size_t>(p - anchor), static_cast<std::size_t>(p - candidate), length);
+                p += length;
+                anchor = p;
+                if (p - 2 >= in && p - 2 <= last) table[hash(read32(p - 2))] = static_cast<uint16_t>(p - 2 - in);
+            }
+        }
+        emit(anchor, static_cast<std::size_t>(end - anchor), 0, 0);
+        return static_cast<std::size_t>(out - start);
+    }
+
+    /**
+     * @brief Decompressing single block
+     * @function decompressBlock
+     * @param in -> compressed block<br>
+     * @param size -> compressed size<br>
+     * @param out -> output with room for blockBytes + 16 bytes [copies may write up to 16 bytes past the data]<br>
+     * @param produced -> size of the decompressed block<br>
+     * @details Literals and matches are copied 8 or 16 bytes at a time when they do not reach the end of the
+     *          input or output, every length and offset is checked, so corrupted payloads fail instead of
+     *          overrunning memory. Returns false for a corrupted block.
+     */
+
+    inline auto decompressBlock(const unsigned char* in, std::size_t size, unsigned char* out,
+                                std::size_t& produced) -> bool {
+        const unsigned char* const inEnd = in + size;
+        unsigned char* const start = out;
+        unsigned char* const outEnd = out + blockBytes;
+
+        auto readLength = [&](std::size_t& length) -> bool {
+            for (unsigned char byte = 255; byte == 255; length += byte) {
+                if (in >= inEnd) return false;
+                byte = *in++;
+            }
+            return true;
+        };
+
+        while (in < inEnd) {
+            unsigned char token = *in++;
+
+            /// Literals
+            std::size_t literalLength = token >> 4;
+            if (literalLength == 15 && !readLength(literalLength)) return false;
+            if (literalLength > static_cast<std::size_t>(inEnd - in) || literalLength > static_cast<std::size_t>(outEnd - out))
+                return false;
+            if (literalLength <= 16 && in + 16 <= inEnd) {
+                std::memcpy(out, in, 16);
+            } else {
+                std::memcpy(out, in, literalLength);
+            }
+            in += literalLength;
+            out += literalLength;
+            if (in == inEnd) break;
+
+            /// Match
+            if (inEnd - in < 2) return false;
+            std::size_t offset = in[0] | (std::size_t(in[1]) << 8);
+            in += 2;
+            std::size_t length = token & 15;
+            if (length == 15 && !readLength(length)) return false;
+            length += minMatch;
+            if (offset == 0 || offset > static_cast<std::size_t>(out - start) || length > static_cast<std::size_t>(outEnd - out))
+                return false;
+            const unsigned char* match = out - offset;
+            if (offset >= 16) {
+                /// Copies of 16 (8) bytes never read bytes they have not written yet
+                for (std::size_t i = 0; i < length; i += 16) std::memcpy(out + i, match + i, 16);
+            } else if (offset >= 8) {
+                for (std::size_t i = 0; i < length; i += 8) std::memcpy(out + i, match + i, 8);
+            } else {
+                for (std::size_t i = 0; i < length; ++i) out[i] = match[i];
+            }
+            out += length;
+        }
+        produced = static_cast<std::size_t>(out - start);
+        return true;
+    }
+
+    /**
+     * @brief Framing one block [size word and data]
+     * @function packBlock
+     * @param in -> block bytes<br>
+     * @param size -> block size, at most blockBytes<br>
+     * @param out -> output with room for 4 + bound(size) bytes<br>
+     * @details Block is stored raw when compression does not make it smaller. Returns size of the framed block.
+     */
+
+    inline auto packBlock(const unsigned char* in, std::size_t size, unsigned char* out) -> std::size_t {
+        auto packed = compressBlock(in, size, out + 4);
+        uint32_t word = static_cast<uint32_t>(packed);
+        if (packed >= size) {
+            std::memcpy(out + 4, in, size);
+            packed = size;
+            word = static_cast<uint32_t>(size) | rawBlock;
+        }
+        for (int i = 0; i < 4; ++i) out[i] = static_cast<unsigned char>(word >> (8 * i));
+        return 4 + packed;
+    }
+
+    /**
+     * @class CompressBuffer
+     * @brief Stream buffer handing out the compressed form of another stream
+     * @details Source is read one block at a time when the compressed bytes of the previous block are used up,
+     *          so a payload of any size is compressed with two blocks of memory. Used as std::istream packed(&buffer).
+     */
+
+    class CompressBuffer : public std::streambuf {
+    public:
+        explicit CompressBuffer(std::istream& source) : source(source), raw(blockBytes), packed(4 + bound(blockBytes)) {}
+
+    protected:
+        auto underflow() -> int_type override {
+            if (gptr() < egptr()) return traits_type::to_int_type(*gptr());
+            source.read(reinterpret_cast<char*>(raw.data()), static_cast<std::streamsize>(raw.size()));
+            auto size = static_cast<std::size_t>(source.gcount());
+            if (size == 0) return traits_type::eof();
+            auto framed = packBlock(raw.data(), size, packed.data());
+            char* data = reinterpret_cast<char*>(packed.data());
+            setg(data, data, data + framed);
+            return traits_type::to_int_type(*gptr());
+        }
+
+    private:
+        std::istream& source;
+        std::vector<unsigned char> raw;
+        std::vector<unsigned char> packed;
+    };
+
+    /**
+     * @brief Finding compressed size of a seekable stream
+     * @function compressedLength
+     * @param in -> payload stream, it is left at its position<br>
+     * @param length -> compressed size (in 'bytes')<br>
+     * @details Payload is compressed once just to count its bytes, used where the size has to be written before
+     *          the payload [streamed encrypt]. Returns false for pipes and terminals.
+     */
+
+    inline auto compressedLength(std::istream& in, uint64_t& length) -> bool {
+        auto position = in.tellg();
+        if (position < 0) {
+            in.clear();
+            return false;
+        }
+        CompressBuffer buffer(in);
+        std::vector<char> chunk(blockBytes);
+        length = 0;
+        std::streamsize got = 0;
+        while ((got = buffer.sgetn(chunk.data(), static_cast<std::streamsize>(chunk.size()))) > 0) {
+            length += static_cast<uint64_t>(got);
+        }
+        in.clear();
+        return static_cast<bool>(in.seekg(position));
+    }
+
+    /**
+     * @brief Decompressing whole payload
+     * @function decompress
+     * @param in -> compressed payload<br>
+     * @param size -> compressed size (in 'bytes')<br>
+     * @param out -> decompressed payload<br>
+     * @details Output grows block by block by the sizes the blocks actually produce, so memory follows the
+     *          decompressed data and not the number of blocks. Returns false when a block is empty, corrupted or
+     *          truncated, or when the output would exceed maxOutputBytes.
+     */
+
+    inline auto decompress(const unsigned char* in, std::size_t size, std::vector<unsigned char>& out) -> bool {
+        constexpr std::size_t slack = 16;
+
+        out.clear();
+        std::size_t produced = 0;
+        for (std::size_t position = 0; position < size;) {
+            if (size - position < 4) return false;
+            uint32_t word = read32(in + position);
+            std::size_t blockSize = word & ~rawBlock;
+            position += 4;
+            /// Encoder never writes an empty block, zero-size frames only come from crafted payloads
+            if (blockSize == 0 || blockSize > size - position || blockSize > bound(blockBytes)) return false;
+            if (produced + blockBytes > maxOutputBytes) return false;
+            out.resize(produced + blockBytes + slack);
+            std::size_t blockProduced = 0;
+            if (word & rawBlock) {
+                if (blockSize > blockBytes) return false;
+                std::memcpy(out.data() + produced, in + position, blockSize);
+                blockProduced = blockSize;
+            } else if (!decompressBlock(in + position, blockSize, out.data() + produced, blockProduced)) {
+                return false;
+            }
+            produced += blockProduced;
+            position += blockSize;
+        }
+        out.resize(produced);
+        return true;
+    }
+
+    inline auto decompress(std::vector<unsigned char>& data) -> bool {
+        std::vector<unsigned char> out;
+        if (!decompress(data.data(), data.size(), out)) return false;
+        data = std::move(out);
+        return true;
+    }
+}
@@ -0,0 +1,329 @@
+#pragma once
+
+#include <atomic>
+#include <cerrno>
+#include <csignal>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define STEG_POSIX 1
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#include "Batch.h"
+#include "Steg.h"
+#include "ThreadPool.h"
+
+/**
+ * @class CarrierCache
+ * @brief Parsed carriers kept in memory, least recently used ones are dropped first
+ * @var
+ * <b>limit</b> -> largest number of bytes held by all cached carriers<br>
+ * <b>used</b> -> number of bytes held by cached carriers<br>
+ * <b>order</b> -> cached carriers, most recently used first<br>
+ * <b>index</b> -> position of every cached path in the order<br>
+ * <b>hits</b>, <b>misses</b> -> number of requests served from the cache and from the disk
+ * @details A cached carrier is used only while modification time and size of its file are unchanged [one stat()
+ *          per request], otherwise it is read and parsed again. Carriers are shared read-only, encode works on a copy.
+ *          Carrier bigger than the whole limit is served, but not cached.
+ */
+
+class CarrierCache {
+public:
+    explicit CarrierCache(std::size_t limit) : limit(limit) {}
+
+    /**
+     * @brief Getting parsed carrier of the file
+     * @function get
+     * @param path -> path of the file(image)<br>
+     * @param status -> result of reading the carrier when it is not cached<br>
+     * @details Returns nullptr when the file cannot be read, status tells why
+     */
+
+    auto get(const std::string& path, steg::Status& status) -> std::shared_ptr<const steg::Carrier> {
+        std::error_code error;
+        auto modified = std::filesystem::last_write_time(path, error);
+        auto size = error ? 0 : std::filesystem::file_size(path, error);
+        if (error) {
+            status = steg::Status::IoError;
+            return nullptr;
+        }
+        status = steg::Status::Ok;
+        {
+            std::lock_guard lock(mutex);
+            auto found = index.find(path);
+            if (found != index.end() && found->second->modified == modified && found->second->size == size) {
+                order.splice(order.begin(), order, found->second);
+                ++hits;
+                return found->second->carrier;
+            }
+            ++misses;
+        }
+
+        /// Reading and parsing outside of the lock, so requests for other carriers go on meanwhile
+        auto carrier = std::make_shared<steg::Carrier>();
+        status = carrier->open(path);
+        if (status != steg::Status::Ok) return nullptr;
+
+        std::lock_guard lock(mutex);
+        remove(path);
+        std::size_t bytes = carrier->bytes().size();
+        if (bytes <= limit) {
+            order.push_front({path, carrier, modified, size});
+            index[path] = order.begin();
+            used += bytes;
+            while (used > limit) remove(order.back().path);
+        }
+        return carrier;
+    }
+
+    /// Number of cached carriers, bytes they hold, hits and misses
+    auto summary() -> std::string {
+        std::lock_guard lock(mutex);
+        return std::to_string(order.size()) + " carriers\t" + std::to_string(used) + " bytes\t"
+             + std::to_string(hits) + " hits\t" + std::to_string(misses) + " misses";
+    }
+
+private:
+    struct Entry {
+        std::string path;
+        std::shared_ptr<const steg::Carrier> carrier;
+        std::filesystem::file_time_type modified;
+        uintmax_t size;
+    };
+
+    /// Dropping cached carrier [mutex is held by the caller]
+    auto remove(const std::string& path) -> void {
+        auto found = index.find(path);
+        if (found == index.end()) return;
+        used -= found->second->carrier->bytes().size();
+        order.erase(found->second);
+        index.erase(found);
+    }
+
+    std::size_t limit;
+    std::size_t used = 0;
+    std::list<Entry> order;
+    std::unordered_map<std::string, std::list<Entry>::iterator> index;
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    std::mutex mutex;
+};
+
+namespace server {
+
+    /// Set by SIGINT/SIGTERM, the daemon stops accepting connections once it is set
+    inline volatile std::sig_atomic_t stopping = 0;
+
+    /// Longest request line (in 'bytes'), a connection sending a longer one is answered with a failure and closed
+    inline constexpr std::size_t maxLineBytes = std::size_t{1} << 16;
+
+    /**
+     * @brief Serving single request
+     * @function handle
+     * @param line -> request with tab separated fields<br>
+     * @param cache -> cache of parsed carriers<br>
+     * @param result -> output path, decrypted message, capacity or reason of the failure<br>
+     * @details Requests:<br>
+     *          &emsp;e &lt;TAB&gt; carrier &lt;TAB&gt; message &lt;TAB&gt; output [&lt;TAB&gt; z to compress]<br>
+     *          &emsp;d &lt;TAB&gt; carrier [&lt;TAB&gt; output]<br>
+     *          &emsp;c &lt;TAB&gt; carrier &lt;TAB&gt; message<br>
+     *          &emsp;s [cache and buffer pool statistics]<br>
+     *          Returns false when the request failed
+     */
+
+    inline auto handle(const std::string& line, CarrierCache& cache, std::string& result) -> bool {
+        auto fields = batch::splitFields(line);
+        const std::string& operation = fields[0];
+        if (operation == "s" && fields.size() == 1) {
+            result = cache.summary() + '\t' + buffers::Pool::shared().summary();
+            return true;
+        }
+        bool encrypt = operation == "e" && (fields.size() == 4 || (fields.size() == 5 && fields[4] == "z"));
+        bool decrypt = operation == "d" && (fields.size() == 2 || fields.size() == 3);
+        bool check = operation == "c" && fields.size() == 3;
+        if (!encrypt && !decrypt && !check) {
+            result = "malformed request";
+            return false;
+        }
+
+        steg::Status status;
+        auto carrier = cache.get(fields[1], status);
+        if (carrier && encrypt) {
+            /// Cached carrier stays untouched, message goes into a copy of its bytes
+            steg::Carrier copy = *carrier;
+            steg::EncodeOptions options;
+            options.compress = fields.size() == 5;
+            status = copy.encode(reinterpret_cast<const unsigned char*>(fields[2].data()), fields[2].size(), options);
+            if (status == steg::Status::Ok) status = copy.save(fields[3]);
+            if (status == steg::Status::Ok) result = fields[3];
+        } else if (carrier && decrypt) {
+            std::vector<unsigned char> message;
+            status = carrier->decode(message);
+            if (status == steg::Status::Ok && fields.size() == 3) {
+                std::ofstream out(fields[2], std::ios::binary);
+                if (!out.write(reinterpret_cast<const char*>(message.data()), static_cast<std::streamsize>(message.size())))
+                    status = steg::Status::IoError;
+                result = fields[2];
+            } else if (status == steg::Status::Ok) {
+                result.assign(message.begin(), message.end());
+            }
+        } else if (carrier && check) {
+            result = std::to_string(carrier->info().capacity);
+            if (fields[2].size() > carrier->info().capacity) status = steg::Status::MessageTooLarge;
+        }
+        if (status != steg::Status::Ok) result = steg::describe(status);
+        return status == steg::Status::Ok;
+    }
+
+#if defined(STEG_POSIX)
+
+    /// Writing all bytes to the socket
+    inline auto sendAll(int socket, const char* data, std::size_t size) -> bool {
+        while (size > 0) {
+            ssize_t sent = ::send(socket, data, size, 0);
+            if (sent < 0 && errno == EINTR) continue;
+            if (sent <= 0) return false;
+            data += sent;
+            size -= static_cast<std::size_t>(sent);
+        }
+        return true;
+    }
+
+    /// Answering a request line over maxLineBytes [the caller closes the connection]
+    inline auto refuseLine(int socket) -> void {
+        const std::string result = "request is longer than " + std::to_string(maxLineBytes) + " bytes";
+        const std::string response = "failed\t" + std::to_string(result.size()) + '\n' + result;
+        sendAll(socket, response.data(), response.size());
+    }
+
+    /**
+     * @brief Serving requests of one connection until the client closes it
+     * @function serve
+     * @param socket -> connected socket<br>
+     * @param cache -> cache of parsed carriers<br>
+     * @details Every request is one line, every response is a status line followed by the result:<br>
+     *          &emsp;ok|failed &lt;TAB&gt; size of the result (in 'bytes') &lt;LF&gt; result<br>
+     *          so decrypted messages of any bytes can be returned. A line longer than maxLineBytes is not buffered
+     *          any further: it gets a failure response and the connection is closed.
+     */
+
+    inline auto serve(int socket, CarrierCache& cache) -> void {
+        std::string pending;
+        std::vector<char> buffer(1 << 16);
+        while (true) {
+            ssize_t got = ::recv(socket, buffer.data(), buffer.size(), 0);
+            if (got < 0 && errno == EINTR) continue;
+            if (got <= 0) return;
+            pending.append(buffer.data(), static_cast<std::size_t>(got));
+
+            std::size_t start = 0;
+            for (std::size_t end; (end = pending.find('\n', start)) != std::string::npos; start = end + 1) {
+                if (end - start > maxLineBytes) return refuseLine(socket);
+                std::string line = pending.substr(start, end - start);
+                if (!line.empty() && line.back() == '\r') line.pop_back();
+                if (line.empty()) continue;
+                std::string result;
+                bool ok = handle(line, cache, result);
+                std::string response = std::string(ok ? "ok" : "failed") + '\t' + std::to_string(result.size()) + '\n' + result;
+                if (!sendAll(socket, response.data(), response.size())) return;
+            }
+            pending.erase(0, start);
+            if (pending.size() > maxLineBytes) return refuseLine(socket);
+        }
+    }
+
+    /**
+     * @brief Running the daemon
+     * @function run
+     * @param path -> path of the Unix domain socket<br>
+     * @param workers -> number of connections served at once<br>
+     * @param cacheBytes -> memory limit of the carrier cache (in 'bytes')<br>
+     * @flags -daemon socket [-workers N] [-cache MB]
+     * @details Connections are served on a pool of their own, bands of large images still go to the shared pool.
+     *          SIGINT/SIGTERM stop the daemon, open connections are shut down and the socket file is removed.
+     */
+
+    inline auto run(const std::string& path, std::size_t workers, std::size_t cacheBytes) -> bool {
+        sockaddr_un address{};
+        if (path.empty() || path.size() >= sizeof(address.sun_path)) {
+            std::cerr << "Socket path is empty or too long! Path provided: " << path << std::endl;
+            return false;
+        }
+        address.sun_family = AF_UNIX;
+        path.copy(address.sun_path, path.size());
+
+        /// Removing socket left by a previous run [never a regular file]
+        struct stat existing{};
+        if (::lstat(path.c_str(), &existing) == 0 && S_ISSOCK(existing.st_mode)) ::unlink(path.c_str());
+
+        int listener = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        if (listener < 0 || ::bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0
+            || ::listen(listener, 64) != 0) {
+            std::cerr << "Unable to listen on the socket! Path provided: " << path << std::endl;
+            if (listener >= 0) ::close(listener);
+            return false;
+        }
+        std::signal(SIGPIPE, SIG_IGN);
+        std::signal(SIGINT, [](int) { stopping = 1; });
+        std::signal(SIGTERM, [](int) { stopping = 1; });
+
+        /// Selecting kernel before the workers start [done once, not per request]
+        kernels::active();
+        CarrierCache cache(cacheBytes);
+        std::mutex connectionsMutex;
+        std::set<int> connections;
+        {
+            ThreadPool pool(workers);
+            std::cerr << "Listening on " << path << " [" << pool.size() << " workers, " << (cacheBytes >> 20)
+                      << " MB cache]" << std::endl;
+            while (!stopping) {
+                pollfd ready{listener, POLLIN, 0};
+                if (::poll(&ready, 1, 250) <= 0) continue;
+                int connection = ::accept(listener, nullptr, nullptr);
+                if (connection < 0) continue;
+                {
+                    std::lock_guard lock(connectionsMutex);
+                    connections.insert(connection);
+                }
+                pool.submit([connection, &cache, &connections, &connectionsMutex] {
+                    serve(connection, cache);
+                    std::lock_guard lock(connectionsMutex);
+                    connections.erase(connection);
+                    ::close(connection);
+                });
+            }
+
+            /// Waking connections blocked in recv, the pool is joined when it goes out of scope
+            std::lock_guard lock(connectionsMutex);
+            for (int connection : connections) ::shutdown(connection, SHUT_RDWR);
+        }
+        ::close(listener);
+        ::unlink(path.c_str());
+        std::cerr << "Daemon stopped." << std::endl;
+        return true;
+    }
+
+#else
+
+    inline auto run(const std::string& path, std::size_t, std::size_t) -> bool {
+        std::cerr << "Daemon needs Unix domain sockets, it is not available on this system! Path provided: " << path << std::endl;
+        return false;
+    }
+
+#endif
+}
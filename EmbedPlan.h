@@ -0,0 +1,464 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <numeric>
+#include <utility>
+
+#include "BitStream.h"
+#include "LSBKernels.h"
+#include "Scatter.h"
+#include "Stats.h"
+
+/**
+ * @file EmbedPlan.h
+ * @brief Which carrier bytes hold the payload and how many of their LSBs
+ * @details A plan is the bit density [LSBs changed in every used byte] and the color channels taking part.
+ *          With every channel the carrier is used byte after byte by the SIMD kernels of LSBKernels.h.
+ *          With some channels only, every combination of density, channel mask and pixel size is a kernel of
+ *          its own [template instance with constexpr masks and shifts], so the loop over whole pixels has no
+ *          branches: a pixel takes one read of (channels * density) payload bits, every used channel gets its
+ *          bits by a fixed shift.<br>
+ *          Payload bit of a used byte is a pure function of its carrier index, as with a whole carrier, so spans,
+ *          bands and streamed rows are still processed on their own.<br>
+ *          Formats with 16-bit samples use only the low byte of every sample. Samples are big-endian, so the low
+ *          byte is the second one and the same kernels serve them with a mask of every other byte, no byte swap
+ *          is needed.<br>
+ *          Plan scattered by a key [Scatter.h] uses the same bytes and bits, only the order of payload symbols over
+ *          them changes: symbol i lands in the used byte permutation(i) instead of the i-th one.
+ */
+
+namespace plans {
+
+    /// Samples holding PayloadHeader [16 bytes at 1 LSB, see PayloadHeader.h]
+    inline constexpr uint64_t headerCarrierBytes = 128;
+
+    /// Carrier bytes holding PayloadHeader in a format [the first 128 samples]
+    template <typename Format>
+    inline constexpr uint64_t headerCarrierOf = headerCarrierBytes * Format::sampleBytes;
+
+    /// Color channels in the order of their bits [channel mask given by the user and stored in PayloadHeader]
+    inline constexpr uint8_t red = 0x01;
+    inline constexpr uint8_t green = 0x02;
+    inline constexpr uint8_t blue = 0x04;
+    inline constexpr uint8_t alpha = 0x08;
+    /// Default channels of every format, alpha takes part only when asked for
+    inline constexpr uint8_t allChannels = red | green | blue;
+
+    /// Largest density of a plan using some channels only
+    inline constexpr int maxMaskedDensity = 4;
+    /// Largest bytes per pixel of a plan using some channels only [16-bit RGBA]
+    inline constexpr std::size_t maxPixelBytes = 8;
+
+    /// Mask of the bytes of a pixel holding LSBs of the channels
+    template <typename Format>
+    constexpr auto storedMask(uint8_t channels) -> unsigned {
+        unsigned stored = 0;
+        if (channels & red) stored |= 1u << Format::red;
+        if (channels & green) stored |= 1u << Format::green;
+        if (channels & blue) stored |= 1u << Format::blue;
+        if (Format::hasAlpha && (channels & alpha)) stored |= 1u << Format::alpha;
+        return stored;
+    }
+
+    /**
+     * @brief Embedding and extracting PayloadHeader
+     * @function embedHeader, extractHeader
+     * @param carrier -> first byte of the span<br>
+     * @param first -> carrier index of the first byte, span ends at or before headerCarrierOf the format<br>
+     * @param count -> number of carrier bytes<br>
+     * @param header -> 16 header bytes<br>
+     * @param sampleBytes -> size of one sample of the format<br>
+     * @details Header bit i is the LSB of sample i [of its low byte]
+     */
+
+    inline auto embedHeader(unsigned char* carrier, uint64_t first, std::size_t count, const unsigned char* header,
+                            std::size_t sampleBytes) -> void {
+        if (sampleBytes == 1) {
+            kernels::embed(carrier, count, header, first, 1);
+            return;
+        }
+        for (std::size_t i = 0; i < count; ++i) {
+            uint64_t index = first + i;
+            if (index % sampleBytes != sampleBytes - 1) continue;
+            uint64_t bit = index / sampleBytes;
+            carrier[i] = static_cast<unsigned char>((carrier[i] & ~1u) | ((header[bit / 8] >> (7 - bit % 8)) & 1u));
+        }
+    }
+
+    inline auto extractHeader(const unsigned char* carrier, uint64_t first, std::size_t count, unsigned char* header,
+                              std::size_t sampleBytes) -> void {
+        if (sampleBytes == 1) {
+            kernels::extract(carrier, count, header, first, 1);
+            return;
+        }
+        for (std::size_t i = 0; i < count; ++i) {
+            uint64_t index = first + i;
+            if (index % sampleBytes != sampleBytes - 1) continue;
+            uint64_t bit = index / sampleBytes;
+            auto mask = static_cast<unsigned char>(0x80u >> (bit % 8));
+            header[bit / 8] = static_cast<unsigned char>((carrier[i] & 1u) ? header[bit / 8] | mask : header[bit / 8] & ~mask);
+        }
+    }
+
+    /**
+     * @brief Function types of kernels using some bytes of every pixel
+     * @var
+     * <b>MaskedEmbedFn</b> -> used bytes of the span receive payload bits from bitOffset on, phase is the byte of the
+     *                         pixel the span starts at, payload is read only up to payloadBytes [zero bits after]<br>
+     * <b>MaskedExtractFn</b> -> LSBs of used bytes are stored into the same payload bits
+     */
+
+    using MaskedEmbedFn = void (*)(unsigned char* carrier, std::size_t count, std::size_t phase,
+                                   const unsigned char* payload, uint64_t bitOffset, std::size_t payloadBytes);
+    using MaskedExtractFn = void (*)(const unsigned char* carrier, std::size_t count, std::size_t phase,
+                                     unsigned char* payload, uint64_t bitOffset);
+
+    /**
+     * @brief Constant masks and shifts of one kernel
+     * @struct Shape
+     * @var
+     * <b>used</b> -> number of used bytes in a pixel<br>
+     * <b>pixelBits</b> -> payload bits embedded into one pixel<br>
+     * <b>low</b> -> LSBs holding payload in a used byte<br>
+     * <b>shift</b> -> position of the bits of every byte of a pixel inside of its pixelBits [first used byte highest]
+     */
+
+    template <int density, unsigned stored, std::size_t pixelBytes>
+    struct Shape {
+        static constexpr int used = std::popcount(stored);
+        static constexpr int pixelBits = used * density;
+        static constexpr auto low = static_cast<unsigned char>((1u << density) - 1);
+        static constexpr auto shift = [] {
+            std::array<int, pixelBytes> shifts{};
+            int rank = 0;
+            for (std::size_t byte = 0; byte < pixelBytes; ++byte) {
+                if (stored & (1u << byte)) shifts[byte] = (used - 1 - rank++) * density;
+            }
+            return shifts;
+        }();
+
+        static constexpr auto isUsed(std::size_t byte) -> bool { return stored & (1u << byte); }
+    };
+
+    /**
+     * @brief Kernels of one plan using some channels only
+     * @function embedMasked, extractMasked
+     * @details Bytes up to the first whole pixel and after the last one go through a short loop with a mask test,
+     *          whole pixels are unrolled at compile time [fold over the bytes of a pixel]
+     */
+
+    template <int density, unsigned stored, std::size_t pixelBytes>
+    inline auto embedMasked(unsigned char* carrier, std::size_t count, std::size_t phase,
+                            const unsigned char* payload, uint64_t bitOffset, std::size_t payloadBytes) -> void {
+        using S = Shape<density, stored, pixelBytes>;
+        bits::BitReader reader(payload, payloadBytes);
+        reader.seek(bitOffset);
+        auto put = [&](unsigned char& byte, unsigned symbol) {
+            byte = static_cast<unsigned char>((byte & ~S::low) | symbol);
+        };
+
+        std::size_t i = 0;
+        for (; i < count && phase != 0; ++i, phase = (phase + 1) % pixelBytes) {
+            if (S::isUsed(phase)) put(carrier[i], reader.read(density));
+        }
+        for (; i + pixelBytes <= count; i += pixelBytes) {
+            const uint32_t chunk = reader.read(S::pixelBits);
+            [&]<std::size_t... byte>(std::index_sequence<byte...>) {
+                ((S::isUsed(byte) ? put(carrier[i + byte], (chunk >> S::shift[byte]) & S::low) : void()), ...);
+            }(std::make_index_sequence<pixelBytes>{});
+        }
+        for (std::size_t byte = 0; i < count; ++i, ++byte) {
+            if (S::isUsed(byte)) put(carrier[i], reader.read(density));
+        }
+    }
+
+    template <int density, unsigned stored, std::size_t pixelBytes>
+    inline auto extractMasked(const unsigned char* carrier, std::size_t count, std::size_t phase,
+                              unsigned char* payload, uint64_t bitOffset) -> void {
+        using S = Shape<density, stored, pixelBytes>;
+        bits::BitWriter writer(payload, bitOffset);
+
+        std::size_t i = 0;
+        for (; i < count && phase != 0; ++i, phase = (phase + 1) % pixelBytes) {
+            if (S::isUsed(phase)) writer.write(carrier[i] & S::low, density);
+        }
+        for (; i + pixelBytes <= count; i += pixelBytes) {
+            uint32_t chunk = 0;
+            [&]<std::size_t... byte>(std::index_sequence<byte...>) {
+                ((chunk |= S::isUsed(byte) ? uint32_t(carrier[i + byte] & S::low) << S::shift[byte] : 0u), ...);
+            }(std::make_index_sequence<pixelBytes>{});
+            writer.write(chunk, S::pixelBits);
+        }
+        for (std::size_t byte = 0; i < count; ++i, ++byte) {
+            if (S::isUsed(byte)) writer.write(carrier[i] & S::low, density);
+        }
+        writer.flush();
+    }
+
+    /**
+     * @struct MaskedKernel
+     * @brief Pair of kernels of one density, channel mask and pixel size
+     */
+
+    struct MaskedKernel {
+        MaskedEmbedFn embed = nullptr;
+        MaskedExtractFn extract = nullptr;
+    };
+
+    /// Kernels of a format for every density [1..maxMaskedDensity] and every channel mask [red..alpha]
+    template <typename Format>
+    inline constexpr auto maskedKernels = [] {
+        constexpr std::size_t masks = 16;
+        constexpr std::size_t pixelBytes = Format::bytesPerPixel;
+        std::array<std::array<MaskedKernel, masks>, maxMaskedDensity> table{};
+        [&]<std::size_t... index>(std::index_sequence<index...>) {
+            ((table[index / masks][index % masks] = {
+                    embedMasked<int(index / masks) + 1, storedMask<Format>(index % masks ? index % masks : allChannels), pixelBytes>,
+                    extractMasked<int(index / masks) + 1, storedMask<Format>(index % masks ? index % masks : allChannels), pixelBytes>}),
+             ...);
+        }(std::make_index_sequence<maxMaskedDensity * masks>{});
+        return table;
+    }();
+
+    /**
+     * @class Plan
+     * @brief Carrier bytes and bits of them holding the payload
+     * @var
+     * <b>bitsPerByte</b> -> payload bits per used carrier byte<br>
+     * <b>colors</b> -> used color channels [red | green | blue | alpha]<br>
+     * <b>sampleSize</b> -> bytes of one sample of the format [header takes 128 of them]<br>
+     * <b>pixelSize</b> -> bytes of one pixel of the format [--stats counts touched pixels by it]<br>
+     * <b>pixelBytes</b> -> size of the repeating group of carrier bytes, 1 when every byte is used<br>
+     * <b>used</b> -> number of used bytes in the group<br>
+     * <b>before</b> -> number of used bytes of the group before every byte of it<br>
+     * <b>position</b> -> byte of the group of every used byte<br>
+     * <b>start</b> -> carrier index of the first payload byte<br>
+     * <b>kernel</b> -> kernels of the plan, unused when every byte is used [LSBKernels.h]<br>
+     * <b>order</b> -> keyed order of payload symbols over used bytes<br>
+     * <b>check</b> -> check value of the key stored in PayloadHeader<br>
+     * <b>keyed</b> -> payload symbols follow the order [scatterBy]
+     * @details Header always takes the first 128 samples at 1 LSB [it is read before the plan is known].
+     *          Payload starts right after it when every byte is used. Otherwise it starts at the next multiple of
+     *          a pixel and of 64 bytes, so band borders [multiples of bandBytes()] fall on whole payload bytes
+     *          for every density and no two bands write the same message byte.
+     */
+
+    class Plan {
+    public:
+        /// Every carrier byte at the given density
+        explicit Plan(int density = 1) : bitsPerByte(density) {}
+
+        /**
+         * @brief Plan of a pixel format
+         * @function of
+         * @param density -> payload bits per used byte<br>
+         * @param channels -> used color channels, every byte is used when they cover the whole pixel<br>
+         * @details Channels are mapped to bytes by the order of the format [B, G, R for BMP], only the low byte of
+         *          a 16-bit sample is used, every color of a gray format is its only sample. Returns false when density or channels are out of range or alpha is
+         *          asked for a format without it [only in that case the plan is left unchanged].
+         */
+
+        template <typename Format>
+        static auto of(int density, uint8_t channels, Plan& plan) -> bool {
+            if (density < 1 || density > 8 || channels == 0 || (channels & ~(allChannels | alpha))) return false;
+            if (!Format::hasAlpha && (channels & alpha)) return false;
+            Plan result(density);
+            result.colors = channels;
+            result.sampleSize = Format::sampleBytes;
+            result.pixelSize = Format::bytesPerPixel;
+            if constexpr (Format::bytesPerPixel > 1 && Format::bytesPerPixel <= maxPixelBytes) {
+                const unsigned stored = storedMask<Format>(channels);
+                if (stored == (1u << Format::bytesPerPixel) - 1) {
+                    plan = result;
+                    return true;
+                }
+                if (density > maxMaskedDensity) return false;
+                result.pixelBytes = Format::bytesPerPixel;
+                result.used = 0;
+                for (std::size_t byte = 0; byte < result.pixelBytes; ++byte) {
+                    result.before[byte] = result.used;
+                    if (stored & (1u << byte)) result.position[result.used++] = static_cast<uint8_t>(byte);
+                }
+                result.before[result.pixelBytes] = result.used;
+                const uint64_t unit = std::lcm<uint64_t>(result.pixelBytes, 64);
+                result.start = (headerCarrierOf<Format> + unit - 1) / unit * unit;
+                result.kernel = maskedKernels<Format>[density - 1][channels];
+            } else if (Format::bytesPerPixel > maxPixelBytes && channels != allChannels) {
+                return false;
+            }
+            plan = result;
+            return true;
+        }
+
+        auto density() const -> int { return bitsPerByte; }
+        auto channels() const -> uint8_t { return colors; }
+        auto everyByte() const -> bool { return pixelBytes == 1; }
+        auto payloadStart() const -> uint64_t { return start; }
+        auto sampleBytes() const -> std::size_t { return sampleSize; }
+        /// Carrier index after the bytes holding the header
+        auto headerEnd() const -> uint64_t { return headerCarrierBytes * sampleSize; }
+
+        /// Carrier bytes of one parallel band [about 1 MB, a multiple of the unit payloadStart() is aligned to]
+        auto bandBytes() const -> uint64_t { return std::lcm<uint64_t>(pixelBytes, 64) << 14; }
+
+        /// Number of used bytes before the carrier index
+        auto usedBefore(uint64_t index) const -> uint64_t {
+            return index / pixelBytes * used + before[index % pixelBytes];
+        }
+
+        /// Payload bit held by the first used byte at or after the carrier index [index at least payloadStart()]
+        auto bitOf(uint64_t index) const -> uint64_t {
+            return (usedBefore(index) - usedBefore(start)) * bitsPerByte;
+        }
+
+        /// Carrier index after the byte holding the last of 'symbols' payload symbols from the index on
+        auto advance(uint64_t index, uint64_t symbols) const -> uint64_t {
+            if (symbols == 0) return index;
+            uint64_t last = usedBefore(index) + symbols - 1;
+            return last / used * pixelBytes + position[last % used] + 1;
+        }
+
+        /// Carrier index after the last byte holding the first 'bits' payload bits
+        auto endOf(uint64_t bits) const -> uint64_t {
+            return advance(start, (bits + bitsPerByte - 1) / bitsPerByte);
+        }
+
+        /// Number of used bytes from payloadStart() to the end of carrier of the given size
+        auto slots(uint64_t carrierBytes) const -> uint64_t {
+            return carrierBytes > start ? usedBefore(carrierBytes) - usedBefore(start) : 0;
+        }
+
+        /// Number of message bytes that fit into carrier of the given size
+        auto capacity(uint64_t carrierBytes) const -> uint64_t { return slots(carrierBytes) * bitsPerByte / 8; }
+
+        /// Checking whether the carrier byte holds payload bits
+        auto isUsed(uint64_t index) const -> bool {
+            return before[index % pixelBytes + 1] != before[index % pixelBytes];
+        }
+
+        /**
+         * @brief Scattering payload symbols over every used byte of the carrier in the order of the key
+         * @function scatterBy
+         * @param key -> key given by the user [not empty]<br>
+         * @param carrierBytes -> size of the whole carrier, encoder and decoder have to give the same one<br>
+         * @details Order does not depend on the length of the payload, so a payload of unknown size is scattered as
+         *          it is pulled. Header stays in the first 128 samples.
+         */
+
+        auto scatterBy(const scatter::Key& key, uint64_t carrierBytes) -> void {
+            order = scatter::Permutation(key, slots(carrierBytes));
+            check = key.check();
+            keyed = true;
+        }
+
+        auto scattered() const -> bool { return keyed; }
+        auto keyCheck() const -> uint16_t { return check; }
+
+        /// Carrier index of the used byte holding payload symbol [density bits], symbols follow each other without a key
+        auto symbolIndex(uint64_t symbol) const -> uint64_t { return advance(start, order.forward(symbol) + 1) - 1; }
+
+        /// Payload symbol held by the used byte with the given number [slots(index) of its carrier index] of a scattered plan
+        auto symbolOf(uint64_t slot) const -> uint64_t { return order.inverse(slot); }
+
+        /**
+         * @brief Embedding payload bits into used bytes of a span
+         * @function embed
+         * @param carrier -> first byte of the span<br>
+         * @param first -> carrier index of the first byte<br>
+         * @param count -> number of carrier bytes, only used bytes up to the end bit are changed<br>
+         * @param payload -> payload bytes<br>
+         * @param bitOffset -> payload bit of the first used byte of the span<br>
+         * @param endBit -> payload bit after the last one to embed<br>
+         * @details Last used byte may be only partly covered by the payload, its remaining LSBs are cleared.
+         *          Carrier bytes after the last embedded bit are left untouched.
+         */
+
+        auto embed(unsigned char* carrier, uint64_t first, std::size_t count, const unsigned char* payload,
+                   uint64_t bitOffset, uint64_t endBit) const -> void {
+            if (bitOffset >= endBit) return;
+            const uint64_t symbols = (endBit - bitOffset + bitsPerByte - 1) / bitsPerByte;
+            auto bytes = static_cast<std::size_t>(std::min<uint64_t>(count, advance(first, symbols) - first));
+            countPixels(first, bytes);
+            if (!everyByte()) {
+                stats::addCarrier(bytes);
+                kernel.embed(carrier, bytes, first % pixelBytes, payload, bitOffset,
+                             static_cast<std::size_t>((endBit + 7) / 8));
+                return;
+            }
+            int rest = 0;
+            if (bitOffset + bytes * bitsPerByte > endBit) {
+                --bytes;
+                rest = static_cast<int>(endBit - bitOffset - bytes * bitsPerByte);
+            }
+            kernels::embed(carrier, bytes, payload, bitOffset, bitsPerByte);
+            if (rest) {
+                bits::BitReader reader(payload, static_cast<std::size_t>((endBit + 7) / 8));
+                reader.seek(bitOffset + bytes * bitsPerByte);
+                unsigned char& lastByte = carrier[bytes];
+                auto lowBits = static_cast<unsigned char>((1u << bitsPerByte) - 1);
+                lastByte = static_cast<unsigned char>((lastByte & ~lowBits) | (reader.read(rest) << (bitsPerByte - rest)));
+            }
+        }
+
+        /**
+         * @brief Extracting payload bits from used bytes of a span
+         * @function extract
+         * @param carrier -> first byte of the span<br>
+         * @param first -> carrier index of the first byte<br>
+         * @param count -> number of carrier bytes<br>
+         * @param payload -> destination payload bytes<br>
+         * @param bitOffset -> payload bit of the first used byte of the span<br>
+         * @param endBit -> payload bit after the last one to extract, bits after it are not written<br>
+         */
+
+        auto extract(const unsigned char* carrier, uint64_t first, std::size_t count, unsigned char* payload,
+                     uint64_t bitOffset, uint64_t endBit) const -> void {
+            if (bitOffset >= endBit) return;
+            const uint64_t whole = (endBit - bitOffset) / bitsPerByte;
+            const auto rest = static_cast<int>((endBit - bitOffset) % bitsPerByte);
+            auto bytes = static_cast<std::size_t>(std::min<uint64_t>(count, advance(first, whole) - first));
+            if (everyByte()) {
+                kernels::extract(carrier, bytes, payload, bitOffset, bitsPerByte);
+            } else {
+                stats::addCarrier(bytes);
+                kernel.extract(carrier, bytes, first % pixelBytes, payload, bitOffset);
+            }
+
+            /// Last used byte may hold bits past the end of the payload
+            uint64_t last = advance(first, whole + 1) - 1;
+            countPixels(first, rest && last < first + count ? last + 1 - first : bytes);
+            if (rest && last < first + count) {
+                bits::BitWriter writer(payload, bitOffset + whole * bitsPerByte);
+                writer.write(carrier[last - first] >> (bitsPerByte - rest), rest);
+                writer.flush();
+            }
+        }
+
+    private:
+        /// Adding pixels of the span to --stats, a pixel split by a span border counts in the span holding its first byte
+        auto countPixels(uint64_t first, uint64_t bytes) const -> void {
+            if (!stats::enabled() || bytes == 0) return;
+            const uint64_t from = first / pixelSize + (first % pixelSize && first > start);
+            const uint64_t to = (first + bytes + pixelSize - 1) / pixelSize;
+            if (to > from) stats::addPixels(to - from);
+        }
+
+        int bitsPerByte;
+        uint8_t colors = allChannels;
+        std::size_t sampleSize = 1;
+        std::size_t pixelSize = 1;
+        std::size_t pixelBytes = 1;
+        uint64_t used = 1;
+        std::array<uint64_t, maxPixelBytes + 1> before{0, 1};
+        std::array<uint8_t, maxPixelBytes> position{0};
+        uint64_t start = headerCarrierBytes;
+        MaskedKernel kernel;
+        scatter::Permutation order;
+        uint16_t check = 0;
+        bool keyed = false;
+    };
+}
@@ -0,0 +1,208 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "Stats.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#define STEG_POSIX 1
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if defined(__linux__)
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <sys/sendfile.h>
+#endif
+
+/**
+ * @file FileCopy.h
+ * @brief Writing a changed copy of a file without passing its unchanged bytes through user space
+ * @details Embedding changes only a prefix of the pixel data, so an encrypted file is its source with the first
+ *          bytes replaced. The copy is made by the cheapest way the system offers:<br>
+ *              &emsp;&emsp;- reflink [FICLONE] -> output shares blocks of the source, only replaced blocks are written<br>
+ *              &emsp;&emsp;- copy_file_range -> bytes are copied inside the kernel [server-side on network filesystems]<br>
+ *              &emsp;&emsp;- sendfile -> bytes are copied inside the kernel through the page cache<br>
+ *              &emsp;&emsp;- pread/pwrite -> portable fallback with a fixed buffer<br>
+ *          Every way falls back to the next one when the filesystem or kernel does not support it.
+ */
+
+namespace filecopy {
+
+    /// Size of the buffer of the user space fallback
+    inline constexpr std::size_t fallbackBytes = std::size_t{1} << 20;
+
+#if defined(STEG_POSIX)
+
+    /// Writing all bytes at the given position of the file
+    inline auto writeAt(int descriptor, const unsigned char* data, std::size_t size, uint64_t offset) -> bool {
+        while (size > 0) {
+            ssize_t done = ::pwrite(descriptor, data, size, static_cast<off_t>(offset));
+            if (done < 0 && errno == EINTR) continue;
+            if (done <= 0) return false;
+            data += done;
+            offset += static_cast<uint64_t>(done);
+            size -= static_cast<std::size_t>(done);
+        }
+        return true;
+    }
+
+    /**
+     * @brief Copying byte range between files, both files use the same offsets
+     * @function copyRange
+     * @param in -> source descriptor<br>
+     * @param out -> destination descriptor<br>
+     * @param offset -> offset of the first byte (in 'bytes')<br>
+     * @param count -> number of bytes to copy<br>
+     * @details Tries copy_file_range, then sendfile, then copies through a buffer. Returns false when the source
+     *          ends too early or writing fails.
+     */
+
+    inline auto copyRange(int in, int out, uint64_t offset, uint64_t count) -> bool {
+#if defined(__linux__)
+        /// Kernel copy, EXDEV/ENOSYS/EINVAL mean it is not available for this pair of files
+        bool kernel = true;
+        while (count > 0 && kernel) {
+            auto inOffset = static_cast<off_t>(offset);
+            auto outOffset = static_cast<off_t>(offset);
+            ssize_t done = ::copy_file_range(in, &inOffset, out, &outOffset, static_cast<std::size_t>(count), 0);
+            if (done < 0 && errno == EINTR) continue;
+            if (done == 0) return false;
+            if (done < 0) {
+                kernel = false;
+                break;
+            }
+            offset += static_cast<uint64_t>(done);
+            count -= static_cast<uint64_t>(done);
+        }
+
+        /// sendfile writes at the position of the destination, so it is moved to the offset first
+        if (count > 0 && ::lseek(out, static_cast<off_t>(offset), SEEK_SET) >= 0) {
+            while (count > 0) {
+                auto inOffset = static_cast<off_t>(offset);
+                ssize_t done = ::sendfile(out, in, &inOffset, static_cast<std::size_t>(std::min<uint64_t>(count, 1u << 30)));
+                if (done < 0 && errno == EINTR) continue;
+                if (done == 0) return false;
+                if (done < 0) break;
+                offset += static_cast<uint64_t>(done);
+                count -= static_cast<uint64_t>(done);
+            }
+        }
+#endif
+        std::vector<unsigned char> buffer(static_cast<std::size_t>(std::min<uint64_t>(count, fallbackBytes)));
+        while (count > 0) {
+            ssize_t done = ::pread(in, buffer.data(), static_cast<std::size_t>(std::min<uint64_t>(count, buffer.size())),
+                                   static_cast<off_t>(offset));
+            if (done < 0 && errno == EINTR) continue;
+            if (done <= 0 || !writeAt(out, buffer.data(), static_cast<std::size_t>(done), offset)) return false;
+            offset += static_cast<uint64_t>(done);
+            count -= static_cast<uint64_t>(done);
+        }
+        return true;
+    }
+
+    /**
+     * @brief Opening the output as a copy of the source, only its first bytes are left to be written
+     * @function openPatched
+     * @param source -> path of the source file<br>
+     * @param output -> path of the output file, it may be the source itself<br>
+     * @param prefixSize -> number of bytes the caller writes at the start of the output<br>
+     * @param size -> size of the source (in 'bytes')<br>
+     * @details Bytes after the prefix are reflinked or copied by the kernel [see the file comment], --stats counts
+     *          them apart from the written ones [bytes_copied]. Returns the
+     *          descriptor of the output [closed by the caller] or -1 when a file cannot be opened or copied.
+     */
+
+    inline auto openPatched(const std::string& source, const std::string& output, std::size_t prefixSize,
+                            uint64_t& size) -> int {
+        int in = ::open(source.c_str(), O_RDONLY);
+        if (in < 0) return -1;
+        struct stat sourceStatus{};
+        struct stat outputStatus{};
+        if (::fstat(in, &sourceStatus) != 0 || static_cast<uint64_t>(sourceStatus.st_size) < prefixSize) {
+            ::close(in);
+            return -1;
+        }
+        size = static_cast<uint64_t>(sourceStatus.st_size);
+
+        /// Truncating output that is the source itself would destroy the bytes still to be copied
+        bool inPlace = ::stat(output.c_str(), &outputStatus) == 0 && outputStatus.st_dev == sourceStatus.st_dev
+                       && outputStatus.st_ino == sourceStatus.st_ino;
+        int out = ::open(output.c_str(), inPlace ? O_WRONLY : O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (out < 0) {
+            ::close(in);
+            return -1;
+        }
+
+        bool copied = inPlace;
+#if defined(__linux__) && defined(FICLONE)
+        /// Reflink shares all blocks of the source, writing the prefix then unshares only the blocks it covers
+        if (!copied) copied = ::ioctl(out, FICLONE, in) == 0;
+#endif
+        if (!copied && !copyRange(in, out, prefixSize, size - prefixSize)) {
+            ::close(out);
+            out = -1;
+        } else if (!inPlace) {
+            stats::addCopied(size - prefixSize);
+        }
+        ::close(in);
+        return out;
+    }
+
+#endif
+
+    /**
+     * @brief Writing copy of the source file with its first bytes replaced
+     * @function writePatched
+     * @param source -> path of the source file<br>
+     * @param output -> path of the written file, it may be the source itself<br>
+     * @param prefix -> bytes replacing the start of the source<br>
+     * @param prefixSize -> number of replaced bytes, at most the size of the source<br>
+     * @details Only the prefix is written from user space, the rest of the file is reflinked or copied by the
+     *          kernel [see the file comment]. When output is the source, only the prefix is written in place.
+     *          Returns false when a file cannot be opened, read or written.
+     */
+
+    inline auto writePatched(const std::string& source, const std::string& output, const unsigned char* prefix,
+                             std::size_t prefixSize) -> bool {
+        stats::Timer timer(stats::Phase::Write);
+#if defined(STEG_POSIX)
+        uint64_t size = 0;
+        int out = openPatched(source, output, prefixSize, size);
+        if (out < 0) return false;
+        bool ok = writeAt(out, prefix, prefixSize, 0);
+        ok = ::close(out) == 0 && ok;
+        const uint64_t written = prefixSize;
+#else
+        std::error_code error;
+        const bool inPlace = std::filesystem::equivalent(source, output, error);
+        const uint64_t size = std::filesystem::file_size(source, error);
+        if (error || size < prefixSize) return false;
+        std::ifstream in(source, std::ios::binary);
+        std::ofstream out(output, inPlace ? std::ios::binary | std::ios::in | std::ios::out : std::ios::binary);
+        bool ok = in && out.write(reinterpret_cast<const char*>(prefix), static_cast<std::streamsize>(prefixSize));
+        in.seekg(static_cast<std::streamoff>(prefixSize));
+        std::vector<char> buffer(fallbackBytes);
+        while (ok && !inPlace && in) {
+            in.read(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+            ok = static_cast<bool>(out.write(buffer.data(), in.gcount()));
+        }
+        out.close();
+        ok = ok && out;
+        const uint64_t written = inPlace ? prefixSize : size;
+#endif
+        if (!ok) return false;
+        timer.stop();
+        stats::addWritten(written);
+        stats::syncFile(output);
+        return true;
+    }
+}
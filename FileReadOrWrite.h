@@ -1,24 +1,156 @@
 #pragma once
 
+#include <array>
+#include <cctype>
+#include <charconv>
+#include <cstring>
+#include <string_view>
+
 #include "BMPHeaderStruct.h"
+#include "BufferPool.h"
 #include "PPMHeaderStruct.h"
+#include "MappedFile.h"
+#include "Netpbm.h"
+#include "RangeFile.h"
+#include "Stats.h"
+
+/**
+ * @brief Image format recognized by the file extension
+ * @details Used where many files are handled at once [batch, carrier catalog], so regex is not built for every file
+ */
+
+namespace image {
+    enum class Format : uint8_t { Unknown, BMP, PPM };
+
+    inline auto formatOf(std::string_view path) -> Format {
+        if (path.size() > 4 && path.substr(path.size() - 4) == ".bmp") return Format::BMP;
+        if (path.size() <= 4) return Format::Unknown;
+        auto extension = path.substr(path.size() - 4);
+        if (extension == ".ppm" || extension == ".pgm" || extension == ".pnm" || extension == ".pam") return Format::PPM;
+        return Format::Unknown;
+    }
+}
 
 namespace bmp {
 
+    /// Payload bits per carrier byte [2 LSB of each byte]
+    inline constexpr int density = 2;
+
+    /// Compression of a 32-bit file whose channel masks follow BMP_FileInfoHeader [BI_BITFIELDS]
+    inline constexpr uint32_t bitFields = 3;
+    /// Size of the red, green and blue masks of a BI_BITFIELDS file (in 'bytes')
+    inline constexpr std::size_t maskBytes = 12;
+
     /**
-     * @brief Reading data from the file (.bmp)
-     * @function readFromBMP
+     * @brief Checking whether pixels of the file are stored in a supported layout
+     * @function isSupported
+     * @param fileInfoHeader -> object of BMP_FileInfoHeader struct<br>
+     * @param masks -> bytes right after BMP_FileInfoHeader [maskBytes of them], nullptr when they were not read<br>
+     * @details 24-bit [B, G, R] and 32-bit [B, G, R, A] pixels without compression are supported. A 32-bit
+     *          BI_BITFIELDS file is supported only when its masks describe the same B, G, R, A bytes.
+     */
+
+    inline auto isSupported(const BMP_FileInfoHeader& fileInfoHeader, const unsigned char* masks) -> bool {
+        if (fileInfoHeader.bitCount == 24) return fileInfoHeader.compression == 0;
+        if (fileInfoHeader.bitCount != 32) return false;
+        if (fileInfoHeader.compression == 0) return true;
+        if (fileInfoHeader.compression != bitFields || masks == nullptr) return false;
+        uint32_t red = 0, green = 0, blue = 0;
+        std::memcpy(&red, masks, 4);
+        std::memcpy(&green, masks + 4, 4);
+        std::memcpy(&blue, masks + 8, 4);
+        return red == 0x00FF0000 && green == 0x0000FF00 && blue == 0x000000FF;
+    }
+
+    /// Size of one stored row [rows are padded to a multiple of 4 bytes]
+    inline auto rowStride(const BMP_FileInfoHeader& fileInfoHeader) -> uint64_t {
+        return (uint64_t(fileInfoHeader.width) * (fileInfoHeader.bitCount / 8) + 3) / 4 * 4;
+    }
+
+    /**
+     * @brief Parsing headers of the file (.bmp) held in memory
+     * @function parseBMPHeaders
+     * @param data -> first bytes of the file<br>
+     * @param size -> number of bytes available<br>
+     * @param fileHeader -> object of BMP_FileHeader struct<br>
+     * @param fileInfoHeader -> object of BMP_FileInfoHeader struct<br>
+     * @details Prints nothing, so it is used by the library [Steg.h] as well. Returns false when the bytes are too
+     *          short to hold both headers.
+     */
+
+    inline auto parseBMPHeaders(const unsigned char* data, std::size_t size, BMP_FileHeader& fileHeader,
+                                BMP_FileInfoHeader& fileInfoHeader) -> bool
+    {
+        stats::Timer timer(stats::Phase::Header);
+        if (size < sizeof(BMP_FileHeader) + sizeof(BMP_FileInfoHeader)) {
+            return false;
+        }
+        std::memcpy(&fileHeader, data, sizeof(BMP_FileHeader));
+        std::memcpy(&fileInfoHeader, data + sizeof(BMP_FileHeader), sizeof(BMP_FileInfoHeader));
+        return true;
+    }
+
+    /**
+     * @brief Reading headers of the mapped file (.bmp)
+     * @function readBMPHeaders
+     * @param file -> mapped file(image)<br>
+     * @param fileHeader -> object of BMP_FileHeader struct<br>
+     * @param fileInfoHeader -> object of BMP_FileInfoHeader struct<br>
+     * @details This function is used to copy [file header and file information header] out of the mapped file,
+     *          pixel data is not touched
+     */
+
+    inline auto readBMPHeaders(const MappedFile& file, BMP_FileHeader& fileHeader,
+                               BMP_FileInfoHeader& fileInfoHeader) -> bool
+    {
+        if (!parseBMPHeaders(file.data(), file.size(), fileHeader, fileInfoHeader)) {
+            std::cerr << "Failed to read BMP header." << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    /**
+     * @brief Reading headers from the stream (.bmp)
+     * @function readBMPHeaders
+     * @param in -> input stream [file or standard input]<br>
+     * @param fileHeader -> object of BMP_FileHeader struct<br>
+     * @param fileInfoHeader -> object of BMP_FileInfoHeader struct<br>
+     * @details This function is used by streaming commands, stream is left positioned right after the headers
+     */
+
+    inline auto readBMPHeaders(std::istream& in, BMP_FileHeader& fileHeader,
+                        BMP_FileInfoHeader& fileInfoHeader) -> bool
+    {
+        stats::Timer timer(stats::Phase::Header);
+        stats::addRead(sizeof(BMP_FileHeader) + sizeof(BMP_FileInfoHeader));
+        if (!in.read(reinterpret_cast<char*>(&fileHeader), sizeof(BMP_FileHeader))) {
+            std::cerr << "Failed to read BMP header." << std::endl;
+            return false;
+        }
+        if (!in.read(reinterpret_cast<char*>(&fileInfoHeader), sizeof(BMP_FileInfoHeader))) {
+            std::cerr << "Failed to read BMP information header." << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    /**
+     * @brief Mapping the file (.bmp) without copying pixel data
+     * @function mapBMP
      * @param path -> path of the file<br>
+     * @param file -> mapped file(image), keeps pixel data alive<br>
      * @param fileHeader -> object of BMP_FileHeader struct<br>
      * @param fileInfoHeader -> object of BMP_FileInfoHeader struct<br>
-     * @param pixelData -> pixel data of the image(file)<br>
-     * @details This function is used to read data [file header, file information header and pixel data] of the file(image)
+     * @param pixelData -> pointer to the pixel data inside of the mapped file<br>
+     * @details This function is used by read-only commands [info, check, decrypt], pages of pixel data
+     *          are read by the kernel only when they are accessed
      * @attention
      *  We are dividing bitCount by 8 to get bytes per pixel
      */
 
-    auto readFromBMP(const std::string& path, BMP_FileHeader& fileHeader,
-                     BMP_FileInfoHeader& fileInfoHeader, std::vector<unsigned char>& pixelData)->bool
+    inline auto mapBMP(const std::string& path, MappedFile& file, BMP_FileHeader& fileHeader,
+                BMP_FileInfoHeader& fileInfoHeader, const unsigned char*& pixelData) -> bool
     {
         /// Checking whether path was provided and its correctness
         if(path.empty()){
@@ -26,48 +158,108 @@ namespace bmp {
             return false;
         }
 
-        /// Opening file
-        std::ifstream file(path,std::ios::binary);
-        if (!file.is_open()) {
+        /// Mapping file
+        if (!file.open(path)) {
+            std::cerr << "Unable to open file! Path provided: " << path << std::endl;
+            return false;
+        }
+
+        /// Reading headers
+        if (!readBMPHeaders(file, fileHeader, fileInfoHeader)) {
+            return false;
+        }
+        /// Checking whether pixels are 24-bit or 32-bit and not compressed [BMP format]
+        constexpr std::size_t masksOffset = sizeof(BMP_FileHeader) + sizeof(BMP_FileInfoHeader);
+        const unsigned char* masks = file.size() >= masksOffset + maskBytes ? file.data() + masksOffset : nullptr;
+        if (!isSupported(fileInfoHeader, masks)) {
+            std::cerr << "Unsupported BMP format." << std::endl;
+            return false;
+        }
+
+        /// Checking that the whole pixel data [padding of rows included] lies inside of the file
+        uint64_t imageSize = rowStride(fileInfoHeader) * fileInfoHeader.height;
+        if (fileHeader.dataOffset > file.size() || imageSize > file.size() - fileHeader.dataOffset) {
+            std::cerr << "Failed to read pixel data!" << std::endl;
+            return false;
+        }
+
+        pixelData = file.data() + fileHeader.dataOffset;
+        return true;
+    }
+
+    /**
+     * @brief Opening the file (.bmp) for reading byte ranges of pixel data
+     * @function openBMP
+     * @param path -> path of the file<br>
+     * @param file -> opened file(image)<br>
+     * @param fileHeader -> object of BMP_FileHeader struct<br>
+     * @param fileInfoHeader -> object of BMP_FileInfoHeader struct<br>
+     * @details This function is used by decrypt, only headers are read here, pixel data is read later
+     *          range by range with RangeFile::readAt
+     */
+
+    inline auto openBMP(const std::string& path, RangeFile& file, BMP_FileHeader& fileHeader,
+                 BMP_FileInfoHeader& fileInfoHeader) -> bool
+    {
+        /// Checking whether path was provided and its correctness
+        if(path.empty()){
+            std::cerr << "Path is incorrect or was not provided!" << std::endl;
+            return false;
+        }
+        if (!file.open(path)) {
             std::cerr << "Unable to open file! Path provided: " << path << std::endl;
             return false;
         }
 
-        /// Reading File
-        if (!file.read(reinterpret_cast<char*>(&fileHeader), sizeof(BMP_FileHeader))) {
+        /// Reading headers
+        if (!file.readAt(0, sizeof(BMP_FileHeader), &fileHeader)) {
             std::cerr << "Failed to read BMP header." << std::endl;
-            file.close();
             return false;
         }
-        if (!file.read(reinterpret_cast<char*>(&fileInfoHeader), sizeof(BMP_FileInfoHeader))) {
+        if (!file.readAt(sizeof(BMP_FileHeader), sizeof(BMP_FileInfoHeader), &fileInfoHeader)) {
             std::cerr << "Failed to read BMP information header." << std::endl;
-            file.close();
             return false;
         }
-        /// Checking whether bit count of the file is 24 and there is no compression [BMP format]
-        if (fileInfoHeader.bitCount != 24 || fileInfoHeader.compression != 0) {
+        /// Checking whether pixels are 24-bit or 32-bit and not compressed [BMP format]
+        std::array<unsigned char, maskBytes> masks{};
+        bool masksRead = fileInfoHeader.compression == bitFields
+            && file.readAt(sizeof(BMP_FileHeader) + sizeof(BMP_FileInfoHeader), masks.size(), masks.data());
+        if (!isSupported(fileInfoHeader, masksRead ? masks.data() : nullptr)) {
             std::cerr << "Unsupported BMP format." << std::endl;
-            file.close();
             return false;
         }
+        return true;
+    }
 
-        /// Calculating the total number of bytes needed to store the image data and resizing the pixelData to received value
-        uint32_t imageSize = fileInfoHeader.width * fileInfoHeader.height * (fileInfoHeader.bitCount / 8);
-
-        pixelData.resize(imageSize);
-
-        /// Moving file read pointer to the start of the pixel data
-        file.seekg(fileHeader.dataOffset, std::ios::beg);
+    /**
+     * @brief Reading data from the file (.bmp)
+     * @function readFromBMP
+     * @param path -> path of the file<br>
+     * @param fileHeader -> object of BMP_FileHeader struct<br>
+     * @param fileInfoHeader -> object of BMP_FileInfoHeader struct<br>
+     * @param pixelData -> pixel data of the image(file)<br>
+     * @details This function is used to read data [file header, file information header and pixel data] of the file(image)
+     *          into memory that can be modified, pixel data is copied straight out of the mapped file into a pooled
+     *          buffer [not zeroed before, reused by the next image of the same size]
+     * @attention
+     *  Stored rows are copied as they are [padded to 4 bytes]
+     */
 
-        /// Reading pixel data
-        if (!file.read(reinterpret_cast<char*>(pixelData.data()), pixelData.size())) {
-            std::cerr << "Failed to read pixel data!" << std::endl;
-            file.close();
+    inline auto readFromBMP(const std::string& path, BMP_FileHeader& fileHeader,
+                     BMP_FileInfoHeader& fileInfoHeader, buffers::Buffer& pixelData)->bool
+    {
+        MappedFile file;
+        const unsigned char* pixels = nullptr;
+        if (!mapBMP(path, file, fileHeader, fileInfoHeader, pixels)) {
             return false;
         }
 
-        /// Closing file
-        file.close();
+        /// Copying pixel data [stored rows * height]
+        auto imageSize = static_cast<std::size_t>(rowStride(fileInfoHeader) * fileInfoHeader.height);
+        stats::Timer timer(stats::Phase::Read);
+        stats::addRead(imageSize);
+        pixelData = buffers::acquire(imageSize);
+        std::memcpy(pixelData.data(), pixels, imageSize);
 
         return true;
     }
@@ -79,11 +271,15 @@ namespace bmp {
      * @param pixelData -> pixel data of the image(file)<br>
      * @param width -> file(image) width<br>
      * @param height -> file(image) height<br>
+     * @param output -> path of the written file(image)<br>
+     * @param bitCount -> bits per pixel of the pixel data [24 - B, G, R or 32 - B, G, R, A]<br>
      * @details This function is used to write data into the file(image)
     */
 
-    auto writeToBMP(const std::string& path, std::vector<unsigned char>& pixelData,
-                    int width, int height)->bool
+    inline auto writeToBMP(const std::string& path, const buffers::Buffer& pixelData,
+                    int width, int height,
+                    const std::string& output = "..\\ImageStegonography\\bmp_encrypted_file.bmp",
+                    uint16_t bitCount = 24)->bool
     {
         BMP_FileHeader fileHeader;
         BMP_FileInfoHeader fileInfoHeader;
@@ -102,7 +298,7 @@ namespace bmp {
         fileInfoHeader.width = width;
         fileInfoHeader.height = height;
         fileInfoHeader.planes = 1;
-        fileInfoHeader.bitCount = 24;
+        fileInfoHeader.bitCount = bitCount;
         fileInfoHeader.compression = 0;
         fileInfoHeader.imageSize = pixelData.size();
         fileInfoHeader.xPixelsPerMeter = 0;
@@ -111,7 +307,8 @@ namespace bmp {
         fileInfoHeader.colorsImportant = 0;
 
         /// Writing to the file [binary mode]
-        std::ofstream new_file("..\\ImageStegonography\\bmp_encrypted_file.bmp", std::ios::binary);
+        stats::Timer timer(stats::Phase::Write);
+        std::ofstream new_file(output, std::ios::binary);
         if(!new_file){
             std::cerr << "Error loading file! Path provided: " << path << std::endl;
             return false;
@@ -123,65 +320,209 @@ namespace bmp {
 
         /// Closing file
         new_file.close();
+        timer.stop();
+        stats::addWritten(fileHeader.fileSize);
+        stats::syncFile(output);
 
         return true;
     }
 }
 
 namespace ppm {
+
+    /// Payload bits per carrier byte [LSB of each byte]
+    inline constexpr int density = 1;
+
+    /// Size of the image(pixel) data as it is stored in binary formats [width * height * depth * sample size]
+    inline auto rasterBytes(const PPM_FileHeader& ppm) -> uint64_t {
+        return uint64_t(ppm.width) * ppm.height * ppm.depth * netpbm::sampleBytes(ppm);
+    }
+
     /**
-     * @brief Reading data from the file (.ppm)
-     * @function readPPMImage
+     * @brief Parsing header of the file (.ppm) held in memory
+     * @function parsePPMHeader
+     * @param data -> first bytes of the file<br>
+     * @param size -> number of bytes available<br>
+     * @param ppm -> object of PPM_FileHeader struct, image_data is left untouched<br>
+     * @param dataOffset -> offset of the image(pixel) data (in 'bytes')<br>
+     * @details This function is used to read [magic number, width, height, max color value, depth] out of a mapped
+     *          file or out of the first bytes read from it [netpbm::parseHeader, comments are skipped, P2-P7].
+     *          Prints nothing, so it is used by the library [Steg.h] as well.
+     */
+
+    inline auto parsePPMHeader(const unsigned char* data, std::size_t size, PPM_FileHeader& ppm, std::size_t& dataOffset) -> bool {
+        stats::Timer timer(stats::Phase::Header);
+        return netpbm::parseHeader(data, size, ppm, dataOffset);
+    }
+
+    /**
+     * @brief Reading header of the file (.ppm) held in memory
+     * @function readPPMHeader
+     * @param data -> first bytes of the file<br>
+     * @param size -> number of bytes available<br>
+     * @param ppm -> object of PPM_FileHeader struct, image_data is left untouched<br>
+     * @param dataOffset -> offset of the image(pixel) data (in 'bytes')<br>
+     */
+
+    inline auto readPPMHeader(const unsigned char* data, std::size_t size, PPM_FileHeader& ppm, std::size_t& dataOffset) -> bool {
+        if (!parsePPMHeader(data, size, ppm, dataOffset)) {
+            std::cerr << "Failed to read PPM header." << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    /**
+     * @brief Parsing header of the mapped file (.ppm)
+     * @function readPPMHeader
+     * @param file -> mapped file(image)<br>
+     * @param ppm -> object of PPM_FileHeader struct, image_data is left untouched<br>
+     * @param dataOffset -> offset of the image(pixel) data (in 'bytes')<br>
+     */
+
+    inline auto readPPMHeader(const MappedFile& file, PPM_FileHeader& ppm, std::size_t& dataOffset) -> bool {
+        return readPPMHeader(file.data(), file.size(), ppm, dataOffset);
+    }
+
+    /**
+     * @brief Reading header from the stream (.ppm)
+     * @function readPPMHeader
+     * @param in -> input stream [file or standard input]<br>
+     * @param ppm -> object of PPM_FileHeader struct, image_data is left untouched<br>
+     * @details This function is used by streaming commands, stream is left positioned at the first byte of image(pixel) data
+     */
+
+    inline auto readPPMHeader(std::istream& in, PPM_FileHeader& ppm) -> bool {
+        stats::Timer timer(stats::Phase::Header);
+        /// Reading header bytes up to the first byte of image(pixel) data [netpbm::readHeader]
+        std::string head;
+        if (!netpbm::readHeader(in, head, ppm)) {
+            std::cerr << "Failed to read PPM header." << std::endl;
+            return false;
+        }
+        stats::addRead(head.size());
+        return true;
+    }
+
+    /**
+     * @brief Mapping the file (.ppm) without copying image(pixel) data
+     * @function mapPPMImage
      * @param path -> path of the file<br>
-     * @param ppm -> object of PPM_FileHeader struct<br>
-     * @details This function is used to read data [file magic number, file width and height, file max color value and image(pixel) data] of the file(image)
-     * @attention
-     *  ! Image data size differs here from .bmp !<br>
-     *  We need to count number of pixels, so we will multiply image width with height and then multiply result with 3 (3 -> 3 values R, G, B)
+     * @param file -> mapped file(image), keeps pixel data alive<br>
+     * @param ppm -> object of PPM_FileHeader struct, image_data is left untouched<br>
+     * @param pixelData -> pointer to the image(pixel) data inside of the mapped file<br>
+     * @details This function is used by read-only commands [info, check, decrypt]
      */
 
-    auto readPPMImage(const std::string &path, PPM_FileHeader &ppm) -> bool {
+    inline auto mapPPMImage(const std::string& path, MappedFile& file, PPM_FileHeader& ppm,
+                     const unsigned char*& pixelData) -> bool {
         /// Checking whether path was provided and its correctness
         if(path.empty()){
             std::cerr << "Path is incorrect or was not provided!" << std::endl;
             return false;
         }
-        /// Opening file
-        std::ifstream ppm_file(path,std::ios::binary);
-        if (!ppm_file.is_open()) {
+        /// Mapping file
+        if (!file.open(path)) {
             std::cerr << "Unable to open file! Path provided: " << path << std::endl;
             return false;
         }
 
-        /// Reading magic number(type)
-        ppm_file >> ppm.magic_number;
+        std::size_t dataOffset = 0;
+        if (!readPPMHeader(file, ppm, dataOffset)) {
+            return false;
+        }
 
-        /// Checking magic number(type) [P3 - plain text, P6 - binary]
-        if (ppm.magic_number != "P6") {
-            std::cerr << "Unsupported BMP format." << std::endl;
-            ppm_file.close();
+        /// Checking magic number(type) [P2, P3 - plain text, P5, P6, P7 - binary] and size of samples [8 or 16 bits]
+        if (!netpbm::isSupported(ppm)) {
+            std::cerr << "Unsupported PPM format." << std::endl;
             return false;
         }
 
-        /// Reading other data
-        ppm_file >> ppm.width >> ppm.height >> ppm.max_color_val;
+        /// Checking that the whole image(pixel) data lies inside of the file [depth samples per pixel, text is checked when it is read]
+        uint64_t imageSize = netpbm::isPlain(ppm) ? 0 : rasterBytes(ppm);
+        if (dataOffset > file.size() || imageSize > file.size() - dataOffset) {
+            std::cout << "Error while reading image(pixel) data!" << std::endl;
+            return false;
+        }
 
-        /// Skipping whitespace
-        ppm_file.ignore();
+        pixelData = file.data() + dataOffset;
+        return true;
+    }
 
-        /// Calculating number of pixels and resizing image(pixel) data to this size
-        int numberOfPixels = ppm.width * ppm.height;
-        ppm.image_data.resize(numberOfPixels * 3);
+    /**
+     * @brief Opening the file (.ppm) for reading byte ranges of image(pixel) data
+     * @function openPPMImage
+     * @param path -> path of the file<br>
+     * @param file -> opened file(image)<br>
+     * @param ppm -> object of PPM_FileHeader struct, image_data is left untouched<br>
+     * @param dataOffset -> offset of the image(pixel) data (in 'bytes')<br>
+     * @details This function is used by decrypt, only the first bytes holding the header are read
+     * @attention Header is expected within the first 4 KB of the file
+     */
 
-        /// Reading pixel data from the file(image)
-        ppm_file.read(reinterpret_cast<char *>(&ppm.image_data[0]), ppm.image_data.size());
-        if (!ppm_file) {
-            std::cout << "Error while reading image(pixel) data!" << std::endl;
+    inline auto openPPMImage(const std::string& path, RangeFile& file, PPM_FileHeader& ppm, std::size_t& dataOffset) -> bool {
+        /// Checking whether path was provided and its correctness
+        if(path.empty()){
+            std::cerr << "Path is incorrect or was not provided!" << std::endl;
+            return false;
+        }
+        if (!file.open(path)) {
+            std::cerr << "Unable to open file! Path provided: " << path << std::endl;
             return false;
         }
 
-        /// Closing file
-        ppm_file.close();
+        /// Reading first bytes of the file and parsing header out of them
+        std::vector<unsigned char> head(static_cast<std::size_t>(std::min<uint64_t>(file.size(), 4096)));
+        if (!file.readAt(0, head.size(), head.data())) {
+            std::cerr << "Failed to read PPM header." << std::endl;
+            return false;
+        }
+        if (!readPPMHeader(head.data(), head.size(), ppm, dataOffset)) {
+            return false;
+        }
+
+        /// Checking magic number(type) [P2, P3 - plain text, P5, P6, P7 - binary] and size of samples [8 or 16 bits]
+        if (!netpbm::isSupported(ppm)) {
+            std::cerr << "Unsupported PPM format." << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    /**
+     * @brief Reading data from the file (.ppm)
+     * @function readPPMImage
+     * @param path -> path of the file<br>
+     * @param ppm -> object of PPM_FileHeader struct<br>
+     * @details This function is used to read data [file magic number, file width and height, file max color value and image(pixel) data] of the file(image)
+     * @attention
+     *  ! Image data size differs here from .bmp !<br>
+     *  We need to count number of pixels, so we will multiply image width with height and then multiply result with depth (3 -> 3 values R, G, B)
+     *  and with the size of one sample (2 bytes when max color value is above 255). Plain text data [P2, P3] is converted into the same binary samples
+     */
+
+    inline auto readPPMImage(const std::string &path, PPM_FileHeader &ppm) -> bool {
+        MappedFile file;
+        const unsigned char* pixels = nullptr;
+        if (!mapPPMImage(path, file, ppm, pixels)) {
+            return false;
+        }
+
+        /// Copying image(pixel) data straight out of the mapped file into a pooled buffer
+        auto imageSize = static_cast<std::size_t>(rasterBytes(ppm));
+        stats::Timer timer(stats::Phase::Read);
+        ppm.image_data = buffers::acquire(imageSize);
+        if (netpbm::isPlain(ppm)) {
+            std::size_t textSize = static_cast<std::size_t>(file.data() + file.size() - pixels);
+            stats::addRead(textSize);
+            if (!netpbm::readPlain(pixels, textSize, ppm, ppm.image_data.data())) {
+                std::cerr << "Error while reading image(pixel) data!" << std::endl;
+                return false;
+            }
+            return true;
+        }
+        stats::addRead(imageSize);
+        std::memcpy(ppm.image_data.data(), pixels, imageSize);
 
         return true;
     }
@@ -190,11 +531,13 @@ namespace ppm {
      * @brief Writing data to the file (.ppm)
      * @function writeToBMP
      * @param path -> path of the file<br>
-     * @param ppmImage -> object of PPM_FileHeader
+     * @param ppmImage -> object of PPM_FileHeader<br>
+     * @param output -> path of the written file(image)
      * @details This function is used to write data into the file(image)
     */
 
-    auto writeToPPM(const std::string &path, PPM_FileHeader &ppmImage) -> bool {
+    inline auto writeToPPM(const std::string &path, PPM_FileHeader &ppmImage,
+                    const std::string& output = "..\\ImageStegonography\\ppm_encrypted_file.ppm") -> bool {
         /// Checking whether path was provided and its correctness
         if(path.empty()){
             std::cerr << "Path is incorrect or was not provided!" << std::endl;
@@ -202,25 +545,35 @@ namespace ppm {
         }
 
         /// Writing into the file
-        std::ofstream new_file("..\\ImageStegonography\\ppm_encrypted_file.ppm", std::ios::binary);
+        stats::Timer timer(stats::Phase::Write);
+        std::ofstream new_file(output, std::ios::binary);
         if (!new_file) {
             std::cerr << "Error loading file!" << std::endl;
             return false;
         }
 
-        /// These information shoul be assigned by us pass all necessary data to create .ppm file
-        new_file << "P6\n" << ppmImage.width << " " << ppmImage.height << "\n";
-        new_file << ppmImage.max_color_val << "\n"; // ! add '\n' elements after each input
+        /// These information shoul be assigned by us pass all necessary data to create the file [P2, P3, P5, P6 or P7 header]
+        netpbm::writeHeader(new_file, ppmImage);
 
-        /// Writing image(pixel) data into the file
-        new_file.write(reinterpret_cast<const char *>(ppmImage.image_data.data()), ppmImage.image_data.size());
+        /// Writing image(pixel) data into the file [as text for P2, P3]
+        if (netpbm::isPlain(ppmImage)) {
+            netpbm::PlainWriter writer(new_file, netpbm::sampleBytes(ppmImage));
+            writer.sputn(reinterpret_cast<const char *>(ppmImage.image_data.data()), ppmImage.image_data.size());
+            writer.finish();
+        } else {
+            new_file.write(reinterpret_cast<const char *>(ppmImage.image_data.data()), ppmImage.image_data.size());
+        }
         if (!new_file) {
             std::cerr << "Error writing image(pixel) data to the file!" << std::endl;
             return false;
         }
 
         /// Closing file
+        auto written = static_cast<uint64_t>(new_file.tellp());
         new_file.close();
+        timer.stop();
+        stats::addWritten(written);
+        stats::syncFile(output);
 
         return true;
     }
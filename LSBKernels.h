@@ -0,0 +1,477 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+#include "BitStream.h"
+#include "Stats.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define STEG_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define STEG_TARGET(isa) __attribute__((target(isa)))
+#else
+#define STEG_TARGET(isa)
+#endif
+
+namespace kernels {
+
+    /**
+     * @brief Function types of embed/extract kernels
+     * @var
+     * <b>EmbedFn</b> -> carrier byte i receives payload bits [bitOffset + i * density, bitOffset + (i + 1) * density) in its LSBs<br>
+     * <b>ExtractFn</b> -> LSBs of carrier byte i are stored into the same payload bits<br>
+     * @details Carrier is walked in memory order, payload bits are MSB-first (see BitStream.h).
+     *          Bit position of every carrier byte is a pure function of its index, so any
+     *          span of carrier can be processed on its own.
+     */
+
+    using EmbedFn = void (*)(unsigned char* carrier, std::size_t count,
+                             const unsigned char* payload, uint64_t bitOffset, int density);
+    using ExtractFn = void (*)(const unsigned char* carrier, std::size_t count,
+                               unsigned char* payload, uint64_t bitOffset, int density);
+
+    /**
+     * @brief Scalar kernels, used as fallback and for unaligned head/tail of vectorized kernels
+     * @function embedScalar, extractScalar
+     */
+
+    inline auto embedScalar(unsigned char* carrier, std::size_t count,
+                            const unsigned char* payload, uint64_t bitOffset, int density) -> void {
+        auto lowBits = static_cast<unsigned char>((1u << density) - 1);
+        auto payloadBytes = static_cast<std::size_t>((bitOffset + count * density + 7) / 8);
+        bits::BitReader reader(payload, payloadBytes);
+        reader.seek(bitOffset);
+        for (std::size_t i = 0; i < count; ++i)
+            carrier[i] = static_cast<unsigned char>((carrier[i] & ~lowBits) | reader.read(density));
+    }
+
+    inline auto extractScalar(const unsigned char* carrier, std::size_t count,
+                              unsigned char* payload, uint64_t bitOffset, int density) -> void {
+        bits::BitWriter writer(payload, bitOffset);
+        for (std::size_t i = 0; i < count; ++i) writer.write(carrier[i], density);
+        writer.flush();
+    }
+
+    /**
+     * @brief Splitting carrier span into scalar head, vectorized body and scalar tail
+     * @function splitAligned
+     * @param count -> number of carrier bytes<br>
+     * @param bitOffset -> payload bit of the first carrier byte<br>
+     * @param density -> payload bits per carrier byte<br>
+     * @param step -> carrier bytes processed by one vector iteration<br>
+     * @details Vectorized body needs payload bit position aligned to a whole byte,
+     *          returns number of head bytes and number of body bytes (multiple of step)
+     */
+
+    inline auto splitAligned(std::size_t count, uint64_t bitOffset, int density, std::size_t step)
+            -> std::array<std::size_t, 2> {
+        std::size_t head = 0;
+        while (head < count && head < 8 && (bitOffset + head * density) % 8 != 0) ++head;
+        if ((bitOffset + head * density) % 8 != 0 || (density != 1 && density != 2)) return {count, 0};
+        return {head, (count - head) / step * step};
+    }
+
+#if defined(STEG_X86)
+
+    /// Bit reversal of every byte value [used by SSE2 extract which has no byte shuffle]
+    inline constexpr auto reversedBytes = [] {
+        std::array<unsigned char, 256> table{};
+        for (int value = 0; value < 256; ++value) {
+            int reversed = 0;
+            for (int bit = 0; bit < 8; ++bit) if (value & (1 << bit)) reversed |= 1 << (7 - bit);
+            table[value] = static_cast<unsigned char>(reversed);
+        }
+        return table;
+    }();
+
+    /// Reversal of the order of 2-bit pairs in every byte value
+    inline constexpr auto reversedPairs = [] {
+        std::array<unsigned char, 256> table{};
+        for (int value = 0; value < 256; ++value) {
+            int reversed = 0;
+            for (int pair = 0; pair < 4; ++pair) reversed |= ((value >> (2 * pair)) & 3) << (6 - 2 * pair);
+            table[value] = static_cast<unsigned char>(reversed);
+        }
+        return table;
+    }();
+
+    /// Spreading 32 bits to the even positions of 64-bit word
+    inline auto spreadBits(uint64_t value) -> uint64_t {
+        value = (value | (value << 16)) & 0x0000FFFF0000FFFFull;
+        value = (value | (value << 8)) & 0x00FF00FF00FF00FFull;
+        value = (value | (value << 4)) & 0x0F0F0F0F0F0F0F0Full;
+        value = (value | (value << 2)) & 0x3333333333333333ull;
+        value = (value | (value << 1)) & 0x5555555555555555ull;
+        return value;
+    }
+
+    /// Interleaving bit-0 mask and bit-1 mask of 2-bit symbols [bit 2i = low(i), bit 2i + 1 = high(i)]
+    inline auto interleaveBits(uint32_t low, uint32_t high) -> uint64_t {
+        return spreadBits(low) | (spreadBits(high) << 1);
+    }
+
+    inline auto storeLittleEndian(unsigned char* destination, uint64_t value, std::size_t bytes) -> void {
+        for (std::size_t i = 0; i < bytes; ++i) destination[i] = static_cast<unsigned char>(value >> (8 * i));
+    }
+
+    /**
+     * @brief SSE2 kernels [16 carrier bytes per iteration]
+     * @details Payload bytes are replicated with unpack so every carrier byte sees its source byte,
+     *          bits are selected with and + compare against per-position masks and merged with mask-and-or.
+     *          Extract gathers LSBs with movemask and restores MSB-first order with lookup tables.
+     */
+
+    STEG_TARGET("sse2")
+    inline auto embedSSE2(unsigned char* carrier, std::size_t count,
+                          const unsigned char* payload, uint64_t bitOffset, int density) -> void {
+        auto [head, body] = splitAligned(count, bitOffset, density, 16);
+        embedScalar(carrier, head, payload, bitOffset, density);
+        const unsigned char* source = payload + (bitOffset + head * density) / 8;
+
+        const __m128i clear = _mm_set1_epi8(static_cast<char>(~((1 << density) - 1)));
+        const __m128i one = _mm_set1_epi8(1), two = _mm_set1_epi8(2);
+        const __m128i selectBit = _mm_set_epi8(1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128);
+        const __m128i selectHigh = _mm_set1_epi32(0x02082080);
+        const __m128i selectLow = _mm_set1_epi32(0x01041040);
+
+        for (std::size_t i = head; i < head + body; i += 16, source += 2 * density) {
+            __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(carrier + i));
+            __m128i symbols;
+            if (density == 1) {
+                uint16_t raw;
+                std::memcpy(&raw, source, sizeof(raw));
+                __m128i spread = _mm_cvtsi32_si128(raw);
+                spread = _mm_unpacklo_epi8(spread, spread);
+                spread = _mm_unpacklo_epi16(spread, spread);
+                spread = _mm_unpacklo_epi32(spread, spread);
+                symbols = _mm_and_si128(_mm_cmpeq_epi8(_mm_and_si128(spread, selectBit), selectBit), one);
+            } else {
+                uint32_t raw;
+                std::memcpy(&raw, source, sizeof(raw));
+                __m128i spread = _mm_cvtsi32_si128(static_cast<int>(raw));
+                spread = _mm_unpacklo_epi8(spread, spread);
+                spread = _mm_unpacklo_epi16(spread, spread);
+                symbols = _mm_or_si128(
+                        _mm_and_si128(_mm_cmpeq_epi8(_mm_and_si128(spread, selectHigh), selectHigh), two),
+                        _mm_and_si128(_mm_cmpeq_epi8(_mm_and_si128(spread, selectLow), selectLow), one));
+            }
+            pixels = _mm_or_si128(_mm_and_si128(pixels, clear), symbols);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(carrier + i), pixels);
+        }
+
+        embedScalar(carrier + head + body, count - head - body, payload,
+                    bitOffset + (head + body) * density, density);
+    }
+
+    STEG_TARGET("sse2")
+    inline auto extractSSE2(const unsigned char* carrier, std::size_t count,
+                            unsigned char* payload, uint64_t bitOffset, int density) -> void {
+        auto [head, body] = splitAligned(count, bitOffset, density, 16);
+        extractScalar(carrier, head, payload, bitOffset, density);
+        unsigned char* destination = payload + (bitOffset + head * density) / 8;
+
+        for (std::size_t i = head; i < head + body; i += 16, destination += 2 * density) {
+            __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(carrier + i));
+            auto low = static_cast<uint32_t>(_mm_movemask_epi8(_mm_slli_epi16(pixels, 7)));
+            if (density == 1) {
+                destination[0] = reversedBytes[low & 0xFF];
+                destination[1] = reversedBytes[low >> 8];
+            } else {
+                auto high = static_cast<uint32_t>(_mm_movemask_epi8(_mm_slli_epi16(pixels, 6)));
+                uint64_t symbols = interleaveBits(low, high);
+                for (int byte = 0; byte < 4; ++byte)
+                    destination[byte] = reversedPairs[(symbols >> (8 * byte)) & 0xFF];
+            }
+        }
+
+        extractScalar(carrier + head + body, count - head - body, payload,
+                      bitOffset + (head + body) * density, density);
+    }
+
+    /**
+     * @brief AVX2 kernels [32 carrier bytes per iteration]
+     * @details Payload bytes are broadcast to both lanes and distributed with a byte shuffle,
+     *          extract reverses carrier bytes inside every payload byte group with a shuffle
+     *          so movemask directly yields MSB-first payload bits.
+     */
+
+    STEG_TARGET("avx2")
+    inline auto embedAVX2(unsigned char* carrier, std::size_t count,
+                          const unsigned char* payload, uint64_t bitOffset, int density) -> void {
+        auto [head, body] = splitAligned(count, bitOffset, density, 32);
+        embedScalar(carrier, head, payload, bitOffset, density);
+        const unsigned char* source = payload + (bitOffset + head * density) / 8;
+
+        const __m256i clear = _mm256_set1_epi8(static_cast<char>(~((1 << density) - 1)));
+        const __m256i one = _mm256_set1_epi8(1), two = _mm256_set1_epi8(2);
+        const __m256i selectBit = _mm256_set1_epi64x(static_cast<long long>(0x0102040810204080ull));
+        const __m256i selectHigh = _mm256_set1_epi32(0x02082080);
+        const __m256i selectLow = _mm256_set1_epi32(0x01041040);
+        /// Output byte j takes payload byte j / 8 [density 1] or j / 4 [density 2]
+        const __m256i spreadOne = _mm256_setr_epi8(0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1,
+                                                   2, 2, 2, 2, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 3, 3);
+        const __m256i spreadTwo = _mm256_setr_epi8(0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3,
+                                                   4, 4, 4, 4, 5, 5, 5, 5, 6, 6, 6, 6, 7, 7, 7, 7);
+
+        for (std::size_t i = head; i < head + body; i += 32, source += 4 * density) {
+            __m256i pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(carrier + i));
+            uint64_t raw = 0;
+            std::memcpy(&raw, source, 4 * density);
+            __m256i spread = _mm256_broadcastsi128_si256(_mm_cvtsi64_si128(static_cast<long long>(raw)));
+            __m256i symbols;
+            if (density == 1) {
+                spread = _mm256_shuffle_epi8(spread, spreadOne);
+                symbols = _mm256_and_si256(_mm256_cmpeq_epi8(_mm256_and_si256(spread, selectBit), selectBit), one);
+            } else {
+                spread = _mm256_shuffle_epi8(spread, spreadTwo);
+                symbols = _mm256_or_si256(
+                        _mm256_and_si256(_mm256_cmpeq_epi8(_mm256_and_si256(spread, selectHigh), selectHigh), two),
+                        _mm256_and_si256(_mm256_cmpeq_epi8(_mm256_and_si256(spread, selectLow), selectLow), one));
+            }
+            pixels = _mm256_or_si256(_mm256_and_si256(pixels, clear), symbols);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(carrier + i), pixels);
+        }
+
+        embedScalar(carrier + head + body, count - head - body, payload,
+                    bitOffset + (head + body) * density, density);
+    }
+
+    STEG_TARGET("avx2")
+    inline auto extractAVX2(const unsigned char* carrier, std::size_t count,
+                            unsigned char* payload, uint64_t bitOffset, int density) -> void {
+        auto [head, body] = splitAligned(count, bitOffset, density, 32);
+        extractScalar(carrier, head, payload, bitOffset, density);
+        unsigned char* destination = payload + (bitOffset + head * density) / 8;
+
+        const __m256i reverseEight = _mm256_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8,
+                                                      7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8);
+        const __m256i reverseFour = _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+                                                     3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+
+        for (std::size_t i = head; i < head + body; i += 32, destination += 4 * density) {
+            __m256i pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(carrier + i));
+            if (density == 1) {
+                pixels = _mm256_shuffle_epi8(pixels, reverseEight);
+                auto low = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_slli_epi16(pixels, 7)));
+                storeLittleEndian(destination, low, 4);
+            } else {
+                pixels = _mm256_shuffle_epi8(pixels, reverseFour);
+                auto low = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_slli_epi16(pixels, 7)));
+                auto high = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_slli_epi16(pixels, 6)));
+                storeLittleEndian(destination, interleaveBits(low, high), 8);
+            }
+        }
+
+        extractScalar(carrier + head + body, count - head - body, payload,
+                      bitOffset + (head + body) * density, density);
+    }
+
+    /**
+     * @brief AVX-512BW kernels [64 carrier bytes per iteration]
+     * @details Same layout as AVX2, payload bits are tested straight into mask registers
+     *          and symbols are merged with masked moves.
+     */
+
+    STEG_TARGET("avx512f,avx512bw")
+    inline auto embedAVX512(unsigned char* carrier, std::size_t count,
+                            const unsigned char* payload, uint64_t bitOffset, int density) -> void {
+        auto [head, body] = splitAligned(count, bitOffset, density, 64);
+        embedScalar(carrier, head, payload, bitOffset, density);
+        const unsigned char* source = payload + (bitOffset + head * density) / 8;
+
+        const __m512i clear = _mm512_set1_epi8(static_cast<char>(~((1 << density) - 1)));
+        const __m512i one = _mm512_set1_epi8(1), two = _mm512_set1_epi8(2);
+        const __m512i selectBit = _mm512_set1_epi64(static_cast<long long>(0x0102040810204080ull));
+        const __m512i selectHigh = _mm512_set1_epi32(0x02082080);
+        const __m512i selectLow = _mm512_set1_epi32(0x01041040);
+        alignas(64) static constexpr auto spreadIndices = [] {
+            std::array<std::array<char, 64>, 2> table{};
+            for (int j = 0; j < 64; ++j) {
+                table[0][j] = static_cast<char>(j / 8);
+                table[1][j] = static_cast<char>(j / 4);
+            }
+            return table;
+        }();
+        const __m512i spread = _mm512_load_si512(spreadIndices[density - 1].data());
+
+        for (std::size_t i = head; i < head + body; i += 64, source += 8 * density) {
+            __m512i pixels = _mm512_loadu_si512(carrier + i);
+            __m128i raw = density == 1 ? _mm_loadl_epi64(reinterpret_cast<const __m128i*>(source))
+                                       : _mm_loadu_si128(reinterpret_cast<const __m128i*>(source));
+            __m512i bytes = _mm512_shuffle_epi8(_mm512_broadcast_i32x4(raw), spread);
+            __m512i symbols;
+            if (density == 1) {
+                symbols = _mm512_maskz_mov_epi8(_mm512_test_epi8_mask(bytes, selectBit), one);
+            } else {
+                symbols = _mm512_or_si512(_mm512_maskz_mov_epi8(_mm512_test_epi8_mask(bytes, selectHigh), two),
+                                          _mm512_maskz_mov_epi8(_mm512_test_epi8_mask(bytes, selectLow), one));
+            }
+            pixels = _mm512_or_si512(_mm512_and_si512(pixels, clear), symbols);
+            _mm512_storeu_si512(carrier + i, pixels);
+        }
+
+        embedScalar(carrier + head + body, count - head - body, payload,
+                    bitOffset + (head + body) * density, density);
+    }
+
+    STEG_TARGET("avx512f,avx512bw")
+    inline auto extractAVX512(const unsigned char* carrier, std::size_t count,
+                              unsigned char* payload, uint64_t bitOffset, int density) -> void {
+        auto [head, body] = splitAligned(count, bitOffset, density, 64);
+        extractScalar(carrier, head, payload, bitOffset, density);
+        unsigned char* destination = payload + (bitOffset + head * density) / 8;
+
+        const __m512i one = _mm512_set1_epi8(1), two = _mm512_set1_epi8(2);
+        const __m512i reverse = density == 1
+                ? _mm512_broadcast_i32x4(_mm_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8))
+                : _mm512_broadcast_i32x4(_mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12));
+
+        for (std::size_t i = head; i < head + body; i += 64, destination += 8 * density) {
+            __m512i pixels = _mm512_shuffle_epi8(_mm512_loadu_si512(carrier + i), reverse);
+            uint64_t low = _mm512_test_epi8_mask(pixels, one);
+            if (density == 1) {
+                storeLittleEndian(destination, low, 8);
+            } else {
+                uint64_t high = _mm512_test_epi8_mask(pixels, two);
+                storeLittleEndian(destination, interleaveBits(static_cast<uint32_t>(low), static_cast<uint32_t>(high)), 8);
+                storeLittleEndian(destination + 8, interleaveBits(static_cast<uint32_t>(low >> 32),
+                                                                  static_cast<uint32_t>(high >> 32)), 8);
+            }
+        }
+
+        extractScalar(carrier + head + body, count - head - body, payload,
+                      bitOffset + (head + body) * density, density);
+    }
+
+    /**
+     * @brief Querying processor for supported instruction sets
+     * @function cpuSupports
+     * @details cpuid reports what the processor implements, xgetbv reports which register
+     *          states the operating system saves [required before using YMM/ZMM registers]
+     */
+
+    struct CpuFeatures {
+        bool sse2 = false;
+        bool sse42 = false;
+        bool avx2 = false;
+        bool avx512bw = false;
+    };
+
+    inline auto detectCpu() -> CpuFeatures {
+        auto cpuid = [](unsigned leaf, unsigned subleaf, unsigned (&regs)[4]) {
+#if defined(_MSC_VER)
+            __cpuidex(reinterpret_cast<int*>(regs), static_cast<int>(leaf), static_cast<int>(subleaf));
+#else
+            __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+        };
+        auto xgetbv = []() -> uint64_t {
+#if defined(_MSC_VER)
+            return _xgetbv(0);
+#else
+            uint32_t low, high;
+            __asm__ volatile("xgetbv" : "=a"(low), "=d"(high) : "c"(0));
+            return (static_cast<uint64_t>(high) << 32) | low;
+#endif
+        };
+
+        CpuFeatures features;
+        unsigned regs[4];
+        cpuid(0, 0, regs);
+        unsigned maxLeaf = regs[0];
+        if (maxLeaf < 1) return features;
+
+        cpuid(1, 0, regs);
+        features.sse2 = regs[3] & (1u << 26);
+        features.sse42 = regs[2] & (1u << 20);
+        bool osSavesAvx = (regs[2] & (1u << 27)) && (regs[2] & (1u << 28)) && (xgetbv() & 0x6) == 0x6;
+        if (maxLeaf < 7 || !osSavesAvx) return features;
+
+        cpuid(7, 0, regs);
+        features.avx2 = regs[1] & (1u << 5);
+        features.avx512bw = (regs[1] & (1u << 16)) && (regs[1] & (1u << 30)) && (xgetbv() & 0xE6) == 0xE6;
+        return features;
+    }
+
+#endif
+
+    /**
+     * @struct Kernel
+     * @brief Pair of embed/extract functions for one instruction set
+     */
+
+    struct Kernel {
+        const char* name;
+        EmbedFn embed;
+        ExtractFn extract;
+    };
+
+    inline constexpr Kernel scalarKernel{"scalar", embedScalar, extractScalar};
+
+    /**
+     * @brief Picking kernel for the given name or the best one supported by the processor
+     * @function selectKernel
+     * @param name -> "scalar", "sse2", "avx2", "avx512" or empty for the best available<br>
+     * @details Requested kernel that processor does not support falls back to the best supported one, so does an
+     *          unknown name [a warning is printed on std::cerr]
+     */
+
+    inline auto selectKernel(const std::string& name) -> Kernel {
+        if (!name.empty() && name != "scalar" && name != "sse2" && name != "avx2" && name != "avx512") {
+            std::cerr << "Unknown kernel \"" << name << "\" [scalar, sse2, avx2 or avx512 expected], using the best available one" << std::endl;
+        }
+        if (name == "scalar") return scalarKernel;
+#if defined(STEG_X86)
+        static const CpuFeatures cpu = detectCpu();
+        const Kernel avx512{"avx512", embedAVX512, extractAVX512};
+        const Kernel avx2{"avx2", embedAVX2, extractAVX2};
+        const Kernel sse2{"sse2", embedSSE2, extractSSE2};
+
+        if (name == "sse2" && cpu.sse2) return sse2;
+        if (name == "avx2" && cpu.avx2) return avx2;
+        if (cpu.avx512bw) return avx512;
+        if (cpu.avx2) return avx2;
+        if (cpu.sse2) return sse2;
+#endif
+        return scalarKernel;
+    }
+
+    /**
+     * @brief Kernel used by encrypt/decrypt
+     * @function active
+     * @details Selected once, environment variable STEG_KERNEL can pin a specific kernel
+     */
+
+    inline auto active() -> const Kernel& {
+        static const Kernel kernel = [] {
+            const char* forced = std::getenv("STEG_KERNEL");
+            return selectKernel(forced ? forced : "");
+        }();
+        return kernel;
+    }
+
+    inline auto embed(unsigned char* carrier, std::size_t count,
+                      const unsigned char* payload, uint64_t bitOffset, int density) -> void {
+        stats::addCarrier(count);
+        active().embed(carrier, count, payload, bitOffset, density);
+    }
+
+    inline auto extract(const unsigned char* carrier, std::size_t count,
+                        unsigned char* payload, uint64_t bitOffset, int density) -> void {
+        stats::addCarrier(count);
+        active().extract(carrier, count, payload, bitOffset, density);
+    }
+}
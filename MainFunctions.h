@@ -3,12 +3,17 @@
 #include <iostream>
 #include <fstream>
 #include <vector>
-#include <bitset>
 #include <cstdint>
+#include <string>
+#include <algorithm>
 
 #include "BMPHeaderStruct.h"
 #include "PPMHeaderStruct.h"
 #include "FileReadOrWrite.h"
+#include "LSBKernels.h"
+#include "PayloadHeader.h"
+#include "Steg.h"
+#include "StreamCodec.h"
 
 
 
@@ -39,7 +44,7 @@ namespace bmp {
     * More information about this in [BMPHeaderStruct.h] header file
     * */
 
-    auto info(const std::string& path)->void{
+    inline auto info(const std::string& path)->void{
         BMP_FileHeader fileHeader;              // <<File Header[fileType, fileSize, dataOffset]>>
         BMP_FileInfoHeader fileInfoHeader;      // <<File Header Information[size, width, height, bitCount, compression, ...]>>
 
@@ -49,15 +54,17 @@ namespace bmp {
             return;
         }
 
-        /// Opening file in binary mode
-        std::ifstream file(path, std::ios::binary);
-        if (!file) {
+        /// Mapping file [only pages holding the headers are read]
+        MappedFile file(path);
+        if (!file.isOpen()) {
             std::cerr << "Unable to open file! Path provided: " << path << std::endl;
             return;
         }
 
-        /// Reading file header
-        file.read(reinterpret_cast<char*>(&fileHeader), sizeof(BMP_FileHeader));
+        /// Reading file header and File Header Information
+        if (!bmp::readBMPHeaders(file, fileHeader, fileInfoHeader)) {
+            return;
+        }
 
         /// Checking if provided file is in BMP format
         if (fileHeader.fileType != 0x4D42) {//(0x4D42 -> "BM" in hexadecimal)
@@ -65,9 +72,6 @@ namespace bmp {
             return;
         }
 
-        /// Reading File Header Information
-        file.read(reinterpret_cast<char*>(&fileInfoHeader), sizeof(fileInfoHeader));
-
         /// Printing Received Information
         std::cout << "File Type: " << fileHeader.fileType << std::endl;
         std::cout << "File Size: " << fileHeader.fileSize << " bytes." << std::endl;
@@ -75,10 +79,8 @@ namespace bmp {
         std::cout << "Image Header Size: " << fileInfoHeader.size << std::endl;
         std::cout << "Image Width: " << fileInfoHeader.width << std::endl;
         std::cout << "Image Height: " << fileInfoHeader.height << std::endl;
+        std::cout << "Bits per pixel: " << fileInfoHeader.bitCount << std::endl;
         std::cout << "Size of the image data: " << fileInfoHeader.imageSize << " bytes." << std::endl;
-
-        /// Closing File
-        file.close();
     }
 
     /**
@@ -86,226 +88,61 @@ namespace bmp {
     * @function encrypt
     *
     * @param path -> path of the file(image)
-    * @param msg -> message that should be encrypted
-    * @flags -e <i>OR</i> -encrypt
-    * @details This function is used to encrypt provided message into the image
-    * @attention * .bmp file stores data starting from the bottom-left corner<br>
-     *           * std::bitset<8> stores LSB on the right side, so for example (7,6,5,4,3,2,1,0) bitset will have a LSB at position 0<br>
-     *           * Changing each 2 LSB in .bmp file (image)
+    * @param msg -> message that should be encrypted [argument, file or standard input]
+    * @param options -> compression, density and channels [all of them are stored in PayloadHeader], key scattering the message, secret encrypting it
+    * @flags -e <i>OR</i> -encrypt [--compress] [-bits N] [-channels rgb] [-key text] [-passphrase text <i>OR</i> -keyfile path]
+    * @details This function is used to encrypt provided message into the image [steg::encodeFile, see Steg.h]
+    * @attention * Message is preceded by PayloadHeader [length, density], so decrypt needs no other information<br>
+    *            * Message is pulled from the stream chunk by chunk, it is never held in memory as a whole<br>
+    *            * Only headers and the changed prefix of pixel data pass through memory, the rest is copied by the kernel<br>
+    *            * Pixel data is filled in stored order [bottom row first, channels as B, G, R], -key scatters the message over all of it [Scatter.h]<br>
+    *            * Message bits are embedded MSB-first by kernels::embed (SIMD kernel picked at runtime, see LSBKernels.h)<br>
+    *            * Changing each 2 LSB in .bmp file (image) by default, -bits and -channels choose another plan [EmbedPlan.h]<br>
+    *            * Alpha of a 32-bit file is left unchanged unless -channels has 'a' [-channels rgba]<br>
+    *            * Headers and other bytes of the file are kept as they are
     * */
 
-    auto encrypt(const std::string& path, std::string msg) -> void{
+    inline auto encrypt(const std::string& path, std::istream& msg, const steg::EncodeOptions& options = {}) -> void{
         /// Checking whether path was provided and its correctness
         if(path.empty()){
             std::cerr << "Path is incorrect or was not provided!" << std::endl;
             return;
         }
 
-        BMP_FileHeader fileHeader;              // <<File Header[fileType, fileSize, dataOffset]>>
-        BMP_FileInfoHeader fileInfoHeader;      // <<File Information Header[size, width, height, bitCount, compression, ...]>>
-        std::vector<unsigned char> pixelData;   // vector of image(pixel) data
-
-        /// Converting message into binary string
-        std::bitset<8> string_to_b[100];
-        for (int i = 0; i < msg.size(); ++i) string_to_b[i] = std::bitset<8>(msg[i]);
-        auto long_string = std::string();
-        for (int i = 0; i < msg.size(); ++i)
-            for (int j = 7; j >= 0; --j)
-                long_string += std::to_string(string_to_b[i][j]);
-
-        /// Reading File
-        if(!bmp::readFromBMP(path, fileHeader, fileInfoHeader, pixelData)){
-            return;
-        }
-
-        /// Checking if image(pixel) data is not empty
-        if(pixelData.empty()){
-            std::cout << "Error! Image(pixel) data is empty!" << std::endl;
+        /// Embedding header and message, the untouched rest of the file is copied by the kernel
+        steg::Status status = steg::encodeFile(path, "..\\ImageStegonography\\bmp_encrypted_file.bmp", msg, options);
+        if(status != steg::Status::Ok){
+            std::cerr << "Error! " << steg::describe(status) << ". Path provided: " << path << std::endl;
             return;
         }
-
-        for (int y = fileInfoHeader.height - 1; y >= 0; --y) { //starting from the bottom-left corner
-            for (int x = 0; x < fileInfoHeader.width; ++x) { //going through each pixel in line
-                /// Checking if long_string is empty (end of the looping, message is encrypted)
-                if(long_string.empty()){
-                    bmp::writeToBMP(path, pixelData, fileInfoHeader.width, fileInfoHeader.height);
-                    std::ofstream message_log("..\\ImageStegonography\\message_log.txt", std::ios::app);
-                    message_log << x;
-                    message_log.close();
-                    std::cout << "Message is successfully encrypted into bmp_encrypted_file.bmp!" << std::endl;
-                    return;
-                }
-
-                /// Calculating index to access image(pixel) data and extracting RGB values from each pixel
-
-                int index = (x + y * fileInfoHeader.width) * 3;
-                unsigned char blue = pixelData[index];
-                unsigned char green = pixelData[index + 1];
-                unsigned char red = pixelData[index + 2];
-
-                /// Converting RGB values into bitsets
-                std::bitset<8> red_value(red);
-                std::bitset<8> green_value((char)green);
-                std::bitset<8> blue_value((char)blue);
-
-                /// Lambda function to change bit at some index in bitsets (bit representaion of RGB values)
-
-                auto change_value = [&long_string](std::bitset<8>& bitset, int index)->void{
-                    if (index < 0 || index >= bitset.size()) {
-                        std::cerr << "Error! Index: " << index << " is out of bounds for bitset of size: " << bitset.size() <<  std::endl;
-                        return;
-                    }
-                    if(long_string.empty()){
-                        return;
-                    }
-                    if(long_string[0] == '0') bitset.set(index, 0);
-                    else bitset.set(index, 1);
-                    long_string.erase(0, 1);
-                };
-
-                change_value(red_value, 1);
-                change_value(red_value, 0);
-                change_value(green_value, 1);
-                change_value(green_value, 0);
-                change_value(blue_value, 1);
-                change_value(blue_value, 0);
-
-                /// Changing each RGB values in image(pixel) data
-                pixelData[index] = static_cast<unsigned char>(blue_value.to_ulong());
-                pixelData[index + 1] = static_cast<unsigned char>(green_value.to_ulong());
-                pixelData[index + 2] = static_cast<unsigned char>(red_value.to_ulong());
-            }
-        }
+        std::cout << "Message is successfully encrypted into bmp_encrypted_file.bmp!" << std::endl;
     }
 
-
     /**
     * @brief Decrypt message from image
     * @function decrypt
     *
     * @param path -> path of the file(image)
-    * @flags -d <i>OR</i> -decrypt
-    * @details This function is used to decrypt message from the image
-    * @attention * .bmp file stores data starting from the bottom-left corner<br>
-    *            * std::bitset<8> stores LSB on the right side, so for example (7,6,5,4,3,2,1,0) bitset will have a LSB at position 0<br>
+    * @param output -> file receiving raw message bytes ["-" for standard output], message is printed when empty
+    * @param options -> key of a message encrypted with -key, secret of a message encrypted with -passphrase or -keyfile
+    * @flags -d <i>OR</i> -decrypt [-o output] [-key text] [-passphrase text <i>OR</i> -keyfile path]
+    * @details This function is used to decrypt message from the image [steg::decodeFile, see Steg.h].
+    *          Returns status of decoding [IoError when the message cannot be written], main turns it into the exit code.
+    * @attention * Message length, density and channels are read from PayloadHeader in the first 128 bytes of pixel data<br>
+    *            * Only the byte range holding header and message is read from the file [pread]<br>
+    *            * Extracted bits are packed MSB-first into bytes by kernels::extract<br>
+    *            * Message is checked against its CRC32C before it is written, a modified carrier gives ChecksumMismatch<br>
+    *            * Encrypted message is authenticated and decrypted with the secret [Cipher.h], a wrong one gives DecryptionFailed<br>
     * */
 
-    auto decrypt(const std::string& path)->void{
-        /// Checking whether path was provided and its correctness
-        if(path.empty()){
-            std::cerr << "Path is incorrect or was not provided!" << std::endl;
-            return;
-        }
-
-        /// Getting size of long_string
-        std::string message, line;
-        std::fstream message_log("..\\ImageStegonography\\message_log.txt");
-        while(std::getline(message_log, line)){
-            message += line;
-        }
-        message_log.close();
-
-        /// Deleting the content of the message log file
-        std::ofstream mf("..\\ImageStegonography\\message_log.txt", std::ios::out | std::ios::trunc);
-        mf.close();
-
-        /// Opening file
-        std::ifstream file(path,
-                           std::ios::binary);
-
-        if (!file.is_open()) {
-            std::cerr << "Failed to open file! Path provided: " << path << std::endl;
-            return;
-        }
-
-        BMP_FileHeader fileHeader;              // <<File Header[fileType, fileSize, dataOffset]>>
-        BMP_FileInfoHeader fileInfoHeader;      // <<File Header Information[size, width, height, bitCount, compression, ...]>>
-        std::vector<unsigned char> pixelData;
-
-        /// Reading File Header
-        if (!file.read(reinterpret_cast<char*>(&fileHeader), sizeof(BMP_FileHeader))) {
-            std::cerr << "Failed to read BMP Header." << std::endl;
-            file.close();
-            return;
-        }
-
-        /// Reading File Header Information
-        if (!file.read(reinterpret_cast<char*>(&fileInfoHeader), sizeof(BMP_FileInfoHeader))) {
-            std::cerr << "Failed to read BMP Information Header." << std::endl;
-            file.close();
-            return;
-        }
-
-        /// Checking whether bit count of the file is 24 and there is no compression [BMP format]
-        if (fileInfoHeader.bitCount != 24 || fileInfoHeader.compression != 0) {
-            std::cerr << "Unsupported BMP format." << std::endl;
-            file.close();
-            return;
-        }
-
-        /// Moving file pointer to the beginning of the image(pixel) data
-        file.seekg(fileHeader.dataOffset, std::ios::beg);
-
-        /// Resizing image(pixel) data
-        pixelData.resize(fileInfoHeader.imageSize);
-        if (!file.read(reinterpret_cast<char*>(pixelData.data()), pixelData.size())) {
-            std::cerr << "Failed to read pixel data!" << std::endl;
-            file.close();
-            return;
-        }
-        file.close();
-
-
-        auto res = std::string();
-        for (int y = fileInfoHeader.height - 1; y >= 0; --y) {
-            for (int x = 0; x < fileInfoHeader.width; ++x) {
-                if(x == std::stoi(message)){
-                    auto finalRes = std::string();
-                    for(int i = 0; i < res.size(); i+=8){
-                        std::string sub = res.substr(i, 8);
-                        if(sub.size() == 8){
-                            std::bitset<8> bitSubset(sub);
-                            char c = static_cast<char>(bitSubset.to_ulong());
-                            finalRes += c;
-                        }
-                    }
-                    std::cout << "Decrypted message: " << finalRes << std::endl;
-                    return;
-                }
-
-                /// Calculating index to iterate through image(pixel) data
-                int index = (x + y * fileInfoHeader.width) * 3;
-                if(pixelData.empty()){
-                    std::cerr << "Error! Image(pixel) data is empty!" << std::endl;
-                    return;
-                }
-
-                /// Checking index + 2 not to be bigger or equal than image(pixel) data size
-                if(index + 2 >= pixelData.size()){
-                    std::cerr << "Error!" << std::endl;
-                    continue;
-                }
-
-                /// Receiving RGB values
-                unsigned char blue = pixelData[index];
-                unsigned char green = pixelData[index + 1];
-                unsigned char red = pixelData[index + 2];
-
-                /// Converting RGB values to bitsets
-                std::bitset<8> red_value(red);
-                std::bitset<8> green_value(green);
-                std::bitset<8> blue_value(blue);
-
-                /// Lambda function to get 2 Least Significant Bits
-                auto getBit = [&res](std::bitset<8>& bitset){
-                    res += std::to_string(bitset[1]) += std::to_string(bitset[0]);
-                };
-
-                getBit(red_value);
-                getBit(green_value);
-                getBit(blue_value);
-            }
+    inline auto decrypt(const std::string& path, const std::string& output = "", const steg::DecodeOptions& options = {})->steg::Status{
+        std::vector<unsigned char> res;
+        steg::Status status = steg::decodeFile(path, res, options);
+        if(status != steg::Status::Ok){
+            std::cerr << "Error! " << steg::describe(status) << ". Path provided: " << path << std::endl;
+            return status;
         }
+        return stream::writeMessage(res, output) ? steg::Status::Ok : steg::Status::IoError;
     }
 
     /**
@@ -314,42 +151,30 @@ namespace bmp {
      *
      * @param path -> path of the file(image)
      * @param msg -> provided message
-     *
-     *
+     * @param options -> density and channels encrypt would use
+     * @flags -c <i>OR</i> -check [-bits N] [-channels rgb] [-passphrase text <i>OR</i> -keyfile path]
+     * @details Capacity is computed from the header alone [steg::inspect], as the number of message bytes encrypt can store
+     *          with the same options
      */
 
-    auto check(const std::string& path, const std::string& msg) -> void{
-        /// Checking whether path was provided and its correctness
-        if(path.empty()){
-            std::cerr << "Path is incorrect or was not provided!" << std::endl;
-            return;
-        }
-
-        BMP_FileHeader fileHeader;              // <<File Header[fileType, fileSize, dataOffset]>>
-        BMP_FileInfoHeader fileInfoHeader;      // <<File Header Information[size, width, height, bitCount, compression, ...]>>
-
-        /// Opening file [binary mode]
-        std::ifstream file(path,std::ios::binary);
-        if (!file.is_open()) {
-            std::cerr << "Unable to open file! Path provided: " << path << std::endl;
+    inline auto check(const std::string& path, const std::string& msg, const steg::EncodeOptions& options = {}) -> void{
+        /// Reading headers only [pixel data is not read]
+        steg::Info info;
+        steg::Status status = steg::inspect(path, info, options);
+        if(status != steg::Status::Ok){
+            std::cerr << "Error! " << steg::describe(status) << ". Path provided: " << path << std::endl;
             return;
         }
-        /// Reading file
-        file.read(reinterpret_cast<char*>(&fileHeader), sizeof(fileHeader));
-        file.read(reinterpret_cast<char*>(&fileInfoHeader), sizeof(fileHeader));
 
         /// Printing information
         std::cout << "Message \"" << msg << "\" size is " << msg.size() << " bytes." << std::endl;
-        std::cout << "Size file can store - " << fileHeader.fileSize << " bytes." << std::endl;
+        std::cout << "Size file can store - " << info.capacity << " bytes [" << info.density << " LSB per used byte]." << std::endl;
 
-        if((msg.size() > fileHeader.fileSize)){
+        if((msg.size() > info.capacity)){
             std::cerr << "Size of message is bigger than size file can store!" << std::endl;
             return;
         }
-        else std::cout << "Size of message is acceptable for file(image)" << std::endl;
-
-        /// Closing file
-        file.close();
+        std::cout << "Size of message is acceptable for file(image)" << std::endl;
     }
 }
 
@@ -368,7 +193,7 @@ namespace ppm{
     *              &emsp;&emsp;- Image(pixel) data
     * */
 
-    auto info(const std::string& path)->void{
+    inline auto info(const std::string& path)->void{
         /// Checking whether path was provided and its correctness
         if(path.empty()){
             std::cerr << "Path is incorrect or was not provided!" << std::endl;
@@ -377,25 +202,26 @@ namespace ppm{
 
         PPM_FileHeader imageHeader;
 
-        /// Opening file in binary mode
-        std::ifstream ppm_file(path);
-        if (!ppm_file) {
+        /// Mapping file [only pages holding the header are read]
+        MappedFile ppm_file(path);
+        if (!ppm_file.isOpen()) {
             std::cerr << "Unable to open file! Path provided: " << path << std::endl;
             return;
         }
 
         /// Reading file information [magic number, width, height, max color value]
-        ppm_file >> imageHeader.magic_number >> imageHeader.width >> imageHeader.height
-                 >> imageHeader.max_color_val;
+        std::size_t dataOffset = 0;
+        if (!ppm::readPPMHeader(ppm_file, imageHeader, dataOffset)) {
+            return;
+        }
 
         /// Printing received information
         std::cout << "Magic Number(Type): " << imageHeader.magic_number << std::endl;
         std::cout << "Width: " << imageHeader.width << std::endl;
         std::cout << "Height: " << imageHeader.height << std::endl;
         std::cout << "Max color value: " << imageHeader.max_color_val << std::endl;
-
-        /// Closing File
-        ppm_file.close();
+        std::cout << "Samples per pixel: " << imageHeader.depth << std::endl;
+        if (!imageHeader.tuple_type.empty()) std::cout << "Tuple type: " << imageHeader.tuple_type << std::endl;
     }
 
     /**
@@ -403,88 +229,34 @@ namespace ppm{
     * @function encrypt
     *
     * @param path -> path of the file(image)
-    * @param msg -> message that should be encrypted
-    * @flags -e <i>OR</i> -encrypt
-    * @details This function is used to encrypt provided message into the image
+    * @param msg -> message that should be encrypted [argument, file or standard input]
+    * @param options -> compression, density and channels [all of them are stored in PayloadHeader], key scattering the message, secret encrypting it
+    * @flags -e <i>OR</i> -encrypt [--compress] [-bits N] [-channels rgb] [-key text] [-passphrase text <i>OR</i> -keyfile path]
+    * @details This function is used to encrypt provided message into the image [steg::encodeFile, see Steg.h]
+    * @attention * Message is preceded by PayloadHeader [length, density], so decrypt needs no other information<br>
+    *            * Message is pulled from the stream chunk by chunk, it is never held in memory as a whole<br>
+    *            * Only headers and the changed prefix of pixel data pass through memory, the rest is copied by the kernel<br>
+    *            * Changing LSB of each byte in .ppm file (image) by default, -bits and -channels choose another plan [EmbedPlan.h]<br>
+    *            * Only the low byte of every 16-bit sample is changed [max color value above 255]<br>
+    *            * Same goes for .pgm and .pam files [gray, gray and alpha, RGB and alpha samples], plain text files [P2, P3] are written as text again
     * */
 
-    auto encrypt(const std::string &path, std::string msg) {
+    inline auto encrypt(const std::string& path, std::istream& msg, const steg::EncodeOptions& options = {}) -> void{
         /// Checking whether path was provided and its correctness
         if(path.empty()){
             std::cerr << "Path is incorrect or was not provided!" << std::endl;
             return;
         }
 
-        PPM_FileHeader imageHeader;
-
-        /// Converting message into bit representation(long_string)
-        std::bitset<8> string_to_b[100];
-        for (int i = 0; i < msg.size(); ++i) string_to_b[i] = std::bitset<8>(msg[i]);
-        std::string long_string;
-        for (int i = 0; i < msg.size(); ++i) {
-            for (int j = 7; j >= 0; --j)
-                long_string += std::to_string(string_to_b[i][j]);
-        }
-
-        /// Reading file
-        if (!ppm::readPPMImage(path, imageHeader)) {
-            std::cout << "Error while reading file! Path provided: " << path << std::endl;
+        /// Embedding header and message, the untouched rest of the file is copied by the kernel
+        /// Encrypted file keeps the extension of the image [.ppm, .pgm, .pnm or .pam]
+        const std::string name = "ppm_encrypted_file" + path.substr(path.size() - 4);
+        steg::Status status = steg::encodeFile(path, "..\\ImageStegonography\\" + name, msg, options);
+        if(status != steg::Status::Ok){
+            std::cerr << "Error! " << steg::describe(status) << ". Path provided: " << path << std::endl;
             return;
         }
-
-
-
-        auto res = std::string();
-        for (int y = 0; y < imageHeader.height; y++) {
-            for (int x = 0; x < imageHeader.width; ++x) {
-                /// Checking if long_string is empty (end of the looping, message is encrypted)
-                if (long_string.empty()) {
-                    ppm::writeToPPM(path, imageHeader);
-                    std::ofstream message_log("..\\ImageStegonography\\message_log.txt",
-                                              std::ios::app);
-                    message_log << x;
-                    message_log.close();
-                    std::cout << "Message is successfully encrypted into ppm_encrypted_file.ppm!" << std::endl;
-                    return;
-                }
-
-                /// Calculating index to access image(pixel) data and extracting RGB values from each pixel
-                int index = (x + y * imageHeader.width) * 3;
-                unsigned char red = imageHeader.image_data[index];
-                unsigned char green = imageHeader.image_data[index + 1];
-                unsigned char blue = imageHeader.image_data[index + 2];
-
-                /// Converting RGB values into bitsets
-                std::bitset<8> red_value(red);
-                std::bitset<8> green_value((char) green);
-                std::bitset<8> blue_value((char) blue);
-
-                /// Lambda function to change bit at some index in bitsets (bit representaion of RGB values)
-                auto change_value = [&long_string](std::bitset<8> &bitset, int index) -> void {
-                    if (index < 0 || index >= bitset.size()) {
-                        std::cerr << "Error! Index: " << index << " is out of bounds for bitset of size: "
-                                  << bitset.size() << std::endl;
-                        return;
-                    }
-                    if (long_string.empty()) {
-                        return;
-                    }
-                    if (long_string[0] == '0') bitset.set(index, 0);
-                    else bitset.set(index, 1);
-                    long_string.erase(0, 1);
-                };
-
-
-                change_value(red_value, 0);
-                change_value(green_value, 0); // 0 - LSB, 1 - second LSB
-                change_value(blue_value, 0);
-
-                /// Changing each RGB values in image(pixel) data
-                imageHeader.image_data[index] = static_cast<unsigned char>(red_value.to_ulong());
-                imageHeader.image_data[index + 1] = static_cast<unsigned char>(green_value.to_ulong());
-                imageHeader.image_data[index + 2] = static_cast<unsigned char>(blue_value.to_ulong());
-            }
-        }
+        std::cout << "Message is successfully encrypted into " << name << "!" << std::endl;
     }
 
     /**
@@ -492,95 +264,26 @@ namespace ppm{
     * @function decrypt
     *
     * @param path -> path of the file(image)
-    * @flags -d <i>OR</i> -decrypt
-    * @details This function is used to decrypt message from the image
-    * @attention * std::bitset<8> stores LSB on the right side, so for example (7,6,5,4,3,2,1,0) bitset will have a LSB at position 0<br>
+    * @param output -> file receiving raw message bytes ["-" for standard output], message is printed when empty
+    * @param options -> key of a message encrypted with -key, secret of a message encrypted with -passphrase or -keyfile
+    * @flags -d <i>OR</i> -decrypt [-o output] [-key text] [-passphrase text <i>OR</i> -keyfile path]
+    * @details This function is used to decrypt message from the image [steg::decodeFile, see Steg.h].
+    *          Returns status of decoding [IoError when the message cannot be written], main turns it into the exit code.
+    * @attention * Message length, density and channels are read from PayloadHeader in the first 128 bytes of pixel data<br>
+    *            * Only the byte range holding header and message is read from the file [pread]<br>
+    *            * Extracted bits are packed MSB-first into bytes by kernels::extract<br>
+    *            * Message is checked against its CRC32C before it is written, a modified carrier gives ChecksumMismatch<br>
+    *            * Encrypted message is authenticated and decrypted with the secret [Cipher.h], a wrong one gives DecryptionFailed<br>
     * */
 
-
-    auto decrypt(const std::string &path) {
-        /// Checking whether path was provided and its correctness
-        if(path.empty()){
-            std::cerr << "Path is incorrect or was not provided!" << std::endl;
-            return;
-        }
-
-        PPM_FileHeader imageHeader;
-
-        /// Getting size of long_string
-        std::string message, line;
-        std::ifstream message_log("..\\ImageStegonography\\message_log.txt");
-        while (std::getline(message_log, line)) message += line;
-        message_log.close();
-        /// Deleting the content of the message log file
-        std::ofstream mf("..\\ImageStegonography\\message_log.txt", std::ios::out | std::ios::trunc);
-        mf.close();
-
-        /// Opening file
-        std::ifstream file(path,
-                           std::ios::binary);
-
-        /// Reading File
-        file >> imageHeader.magic_number >> imageHeader.width >> imageHeader.height >> imageHeader.max_color_val;
-        file.ignore();
-
-        int numberOfPixels = imageHeader.width * imageHeader.height;
-        imageHeader.image_data.resize(numberOfPixels * 3);
-        file.read(reinterpret_cast<char*>(imageHeader.image_data.data()), imageHeader.image_data.size());
-        if(!file){
-            std::cout << "Not a pixel data!" << std::endl;
-            return;
-        }
-        if (!file.is_open()) {
-            std::cerr << "Failed to open file." << std::endl;
-            return; //the program does not execute successfully and there is some error
-        }
-        file.close();
-
-        auto res = std::string();
-        for (int y = 0; y < imageHeader.height; y++) {
-            for (int x = 0; x < imageHeader.width; ++x) {
-                if (x == std::stoi(message)) {
-                    auto finalRes = std::string();
-                    for (int i = 0; i < res.size(); i += 8) {
-                        std::string sub = res.substr(i, 8);
-                        if (sub.size() == 8) {
-                            std::bitset<8> bitSubset(sub);
-                            char c = static_cast<char>(bitSubset.to_ulong());
-                            finalRes += c;
-                        }
-                    }
-                    std::cout << "Decrypted message: " << finalRes << std::endl;
-                    return;
-                }
-                /// Calculating index
-                int index = (x + y * imageHeader.width) * 3;
-                if (imageHeader.image_data.empty()) {
-                    std::cerr << "Error! Image(pixel) data is empty!" << std::endl;
-                    return;
-                }
-
-                if (index + 2 >= imageHeader.image_data.size()) {
-                    std::cerr << "Error!" << std::endl;
-                    continue;
-                }
-
-                /// Receiving RGB values
-                unsigned char red = imageHeader.image_data[index];
-                unsigned char green = imageHeader.image_data[index + 1];
-                unsigned char blue = imageHeader.image_data[index + 2];
-
-                /// Converting RGB values to bitsets
-                std::bitset<8> red_value(red);
-                std::bitset<8> green_value(green);
-                std::bitset<8> blue_value(blue);
-
-                /// Storing LSB in res variable
-                res += std::to_string(red_value[0]);
-                res += std::to_string(green_value[0]);
-                res += std::to_string(blue_value[0]);
-            }
+    inline auto decrypt(const std::string& path, const std::string& output = "", const steg::DecodeOptions& options = {})->steg::Status{
+        std::vector<unsigned char> res;
+        steg::Status status = steg::decodeFile(path, res, options);
+        if(status != steg::Status::Ok){
+            std::cerr << "Error! " << steg::describe(status) << ". Path provided: " << path << std::endl;
+            return status;
         }
+        return stream::writeMessage(res, output) ? steg::Status::Ok : steg::Status::IoError;
     }
 
     /**
@@ -589,62 +292,30 @@ namespace ppm{
      *
      * @param path -> path of the file(image)
      * @param msg -> provided message
-     *
-     *
+     * @param options -> density and channels encrypt would use
+     * @flags -c <i>OR</i> -check [-bits N] [-channels rgb] [-passphrase text <i>OR</i> -keyfile path]
+     * @details Capacity is computed from the header alone [steg::inspect], as the number of message bytes encrypt can store
+     *          with the same options
      */
 
-    auto check(const std::string& path, const std::string& msg){
-        /// Checking whether path was provided and its correctness
-        if(path.empty()){
-            std::cerr << "Path is incorrect or was not provided!" << std::endl;
-            return;
-        }
-        PPM_FileHeader ppm;
-        /// Opening file
-        std::ifstream ppm_file(path,std::ios::binary);
-        if (!ppm_file.is_open()) {
-            std::cerr << "Unable to open file! Path provided: " << path << std::endl;
-            return;
-        }
-
-        /// Reading magic number(type)
-        ppm_file >> ppm.magic_number;
-
-        /// Checking magic number(type) [P3 - plain text, P6 - binary]
-        if (ppm.magic_number != "P6") {
-            std::cerr << "Unsupported BMP format." << std::endl;
-            ppm_file.close();
-            return;
-        }
-
-        /// Reading other data
-        ppm_file >> ppm.width >> ppm.height >> ppm.max_color_val;
-        /// Skipping whitespace
-        ppm_file.ignore();
-
-        /// Calculating number of pixels and resizing image(pixel) data to this size
-        int numberOfPixels = ppm.width * ppm.height;
-        int availableBits = numberOfPixels * 24; // each pixel occupies 24 bits(3 bytes)
-        ppm.image_data.resize(numberOfPixels * 3);
-
-        /// Reading pixel data from the file(image)
-        ppm_file.read(reinterpret_cast<char *>(&ppm.image_data[0]), ppm.image_data.size());
-        if (!ppm_file) {
-            std::cout << "Error while reading image(pixel) data!" << std::endl;
+    inline auto check(const std::string& path, const std::string& msg, const steg::EncodeOptions& options = {}) -> void{
+        /// Reading headers only [pixel data is not read]
+        steg::Info info;
+        steg::Status status = steg::inspect(path, info, options);
+        if(status != steg::Status::Ok){
+            std::cerr << "Error! " << steg::describe(status) << ". Path provided: " << path << std::endl;
             return;
         }
 
-        /// Printing Received Information
+        /// Printing information
         std::cout << "Message \"" << msg << "\" size is " << msg.size() << " bytes." << std::endl;
-        std::cout << "Size file can store - " << (availableBits / 8) << " bytes." << std::endl;
-        if((msg.size() > (availableBits / 8))) {
+        std::cout << "Size file can store - " << info.capacity << " bytes [" << info.density << " LSB per used byte]." << std::endl;
+
+        if((msg.size() > info.capacity)){
             std::cerr << "Size of the message is bigger than size file can store!" << std::endl;
             return;
         }
         std::cout << "Message can be encrypted into the file(image)" << std::endl;
-
-        /// Closing file
-        ppm_file.close();
     }
 
 }
@@ -656,12 +327,13 @@ namespace ppm{
  *  @details Function is used to show 'help' information for users
 */
 
-auto help() -> void
+inline auto help() -> void
 {
     std::cout << "\t    <Help>\n";
     std::cout << " Supported image file extensions" << std::endl;
     std::cout << "  .bmp\t" << std::endl;
     std::cout << "  .ppm\t" << std::endl;
+    std::cout << "  .pgm, .pnm, .pam [Netpbm P2, P3, P5, P6, P7, 8 or 16-bit samples]\t" << std::endl;
     std::cout << " Unsupported image file extensions" << std::endl;
     std::cout << "  .gif" << std::endl;
     std::cout << "  .jpeg" << std::endl;
@@ -672,12 +344,43 @@ auto help() -> void
     std::cout << "  * Carefully check provided image location path\t" << std::endl;
     std::cout << "  * When You are providing both path and msg, firstly provide path and then message\t" << std::endl;
     std::cout << "  * Message argument can ve provided in quotes \" \" for it to be with spaces, e.g. \"Hello, My Dear Friend!\"\t" << std::endl;
+    std::cout << "  * Use -s input msg output to encrypt without loading the whole image into memory, \"-\" stands for stdin/stdout\t" << std::endl;
+    std::cout << "  * Use -d - to decrypt image read from stdin\t" << std::endl;
+    std::cout << "  * Use --payload-file file in place of the message to encrypt contents of the file, \"-\" stands for stdin\t" << std::endl;
+    std::cout << "  * Use -d image -o file to write raw decrypted bytes into the file, \"-\" stands for stdout\t" << std::endl;
+    std::cout << "  * Use -index directory to catalog capacities of all images in the directory (headers only)\t" << std::endl;
+    std::cout << "  * Use -pick directory msg to find the smallest indexed image that can store the message\t" << std::endl;
+    std::cout << "  * Use -batch manifest to run many jobs at once, one job per line with tab separated fields:\t" << std::endl;
+    std::cout << "      e<TAB>image<TAB>message<TAB>output  OR  d<TAB>image[<TAB>output]\t" << std::endl;
+    std::cout << "      reads, embedding and writes of up to -depth N (32) encrypt jobs overlap, --fsync syncs every encrypted file\t" << std::endl;
+    std::cout << "  * Use -daemon socket [-workers N] [-cache MB] to serve requests over a Unix socket, one per line:\t" << std::endl;
+    std::cout << "      e<TAB>image<TAB>message<TAB>output[<TAB>z]  OR  d<TAB>image[<TAB>output]  OR  c<TAB>image<TAB>message  OR  s\t" << std::endl;
+    std::cout << "  * Add --compress to -e OR -s to compress the message before hiding it, decrypt detects it\t" << std::endl;
+    std::cout << "  * Add -bits N (1-4) and -channels rgb|r|g|b|rg|rgba|... to -e, -s OR -c to choose LSBs and channels holding the message [a - alpha of 32-bit BMP]\t" << std::endl;
+    std::cout << "  * Add -key text to -e OR -s to scatter the message over the whole image in the order of the key, -d needs the same key\t" << std::endl;
+    std::cout << "  * Add -passphrase text OR -keyfile path to -e OR -s to encrypt the message [ChaCha20-Poly1305], -d needs the same secret\t" << std::endl;
+    std::cout << "  * -d exits with 1 on error and with 2 when the message does not match its checksum [carrier was modified]\t" << std::endl;
+    std::cout << "  * Add --fsync to -e, -s OR -batch to flush every encrypted file to the device before reporting success\t" << std::endl;
+    std::cout << "  * Add --stats to any command to print its timings, bytes and peak memory as JSON on stderr\t" << std::endl;
     std::cout << "  * In case of some bugs or errors contact us on +48519578025\t" << std::endl;
     std::cout << " Supported flags list: " << std::endl;
     std::cout << "  -i" << std::endl;
     std::cout << "  -e" << std::endl;
     std::cout << "  -d" << std::endl;
+    std::cout << "  -s" << std::endl;
     std::cout << "  -c" << std::endl;
+    std::cout << "  -batch" << std::endl;
+    std::cout << "  -index" << std::endl;
+    std::cout << "  -pick" << std::endl;
+    std::cout << "  -daemon" << std::endl;
+    std::cout << "  --compress" << std::endl;
+    std::cout << "  -bits" << std::endl;
+    std::cout << "  -channels" << std::endl;
+    std::cout << "  -key" << std::endl;
+    std::cout << "  -passphrase" << std::endl;
+    std::cout << "  -keyfile" << std::endl;
+    std::cout << "  --fsync" << std::endl;
+    std::cout << "  --stats" << std::endl;
     std::cout << "  -h" << std::endl;
 }
 
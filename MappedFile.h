@@ -0,0 +1,138 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "Stats.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#define STEG_POSIX 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/**
+ * @class MappedFile
+ * @brief Read-only view of the whole file(image)
+ * @var
+ * <b>bytes</b> -> first byte of the file<br>
+ * <b>length</b> -> file size (in 'bytes')<br>
+ * <b>fallback</b> -> file content on platforms without mmap
+ * @details File is mapped into memory with mmap, so commands that only look at a header or at a part of
+ *          the pixel data do not allocate and copy the whole image. Pages are read by the kernel on first access,
+ *          advise() tells it which part will be needed and in what order.
+ * @attention Object owns the mapping, it can be moved but not copied
+ */
+
+class MappedFile {
+public:
+    /// Expected access pattern passed to advise()
+    enum class Access { Sequential, WillNeed };
+
+    MappedFile() = default;
+
+    explicit MappedFile(const std::string& path) { open(path); }
+
+    MappedFile(MappedFile&& other) noexcept { *this = std::move(other); }
+
+    auto operator=(MappedFile&& other) noexcept -> MappedFile& {
+        if (this != &other) {
+            close();
+            bytes = other.bytes;
+            length = other.length;
+            fallback = std::move(other.fallback);
+            other.bytes = nullptr;
+            other.length = 0;
+        }
+        return *this;
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    auto operator=(const MappedFile&) -> MappedFile& = delete;
+
+    ~MappedFile() { close(); }
+
+    /**
+     * @brief Mapping file into memory
+     * @function open
+     * @param path -> path of the file<br>
+     * @details Whole file is mapped read-only and marked for sequential access
+     */
+
+    auto open(const std::string& path) -> bool {
+        stats::Timer timer(stats::Phase::Open);
+        close();
+#if defined(STEG_POSIX)
+        int descriptor = ::open(path.c_str(), O_RDONLY);
+        if (descriptor < 0) return false;
+        struct stat status{};
+        if (::fstat(descriptor, &status) != 0 || status.st_size <= 0) {
+            ::close(descriptor);
+            return false;
+        }
+        void* address = ::mmap(nullptr, static_cast<std::size_t>(status.st_size), PROT_READ, MAP_PRIVATE, descriptor, 0);
+        ::close(descriptor); // mapping stays valid after closing the descriptor
+        if (address == MAP_FAILED) return false;
+        bytes = static_cast<const unsigned char*>(address);
+        length = static_cast<std::size_t>(status.st_size);
+        advise(0, length, Access::Sequential);
+#else
+        std::ifstream file(path, std::ios::binary | std::ios::ate);
+        if (!file) return false;
+        fallback.resize(static_cast<std::size_t>(file.tellg()));
+        file.seekg(0, std::ios::beg);
+        if (fallback.empty() || !file.read(reinterpret_cast<char*>(fallback.data()), fallback.size())) {
+            fallback.clear();
+            return false;
+        }
+        bytes = fallback.data();
+        length = fallback.size();
+#endif
+        return true;
+    }
+
+    /**
+     * @brief Giving the kernel a hint about how part of the file will be accessed
+     * @function advise
+     * @param offset -> offset of the first byte (in 'bytes')<br>
+     * @param size -> size of the part (in 'bytes')<br>
+     * @param access -> Sequential [aggressive read-ahead] or WillNeed [start reading pages now]
+     */
+
+    auto advise(std::size_t offset, std::size_t size, Access access) const -> void {
+#if defined(STEG_POSIX)
+        if (!bytes || offset >= length) return;
+        auto page = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+        std::size_t begin = offset / page * page;
+        std::size_t end = std::min(length, offset + size);
+        ::madvise(const_cast<unsigned char*>(bytes) + begin, end - begin,
+                  access == Access::Sequential ? MADV_SEQUENTIAL : MADV_WILLNEED);
+#else
+        (void)offset; (void)size; (void)access;
+#endif
+    }
+
+    auto close() -> void {
+#if defined(STEG_POSIX)
+        if (bytes) ::munmap(const_cast<unsigned char*>(bytes), length);
+#endif
+        fallback.clear();
+        bytes = nullptr;
+        length = 0;
+    }
+
+    auto isOpen() const -> bool { return bytes != nullptr; }
+    auto data() const -> const unsigned char* { return bytes; }
+    auto size() const -> std::size_t { return length; }
+
+private:
+    const unsigned char* bytes = nullptr;
+    std::size_t length = 0;
+    std::vector<unsigned char> fallback;
+};
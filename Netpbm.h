@@ -0,0 +1,492 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <istream>
+#include <ostream>
+#include <streambuf>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "PPMHeaderStruct.h"
+
+/**
+ * @file Netpbm.h
+ * @brief Header and raster parser of the Netpbm family [P2, P3, P5, P6 and PAM (P7)]
+ * @details Headers are parsed with std::from_chars straight out of a buffer [mapped file or its first bytes],
+ *          '#' comments are skipped wherever whitespace may stand. Streams read their header byte by byte and
+ *          hand it to the same parser, so both agree on every header.<br>
+ *          Binary rasters [P5, P6, P7] are used as they are: samples of 1 byte up to max color value 255,
+ *          2 bytes (big-endian) above it. Plain rasters [P2, P3] are converted into the same binary samples
+ *          by PlainScanner and back into text by PlainWriter, so every format is embedded by the same kernels.
+ */
+
+namespace netpbm {
+
+    /// Largest max color value [samples above 255 take 2 bytes, big-endian]
+    inline constexpr int maxColorValue = 65535;
+    /// Largest header read from a stream (in 'bytes')
+    inline constexpr std::size_t maxHeaderBytes = 4096;
+    /// Plain raster lines are kept within this many characters [as the format asks]
+    inline constexpr std::size_t maxLineLength = 70;
+
+    inline auto isSpace(char c) -> bool {
+        return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f';
+    }
+
+    /// Raster is plain text [P2, P3]
+    inline auto isPlain(const PPM_FileHeader& ppm) -> bool {
+        return ppm.magic_number == "P2" || ppm.magic_number == "P3";
+    }
+
+    /// Size of one sample (in 'bytes') [1 up to max color value 255, 2 above it]
+    inline auto sampleBytes(const PPM_FileHeader& ppm) -> std::size_t {
+        return ppm.max_color_val > 255 ? 2 : 1;
+    }
+
+    /// Format can carry a message [gray, gray with alpha, RGB or RGB with alpha samples of up to 16 bits]
+    inline auto isSupported(const PPM_FileHeader& ppm) -> bool {
+        const std::string& magic = ppm.magic_number;
+        bool known = magic == "P2" || magic == "P3" || magic == "P5" || magic == "P6" || magic == "P7";
+        return known && ppm.depth >= 1 && ppm.depth <= 4 && ppm.max_color_val >= 1 && ppm.max_color_val <= maxColorValue;
+    }
+
+    /**
+     * @brief Parsing PAM header [P7] after its magic number
+     * @function parsePAMHeader
+     * @details Header is a list of "KEY value" lines ended by ENDHDR, TUPLTYPE lines are joined by a space
+     */
+
+    inline auto parsePAMHeader(const char* begin, const char* current, const char* end, PPM_FileHeader& ppm,
+                               std::size_t& dataOffset) -> bool {
+        ppm.width = ppm.height = ppm.depth = ppm.max_color_val = 0;
+        ppm.tuple_type.clear();
+        auto trim = [](std::string_view text) {
+            while (!text.empty() && isSpace(text.front())) text.remove_prefix(1);
+            while (!text.empty() && isSpace(text.back())) text.remove_suffix(1);
+            return text;
+        };
+        auto number = [](std::string_view text, int& value) {
+            auto [last, error] = std::from_chars(text.data(), text.data() + text.size(), value);
+            return error == std::errc() && last == text.data() + text.size() && value > 0;
+        };
+
+        while (true) {
+            const char* newline = static_cast<const char*>(std::memchr(current, '\n', end - current));
+            if (newline == nullptr) return false;
+            std::string_view line = trim({current, static_cast<std::size_t>(newline - current)});
+            current = newline + 1;
+            if (line.empty() || line.front() == '#') continue;
+
+            auto split = std::min(line.find_first_of(" \t"), line.size());
+            std::string_view key = line.substr(0, split);
+            std::string_view value = trim(line.substr(split));
+            if (key == "ENDHDR") break;
+            bool valid = key == "WIDTH" ? number(value, ppm.width)
+                       : key == "HEIGHT" ? number(value, ppm.height)
+                       : key == "DEPTH" ? number(value, ppm.depth)
+                       : key == "MAXVAL" ? number(value, ppm.max_color_val)
+                       : key == "TUPLTYPE";
+            if (!valid) return false;
+            if (key == "TUPLTYPE") {
+                if (!ppm.tuple_type.empty()) ppm.tuple_type += ' ';
+                ppm.tuple_type.append(value);
+            }
+        }
+        dataOffset = static_cast<std::size_t>(current - begin);
+        return ppm.width > 0 && ppm.height > 0 && ppm.depth > 0 && ppm.max_color_val > 0;
+    }
+
+    /**
+     * @brief Parsing header of a Netpbm file held in memory
+     * @function parseHeader
+     * @param data -> first bytes of the file<br>
+     * @param size -> number of bytes available<br>
+     * @param ppm -> object of PPM_FileHeader struct, image_data is left untouched<br>
+     * @param dataOffset -> offset of the raster (in 'bytes')<br>
+     * @details Returns false when the bytes end before the header does, so a header arriving byte by byte is
+     *          parsed once it is complete. Raster starts after the single whitespace following the last number
+     *          [after the line of a comment standing right behind it]. Bitmaps [P1, P4] get max color value 1.
+     */
+
+    inline auto parseHeader(const unsigned char* data, std::size_t size, PPM_FileHeader& ppm, std::size_t& dataOffset) -> bool {
+        const char* begin = reinterpret_cast<const char*>(data);
+        const char* end = begin + size;
+        if (size < 3 || begin[0] != 'P' || begin[1] < '1' || begin[1] > '7' || !isSpace(begin[2])) return false;
+        ppm.magic_number = std::string(begin, 2);
+        const char kind = begin[1];
+        if (kind == '7') return parsePAMHeader(begin, begin + 2, end, ppm, dataOffset);
+
+        /// Lambda function skipping whitespace and comments, then reading a number ended by one of them
+        const char* current = begin + 2;
+        auto nextNumber = [&current, end](int& value) -> bool {
+            while (current < end && (isSpace(*current) || *current == '#')) {
+                if (*current == '#') {
+                    while (current < end && *current != '\n' && *current != '\r') ++current;
+                } else {
+                    ++current;
+                }
+            }
+            auto [last, error] = std::from_chars(current, end, value);
+            if (error != std::errc() || last == end || value <= 0) return false;
+            current = last;
+            return isSpace(*current) || *current == '#';
+        };
+
+        ppm.depth = kind == '3' || kind == '6' ? 3 : 1;
+        ppm.tuple_type.clear();
+        ppm.max_color_val = 1;
+        if (!nextNumber(ppm.width) || !nextNumber(ppm.height)) return false;
+        if (kind != '1' && kind != '4' && !nextNumber(ppm.max_color_val)) return false;
+        if (*current == '#') {
+            while (current < end && *current != '\n' && *current != '\r') ++current;
+            if (current >= end) return false;
+        }
+        dataOffset = static_cast<std::size_t>(current - begin) + 1;
+        return true;
+    }
+
+    /**
+     * @brief Reading header from the stream
+     * @function readHeader
+     * @param in -> input stream positioned at the start of the file<br>
+     * @param head -> bytes of the header as they were read<br>
+     * @param ppm -> object of PPM_FileHeader struct<br>
+     * @details Stream is left at the first byte of the raster, nothing past the header is read. Every byte that
+     *          may end the header is followed by a try of parseHeader.
+     */
+
+    inline auto readHeader(std::istream& in, std::string& head, PPM_FileHeader& ppm) -> bool {
+        head.clear();
+        std::size_t dataOffset = 0;
+        for (char c; head.size() < maxHeaderBytes && in.get(c);) {
+            head.push_back(c);
+            if ((c == '\n' || (isSpace(c) && head.size() > 2 && head[1] != '7'))
+                && parseHeader(reinterpret_cast<const unsigned char*>(head.data()), head.size(), ppm, dataOffset)) {
+                return dataOffset == head.size();
+            }
+        }
+        return false;
+    }
+
+    /**
+     * @brief Writing header of the canonical form
+     * @function writeHeader
+     * @param out -> output stream<br>
+     * @param ppm -> object of PPM_FileHeader struct<br>
+     */
+
+    inline auto writeHeader(std::ostream& out, const PPM_FileHeader& ppm) -> void {
+        out << ppm.magic_number << "\n";
+        if (ppm.magic_number == "P7") {
+            out << "WIDTH " << ppm.width << "\nHEIGHT " << ppm.height << "\nDEPTH " << ppm.depth
+                << "\nMAXVAL " << ppm.max_color_val << "\n";
+            if (!ppm.tuple_type.empty()) out << "TUPLTYPE " << ppm.tuple_type << "\n";
+            out << "ENDHDR\n";
+            return;
+        }
+        out << ppm.width << " " << ppm.height << "\n" << ppm.max_color_val << "\n";
+    }
+
+    /**
+     * @brief Masks of digits and whitespace in 64 bytes of text
+     * @function classify
+     * @details Bit i is set when byte i is a digit [whitespace]. SSE2 compares 16 bytes at once, the rest of the
+     *          scanner only walks the set bits, so runs of whitespace cost nothing per byte.
+     */
+
+    inline auto classify(const char* text, uint64_t& digits, uint64_t& spaces) -> void {
+#if defined(__SSE2__)
+        digits = 0;
+        spaces = 0;
+        for (int part = 0; part < 4; ++part) {
+            __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + 16 * part));
+            /// Range tests as signed compares of bytes moved down by (first + 128) ['0'..'9', '\t'..'\r']
+            __m128i digit = _mm_cmplt_epi8(_mm_sub_epi8(bytes, _mm_set1_epi8(static_cast<char>('0' + 128))),
+                                           _mm_set1_epi8(static_cast<char>(-128 + 10)));
+            __m128i control = _mm_cmplt_epi8(_mm_sub_epi8(bytes, _mm_set1_epi8(static_cast<char>('\t' + 128))),
+                                             _mm_set1_epi8(static_cast<char>(-128 + 5)));
+            __m128i space = _mm_or_si128(control, _mm_cmpeq_epi8(bytes, _mm_set1_epi8(' ')));
+            digits |= uint64_t(static_cast<uint16_t>(_mm_movemask_epi8(digit))) << (16 * part);
+            spaces |= uint64_t(static_cast<uint16_t>(_mm_movemask_epi8(space))) << (16 * part);
+        }
+#else
+        digits = 0;
+        spaces = 0;
+        for (int i = 0; i < 64; ++i) {
+            if (text[i] >= '0' && text[i] <= '9') digits |= uint64_t{1} << i;
+            else if (isSpace(text[i])) spaces |= uint64_t{1} << i;
+        }
+#endif
+    }
+
+    /**
+     * @class PlainScanner
+     * @brief Converting text of a plain raster into binary samples, chunk by chunk
+     * @var
+     * <b>limit</b> -> output bytes of the whole raster, text after the last sample is not read<br>
+     * <b>value</b>, <b>digits</b> -> number cut by the end of the previous chunk<br>
+     * @details Text is walked in blocks of 64 bytes [classify], a number may continue into the next chunk.
+     *          Anything but digits and whitespace, a number wider than the sample or a raster ending too
+     *          early marks the scanner failed. Numbers above max color value are kept, as the bytes of a
+     *          binary raster are [LSBs of a sample next to max color value may go past it].
+     */
+
+    class PlainScanner {
+    public:
+        PlainScanner(std::size_t bytesPerSample, uint64_t rasterBytes)
+            : maxSample(bytesPerSample == 2 ? 0xFFFF : 0xFF), bytesPerSample(bytesPerSample), limit(rasterBytes) {}
+
+        /// Converting the chunk, out has room for outputSamples(size); returns number of written bytes
+        auto scan(const char* text, std::size_t size, unsigned char* out) -> std::size_t {
+            std::size_t written = 0;
+            std::size_t i = 0;
+            for (; i + 64 <= size && !done(); i += 64) {
+                uint64_t digitMask = 0;
+                uint64_t spaceMask = 0;
+                classify(text + i, digitMask, spaceMask);
+                if (~(digitMask | spaceMask)) {
+                    failed = true;
+                    return written;
+                }
+                if (digits && !(digitMask & 1)) emit(out, written);
+                while (digitMask && !done()) {
+                    int start = std::countr_zero(digitMask);
+                    int run = std::countr_one(digitMask >> start);
+                    append(text + i + start, run);
+                    if (start + run < 64) {
+                        emit(out, written);
+                        digitMask &= ~uint64_t{0} << (start + run);
+                    } else {
+                        digitMask = 0;
+                    }
+                }
+            }
+            for (; i < size && !done(); ++i) {
+                if (text[i] >= '0' && text[i] <= '9') {
+                    append(text + i, 1);
+                } else if (isSpace(text[i])) {
+                    if (digits) emit(out, written);
+                } else {
+                    failed = true;
+                    break;
+                }
+            }
+            return written;
+        }
+
+        /// Writing the number cut by the end of the text [end of the stream]
+        auto finish(unsigned char* out) -> std::size_t {
+            std::size_t written = 0;
+            if (digits && !done()) emit(out, written);
+            return written;
+        }
+
+        /// Largest number of samples written for text of the given size [number cut by the previous chunk included]
+        static constexpr auto outputSamples(std::size_t size) -> std::size_t { return size / 2 + 2; }
+
+        auto done() const -> bool { return failed || produced >= limit; }
+        auto ok() const -> bool { return !failed; }
+        auto complete() const -> bool { return !failed && produced == limit; }
+
+    private:
+        auto append(const char* text, int count) -> void {
+            digits += count;
+            if (digits > 5) {
+                failed = true;
+                return;
+            }
+            for (int k = 0; k < count; ++k) value = value * 10 + static_cast<uint32_t>(text[k] - '0');
+        }
+
+        auto emit(unsigned char* out, std::size_t& written) -> void {
+            if (failed) return;
+            if (value > maxSample) {
+                failed = true;
+                return;
+            }
+            if (bytesPerSample == 2) out[written++] = static_cast<unsigned char>(value >> 8);
+            out[written++] = static_cast<unsigned char>(value);
+            produced += bytesPerSample;
+            value = 0;
+            digits = 0;
+        }
+
+        uint32_t maxSample;
+        std::size_t bytesPerSample;
+        uint64_t limit;
+        uint64_t produced = 0;
+        uint32_t value = 0;
+        int digits = 0;
+        bool failed = false;
+    };
+
+    /**
+     * @brief Converting a whole plain raster held in memory
+     * @function readPlain
+     * @param text -> raster text<br>
+     * @param size -> size of the text<br>
+     * @param ppm -> header of the image<br>
+     * @param out -> binary samples, width * height * depth * sampleBytes of them<br>
+     * @details Returns false when the text is damaged or holds fewer samples
+     */
+
+    inline auto readPlain(const unsigned char* text, std::size_t size, const PPM_FileHeader& ppm, unsigned char* out) -> bool {
+        const uint64_t rasterBytes = uint64_t(ppm.width) * ppm.height * ppm.depth * sampleBytes(ppm);
+        PlainScanner scanner(sampleBytes(ppm), rasterBytes);
+        constexpr std::size_t chunkBytes = std::size_t{1} << 20;
+        std::vector<unsigned char> samples(PlainScanner::outputSamples(chunkBytes) * 2);
+        uint64_t written = 0;
+        for (std::size_t offset = 0; offset < size && !scanner.done(); offset += chunkBytes) {
+            std::size_t count = std::min(chunkBytes, size - offset);
+            std::size_t got = scanner.scan(reinterpret_cast<const char*>(text) + offset, count, samples.data());
+            std::memcpy(out + written, samples.data(), got);
+            written += got;
+        }
+        std::size_t got = scanner.finish(samples.data());
+        std::memcpy(out + written, samples.data(), got);
+        return scanner.complete();
+    }
+
+    /**
+     * @class PlainReader
+     * @brief Stream buffer handing out binary samples of a plain raster read from another stream
+     * @details Used as std::istream raster(&reader), so row bands of StreamCodec.h read plain rasters as they
+     *          read binary ones. Text is read 64 KB at a time, reading stops at the last sample.
+     */
+
+    class PlainReader : public std::streambuf {
+    public:
+        PlainReader(std::istream& source, const PPM_FileHeader& ppm)
+            : source(source),
+              scanner(sampleBytes(ppm), uint64_t(ppm.width) * ppm.height * ppm.depth * sampleBytes(ppm)),
+              text(textBytes), samples(PlainScanner::outputSamples(textBytes) * 2) {}
+
+        auto ok() const -> bool { return scanner.ok(); }
+        auto complete() const -> bool { return scanner.complete(); }
+
+    protected:
+        auto underflow() -> int_type override {
+            if (gptr() < egptr()) return traits_type::to_int_type(*gptr());
+            std::size_t got = 0;
+            while (got == 0 && !scanner.done() && !ended) {
+                source.read(text.data(), static_cast<std::streamsize>(text.size()));
+                auto size = static_cast<std::size_t>(source.gcount());
+                got = scanner.scan(text.data(), size, samples.data());
+                if (size < text.size()) {
+                    got += scanner.finish(samples.data() + got);
+                    ended = true;
+                }
+            }
+            if (got == 0) return traits_type::eof();
+            char* data = reinterpret_cast<char*>(samples.data());
+            setg(data, data, data + got);
+            return traits_type::to_int_type(*gptr());
+        }
+
+    private:
+        static constexpr std::size_t textBytes = std::size_t{64} << 10;
+        std::istream& source;
+        PlainScanner scanner;
+        std::vector<char> text;
+        std::vector<unsigned char> samples;
+        bool ended = false;
+    };
+
+    /**
+     * @class PlainWriter
+     * @brief Stream buffer writing binary samples into another stream as a plain raster
+     * @details Samples are written as decimal numbers separated by a space, lines are broken before they get
+     *          longer than maxLineLength. Numbers of 8-bit samples come from a table. finish() writes the
+     *          samples still buffered and ends the last line.
+     */
+
+    class PlainWriter : public std::streambuf {
+    public:
+        PlainWriter(std::ostream& target, std::size_t bytesPerSample)
+            : target(target), bytesPerSample(bytesPerSample), samples(bufferBytes), text(bufferBytes * 4 + 16) {
+            char* data = reinterpret_cast<char*>(samples.data());
+            setp(data, data + samples.size());
+        }
+
+        auto finish() -> bool {
+            if (sync() != 0) return false;
+            if (lineLength) target.put('\n');
+            lineLength = 0;
+            return static_cast<bool>(target);
+        }
+
+    protected:
+        auto overflow(int_type c) -> int_type override {
+            if (sync() != 0) return traits_type::eof();
+            if (!traits_type::eq_int_type(c, traits_type::eof())) {
+                *pptr() = traits_type::to_char_type(c);
+                pbump(1);
+            }
+            return traits_type::not_eof(c);
+        }
+
+        auto sync() -> int override {
+            auto count = static_cast<std::size_t>(pptr() - pbase());
+            std::size_t whole = count / bytesPerSample * bytesPerSample;
+            std::size_t size = 0;
+            for (std::size_t i = 0; i < whole; i += bytesPerSample) {
+                unsigned value = bytesPerSample == 2 ? unsigned(samples[i]) << 8 | samples[i + 1] : samples[i];
+                const auto& number = numbers[value & 0xFF];
+                char digits[8];
+                const char* first = number.data() + 1;
+                std::size_t length = static_cast<unsigned char>(number[0]);
+                if (value > 255) {
+                    length = static_cast<std::size_t>(std::to_chars(digits, digits + sizeof(digits), value).ptr - digits);
+                    first = digits;
+                }
+                if (lineLength && lineLength + 1 + length > maxLineLength) {
+                    text[size++] = '\n';
+                    lineLength = 0;
+                } else if (lineLength) {
+                    text[size++] = ' ';
+                    ++lineLength;
+                }
+                std::memcpy(text.data() + size, first, length);
+                size += length;
+                lineLength += length;
+            }
+            if (!target.write(text.data(), static_cast<std::streamsize>(size))) return -1;
+
+            /// Byte of a 16-bit sample cut by the end of the buffer waits for the rest of it
+            std::memmove(samples.data(), samples.data() + whole, count - whole);
+            char* data = reinterpret_cast<char*>(samples.data());
+            setp(data, data + samples.size());
+            pbump(static_cast<int>(count - whole));
+            return 0;
+        }
+
+    private:
+        static constexpr std::size_t bufferBytes = std::size_t{64} << 10;
+
+        /// Decimal form of every byte value [length, digits]
+        static inline const std::array<std::array<char, 4>, 256> numbers = [] {
+            std::array<std::array<char, 4>, 256> table{};
+            for (unsigned value = 0; value < 256; ++value) {
+                auto end = std::to_chars(table[value].data() + 1, table[value].data() + 4, value).ptr;
+                table[value][0] = static_cast<char>(end - table[value].data() - 1);
+            }
+            return table;
+        }();
+
+        std::ostream& target;
+        std::size_t bytesPerSample;
+        std::vector<unsigned char> samples;
+        std::vector<char> text;
+        std::size_t lineLength = 0;
+    };
+}
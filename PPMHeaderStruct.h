@@ -1,5 +1,9 @@
 #pragma once
 
+#include <string>
+
+#include "BufferPool.h"
+
 /**
  * @struct PPM_FileHeader
  * @brief PPM Information Struct
@@ -8,7 +12,9 @@
  * <b>width</b> -> image width<br>
  * <b>height</b> -> image height<br>
  * <b>max_color_val</b> -> maximum color value that can be assigned<br>
- * <b>image_data</b> -> the same as pixel data
+ * <b>depth</b> -> samples per pixel [1 - P2/P5, 3 - P3/P6, DEPTH of PAM (P7)]<br>
+ * <b>tuple_type</b> -> TUPLTYPE of PAM (P7) [GRAYSCALE, GRAYSCALE_ALPHA, RGB, RGB_ALPHA], empty for other formats<br>
+ * <b>image_data</b> -> the same as pixel data [pooled buffer, see BufferPool.h]
  * @details
  * This structure is used to store information about .ppm files
  */
@@ -18,7 +24,9 @@ struct PPM_FileHeader{
     int width;
     int height;
     int max_color_val;
-    std::vector<unsigned char> image_data;
+    int depth = 3;
+    std::string tuple_type;
+    buffers::Buffer image_data;
 };
 
 /**
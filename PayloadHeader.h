@@ -0,0 +1,806 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+#include "BufferPool.h"
+#include "Checksum.h"
+#include "Compression.h"
+#include "EmbedPlan.h"
+#include "LSBKernels.h"
+#include "PixelView.h"
+#include "RangeFile.h"
+#include "Stats.h"
+#include "ThreadPool.h"
+
+/**
+ * @struct PayloadHeader
+ * @brief Header embedded in front of every hidden message
+ * @var
+ * <b>version</b> -> layout version of the header and payload<br>
+ * <b>density</b> -> payload bits per carrier byte (LSBs changed in every byte)<br>
+ * <b>flags</b> -> bit flags describing how the payload is stored [payload::flagCompressed, flagScattered, flagChecksum, flagEncrypted]<br>
+ * <b>channels</b> -> color channels holding the payload [plans::red | green | blue | alpha], 0 for red, green and blue<br>
+ * <b>check</b> -> check value of the key a scattered payload is ordered by [scatter::Key::check], 0 otherwise<br>
+ * <b>length</b> -> size of the stored payload (in 'bytes'), compressed size for a compressed payload, without checksum,
+ *                  with the cipher prefix and tag for an encrypted payload<br>
+ * @details Serialized form is 16 bytes:<br>
+ *          &emsp;'S' 'G' | version | density | flags | channels | check (2 bytes, little-endian) | length (8 bytes, little-endian)<br>
+ *          It is always stored in the LSB of the first 128 carrier bytes [samples of 16-bit formats], so it can be
+ *          read before the density is known. Payload starts right after it, at carrier byte 128 [later for some
+ *          channels and 16-bit samples, see EmbedPlan.h]. Payload bits are followed by CRC32C of the stored payload
+ *          [4 bytes, little-endian] when flagChecksum is set, as it is by every embed since the flag was added.
+ */
+
+struct PayloadHeader {
+    uint8_t version = 1;
+    uint8_t density = 1;
+    uint8_t flags = 0;
+    uint8_t channels = 0;
+    uint16_t check = 0;
+    uint64_t length = 0;
+};
+
+namespace payload {
+
+    inline constexpr std::array<unsigned char, 2> magic{'S', 'G'};
+    inline constexpr uint8_t version = 1;
+    inline constexpr std::size_t headerBytes = 16;
+    inline constexpr std::size_t headerCarrierBytes = headerBytes * 8; // 1 LSB per carrier byte
+    static_assert(headerCarrierBytes == plans::headerCarrierBytes);
+
+    /// Payload is compressed with lz [see Compression.h], it is decompressed right after extraction
+    inline constexpr uint8_t flagCompressed = 0x01;
+    /// Payload symbols are scattered over the carrier in the order of a key [Scatter.h], header stays in place
+    inline constexpr uint8_t flagScattered = 0x02;
+    /// Payload is followed by its CRC32C [Checksum.h], verified before the message is handed out
+    inline constexpr uint8_t flagChecksum = 0x04;
+    inline constexpr std::size_t checksumBytes = 4;
+    /// Payload is sealed by ChaCha20-Poly1305 [Cipher.h] after compression, checksum covers the sealed bytes
+    inline constexpr uint8_t flagEncrypted = 0x08;
+
+    /// Number of bytes stored after the header [payload and its checksum]
+    inline auto storedBytes(const PayloadHeader& header) -> uint64_t {
+        return header.length + (header.flags & flagChecksum ? checksumBytes : 0);
+    }
+
+    /// Stored form of the checksum [little-endian]
+    inline auto serializeChecksum(uint32_t checksum) -> std::array<unsigned char, checksumBytes> {
+        std::array<unsigned char, checksumBytes> bytes{};
+        for (std::size_t i = 0; i < checksumBytes; ++i) bytes[i] = static_cast<unsigned char>(checksum >> (8 * i));
+        return bytes;
+    }
+
+    /// Decompressing extracted payload when its header says it is compressed
+    inline auto unpack(const PayloadHeader& header, std::vector<unsigned char>& message) -> bool {
+        return !(header.flags & flagCompressed) || lz::decompress(message);
+    }
+
+    /**
+     * @brief Checking extracted payload against the checksum stored after it
+     * @function verify
+     * @param header -> parsed header<br>
+     * @param message -> extracted stored bytes [storedBytes], the checksum is dropped from its end<br>
+     * @param checksum -> CRC32C of the first header.length bytes, computed while they were extracted<br>
+     * @details Payload embedded without flagChecksum passes as it is
+     */
+
+    inline auto verify(const PayloadHeader& header, std::vector<unsigned char>& message, uint32_t checksum) -> bool {
+        if (!(header.flags & flagChecksum)) return true;
+        if (message.size() != storedBytes(header)) return false;
+        uint32_t stored = 0;
+        for (std::size_t i = 0; i < checksumBytes; ++i) stored |= uint32_t(message[header.length + i]) << (8 * i);
+        message.resize(static_cast<std::size_t>(header.length));
+        return stored == checksum;
+    }
+
+    /**
+     * @brief Converting header into its 16-byte form
+     * @function serialize
+     * @param header -> object of PayloadHeader struct<br>
+     */
+
+    inline auto serialize(const PayloadHeader& header) -> std::array<unsigned char, headerBytes> {
+        std::array<unsigned char, headerBytes> bytes{};
+        bytes[0] = magic[0];
+        bytes[1] = magic[1];
+        bytes[2] = header.version;
+        bytes[3] = header.density;
+        bytes[4] = header.flags;
+        bytes[5] = header.channels;
+        bytes[6] = static_cast<unsigned char>(header.check);
+        bytes[7] = static_cast<unsigned char>(header.check >> 8);
+        for (int i = 0; i < 8; ++i) bytes[8 + i] = static_cast<unsigned char>(header.length >> (8 * i));
+        return bytes;
+    }
+
+    /**
+     * @brief Reading header from its 16-byte form
+     * @function parse
+     * @param bytes -> 16 extracted bytes<br>
+     * @param header -> object of PayloadHeader struct<br>
+     * @details Returns false when magic number, version, density or channels are not valid [image holds no message]
+     */
+
+    inline auto parse(const unsigned char* bytes, PayloadHeader& header) -> bool {
+        if (bytes[0] != magic[0] || bytes[1] != magic[1]) return false;
+        header.version = bytes[2];
+        header.density = bytes[3];
+        header.flags = bytes[4];
+        header.channels = bytes[5];
+        header.check = static_cast<uint16_t>(bytes[6] | bytes[7] << 8);
+        header.length = 0;
+        for (int i = 0; i < 8; ++i) header.length |= uint64_t(bytes[8 + i]) << (8 * i);
+        return header.version == version && header.density >= 1 && header.density <= 8
+            && !(header.channels & ~(plans::allChannels | plans::alpha));
+    }
+
+    /// Header describing payload of the given length embedded with the plan [flagScattered is set by a scattered plan, flagChecksum always]
+    inline auto headerOf(const plans::Plan& plan, uint64_t length, uint8_t flags = 0) -> PayloadHeader {
+        PayloadHeader header;
+        header.density = static_cast<uint8_t>(plan.density());
+        header.flags = flags | flagChecksum | (plan.scattered() ? flagScattered : 0);
+        header.channels = plan.channels() == plans::allChannels ? 0 : plan.channels();
+        header.check = plan.scattered() ? plan.keyCheck() : 0;
+        header.length = length;
+        return header;
+    }
+
+    /// Plan the header was embedded with, false when the format cannot hold it
+    template <typename Format>
+    inline auto planOf(const PayloadHeader& header, plans::Plan& plan) -> bool {
+        return plans::Plan::of<Format>(header.density, header.channels ? header.channels : plans::allChannels, plan);
+    }
+
+    /// Checking whether the key opens the payload [payload is not scattered or the check value of the key matches]
+    inline auto unlocks(const PayloadHeader& header, const scatter::Key& key) -> bool {
+        return !(header.flags & flagScattered) || (!key.empty() && key.check() == header.check);
+    }
+
+    /**
+     * @brief Plan the header was embedded with, scattered by the key when the header says so
+     * @function planOf
+     * @param header -> parsed header<br>
+     * @param key -> key given by the user, it may be empty for a payload that is not scattered<br>
+     * @param carrierBytes -> size of the whole carrier<br>
+     * @param plan -> plan of the header<br>
+     * @details Returns false when the format cannot hold the plan or the key does not open the payload [unlocks]
+     */
+
+    template <typename Format>
+    inline auto planOf(const PayloadHeader& header, const scatter::Key& key, uint64_t carrierBytes, plans::Plan& plan) -> bool {
+        if (!planOf<Format>(header, plan) || !unlocks(header, key)) return false;
+        if (header.flags & flagScattered) plan.scatterBy(key, carrierBytes);
+        return true;
+    }
+
+    /// Number of payload symbols [density bits each, the last one may be partial] of the header, checksum included
+    inline auto symbolsOf(const PayloadHeader& header, const plans::Plan& plan) -> uint64_t {
+        return (storedBytes(header) * 8 + plan.density() - 1) / plan.density();
+    }
+
+    /// Number of message bytes that fit into carrier of the given size with the plan, room for the checksum aside
+    inline auto capacityOf(const plans::Plan& plan, uint64_t carrierBytes) -> uint64_t {
+        const uint64_t capacity = plan.capacity(carrierBytes);
+        return capacity > checksumBytes ? capacity - checksumBytes : 0;
+    }
+
+    /// Number of message bytes that fit into carrier of the given size when every byte is used
+    inline auto capacity(uint64_t carrierBytes, int density) -> uint64_t {
+        return capacityOf(plans::Plan(density), carrierBytes);
+    }
+
+    /// Checking that the payload described by the header fits into carrier of the given size [length comes from the image]
+    inline auto fits(const PayloadHeader& header, const plans::Plan& plan, uint64_t carrierBytes) -> bool {
+        const uint64_t capacity = plan.capacity(carrierBytes);
+        return header.length <= capacity && storedBytes(header) <= capacity;
+    }
+
+    /// Number of carrier bytes holding header and payload
+    inline auto carrierBytesNeeded(const PayloadHeader& header, const plans::Plan& plan) -> uint64_t {
+        return plan.endOf(storedBytes(header) * 8);
+    }
+
+    /**
+     * @brief CRC32C of the message bytes whose last bit lies in a range of carrier bytes
+     * @function checksumOf
+     * @param message -> whole message<br>
+     * @param length -> message bytes covered by the checksum<br>
+     * @param first -> carrier index of the first byte of the range<br>
+     * @param end -> carrier index after the last byte of the range<br>
+     * @param plan -> plan the message is embedded with<br>
+     * @details Consecutive ranges cover consecutive runs of message bytes, so CRCs of bands join into the CRC of
+     *          the message [crc::join]. A byte is covered by the range its last bit is in, so it is complete once
+     *          the range is extracted.
+     */
+
+    inline auto checksumOf(const unsigned char* message, uint64_t length, uint64_t first, uint64_t end,
+                           const plans::Plan& plan) -> crc::Part {
+        first = std::max<uint64_t>(first, plan.payloadStart());
+        if (first >= end) return {};
+        const uint64_t begin = std::min(plan.bitOf(first) / 8, length);
+        const uint64_t last = std::min(plan.bitOf(end) / 8, length);
+        return crc::partOf(message + begin, static_cast<std::size_t>(last - begin));
+    }
+
+    /// CRC32C of the message bytes whose last bit lies in payload bits [firstBit, endBit) [runs of scattered symbols]
+    inline auto checksumOfBits(const unsigned char* message, uint64_t length, uint64_t firstBit, uint64_t endBit) -> crc::Part {
+        const uint64_t begin = std::min(firstBit / 8, length);
+        const uint64_t last = std::min(endBit / 8, length);
+        return crc::partOf(message + begin, static_cast<std::size_t>(last - begin));
+    }
+
+    /**
+     * @brief Embedding header and payload into a span of carrier bytes
+     * @function embedSpan
+     * @param carrier -> first byte of the span<br>
+     * @param first -> index of the first byte of the span within the whole carrier<br>
+     * @param count -> number of bytes in the span<br>
+     * @param header -> serialized header<br>
+     * @param message -> message bytes<br>
+     * @param plan -> carrier bytes and bits holding the payload<br>
+     * @param payloadBits -> number of message bits<br>
+     * @details Span can lie anywhere in the carrier, so it is used both for whole images and for streamed bands.
+     *          Carrier bytes after the end of the payload are left untouched.
+     */
+
+    inline auto embedSpan(unsigned char* carrier, uint64_t first, std::size_t count,
+                          const unsigned char* header, const unsigned char* message,
+                          const plans::Plan& plan, uint64_t payloadBits) -> void {
+        uint64_t last = first + count;
+        if (first < plan.headerEnd()) {
+            auto end = std::min<uint64_t>(last, plan.headerEnd());
+            plans::embedHeader(carrier, first, static_cast<std::size_t>(end - first), header, plan.sampleBytes());
+        }
+        uint64_t begin = std::max<uint64_t>(first, plan.payloadStart());
+        if (begin >= last) return;
+        plan.embed(carrier + (begin - first), begin, static_cast<std::size_t>(last - begin), message,
+                   plan.bitOf(begin), payloadBits);
+    }
+
+    /**
+     * @brief Extracting payload bits from a span of carrier bytes
+     * @function extractSpan
+     * @param carrier -> first byte of the span<br>
+     * @param first -> index of the first byte of the span within the whole carrier<br>
+     * @param count -> number of bytes in the span<br>
+     * @param message -> destination buffer of the whole message<br>
+     * @param header -> parsed header<br>
+     * @param plan -> plan of the header [planOf]<br>
+     * @details Header bytes and bits past the end of the payload are not extracted
+     */
+
+    inline auto extractSpan(const unsigned char* carrier, uint64_t first, std::size_t count,
+                            unsigned char* message, const PayloadHeader& header, const plans::Plan& plan) -> void {
+        uint64_t begin = std::max<uint64_t>(first, plan.payloadStart());
+        uint64_t end = std::min<uint64_t>(first + count, carrierBytesNeeded(header, plan));
+        if (begin >= end) return;
+        plan.extract(carrier + (begin - first), begin, static_cast<std::size_t>(end - begin), message,
+                     plan.bitOf(begin), storedBytes(header) * 8);
+    }
+
+    /// Carrier bytes below which embedding and extraction stay on the calling thread
+    inline constexpr uint64_t parallelThreshold = uint64_t{2} << 20;
+    /// Carrier bytes handled by a single task, multiple of 64 so every band starts on a whole message byte
+    inline constexpr uint64_t parallelBandBytes = uint64_t{1} << 20;
+
+    /**
+     * @brief Splitting a span of carrier bytes into bands processed in parallel
+     * @function forBands
+     * @param first -> index of the first carrier byte<br>
+     * @param count -> number of carrier bytes<br>
+     * @param body -> callable taking [first, count] of one band<br>
+     * @param bandBytes -> carrier bytes of one band [plans::Plan::bandBytes]<br>
+     * @param threshold -> spans smaller than it are handled on the calling thread<br>
+     * @details Bit position of every carrier byte is a pure function of its index, so bands are independent.
+     *          Band borders lie on multiples of bandBytes, where payload bit offset is a multiple of 8
+     *          for every plan, so no two bands write the same message byte. Same goes for runs of payload
+     *          symbols of a scattered plan split into multiples of scatterBandSymbols.
+     */
+
+    template <typename Body>
+    inline auto forBands(uint64_t first, uint64_t count, Body&& body, uint64_t bandBytes = parallelBandBytes,
+                         uint64_t threshold = parallelThreshold) -> void {
+        auto& pool = ThreadPool::shared();
+        if (count < threshold || pool.size() == 1) {
+            body(first, count);
+            return;
+        }
+        const uint64_t end = first + count;
+        const uint64_t firstBand = first / bandBytes;
+        const uint64_t bands = (end + bandBytes - 1) / bandBytes - firstBand;
+        pool.forEach(static_cast<std::size_t>(bands), [&](std::size_t i) {
+            uint64_t begin = std::max(first, (firstBand + i) * bandBytes);
+            uint64_t last = std::min(end, (firstBand + i + 1) * bandBytes);
+            body(begin, last - begin);
+        });
+    }
+
+    /**
+     * @brief Splitting a span into bands like forBands, where every band returns the CRC of its part of the message
+     * @function checksumBands
+     * @details CRCs are kept by band index and joined in order once all bands are done
+     */
+
+    template <typename Body>
+    inline auto checksumBands(uint64_t first, uint64_t count, Body&& body, uint64_t bandBytes = parallelBandBytes,
+                              uint64_t threshold = parallelThreshold) -> crc::Part {
+        const uint64_t firstBand = first / bandBytes;
+        std::vector<crc::Part> parts(static_cast<std::size_t>(std::max<uint64_t>(1, (first + count + bandBytes - 1) / bandBytes - firstBand)));
+        forBands(first, count, [&](uint64_t bandFirst, uint64_t bandCount) {
+            parts[static_cast<std::size_t>(bandFirst / bandBytes - firstBand)] = body(bandFirst, bandCount);
+        }, bandBytes, threshold);
+        return crc::join(parts);
+    }
+
+    /**
+     * @brief Embedding header and payload into a range of carrier bytes, large ranges are split across cores
+     * @function embedRange
+     * @param carrier -> pixels::RowView over the carrier<br>
+     * @param first -> carrier index of the first byte<br>
+     * @param count -> number of carrier bytes<br>
+     * @details Every band walks its rows as contiguous spans [one span when rows are not padded], then checksums
+     *          the message bytes it embedded while they are still in cache. Returns CRC32C of the whole bytes
+     *          of the message embedded by the range [checksumOf].
+     */
+
+    template <typename View>
+    inline auto embedRange(const View& carrier, uint64_t first, uint64_t count,
+                           const unsigned char* header, const unsigned char* message,
+                           const plans::Plan& plan, uint64_t payloadBits) -> crc::Part {
+        return checksumBands(first, count, [&](uint64_t bandFirst, uint64_t bandCount) {
+            carrier.forEachSpan(bandFirst, bandCount, [&](auto* span, uint64_t spanFirst, std::size_t size) {
+                embedSpan(span, spanFirst, size, header, message, plan, payloadBits);
+            });
+            return checksumOf(message, payloadBits / 8, bandFirst, bandFirst + bandCount, plan);
+        }, plan.bandBytes());
+    }
+
+    /// Extracting payload bits from a range of carrier bytes, large ranges are split across cores.
+    /// Returns CRC32C of the whole message bytes extracted by the range [checksum itself excluded].
+    template <typename View>
+    inline auto extractRange(const View& carrier, uint64_t first, uint64_t count,
+                             unsigned char* message, const PayloadHeader& header, const plans::Plan& plan) -> crc::Part {
+        /// Bytes past the end of the payload are not split into bands at all
+        count = std::min<uint64_t>(count, std::max(first, carrierBytesNeeded(header, plan)) - first);
+        return checksumBands(first, count, [&](uint64_t bandFirst, uint64_t bandCount) {
+            carrier.forEachSpan(bandFirst, bandCount, [&](const unsigned char* span, uint64_t spanFirst, std::size_t size) {
+                extractSpan(span, spanFirst, size, message, header, plan);
+            });
+            return checksumOf(message, header.length, bandFirst, bandFirst + bandCount, plan);
+        }, plan.bandBytes());
+    }
+
+    /// Payload symbols of a scattered plan handled by a single task, multiple of 8 so every band starts on a whole message byte
+    inline constexpr uint64_t scatterBandSymbols = uint64_t{1} << 16;
+    /// Payload symbols below which a scattered payload stays on the calling thread [every symbol walks the permutation]
+    inline constexpr uint64_t scatterThreshold = uint64_t{1} << 17;
+
+    /**
+     * @brief Embedding a run of payload symbols of a scattered plan
+     * @function embedSymbols
+     * @param carrier -> pixels::RowView over the whole carrier [bytes are reached by their index]<br>
+     * @param firstSymbol -> index of the first symbol [density bits of the payload]<br>
+     * @param count -> number of symbols<br>
+     * @param payload -> payload bytes<br>
+     * @param bitOffset -> payload bit of the first symbol<br>
+     * @param endBit -> payload bit after the last one to embed, remaining LSBs of a partial last symbol are cleared<br>
+     * @details Symbol i lands in the used byte plan.symbolIndex(i), so the run touches bytes all over the carrier
+     */
+
+    template <typename View>
+    inline auto embedSymbols(const View& carrier, uint64_t firstSymbol, uint64_t count, const unsigned char* payload,
+                             uint64_t bitOffset, uint64_t endBit, const plans::Plan& plan) -> void {
+        const int density = plan.density();
+        const auto low = static_cast<unsigned char>((1u << density) - 1);
+        bits::BitReader reader(payload, static_cast<std::size_t>((endBit + 7) / 8));
+        reader.seek(bitOffset);
+        for (uint64_t symbol = firstSymbol; symbol < firstSymbol + count && bitOffset < endBit; ++symbol, bitOffset += density) {
+            const auto bits = static_cast<int>(std::min<uint64_t>(density, endBit - bitOffset));
+            auto& byte = carrier.at(plan.symbolIndex(symbol));
+            byte = static_cast<unsigned char>((byte & ~low) | (reader.read(bits) << (density - bits)));
+        }
+    }
+
+    /// Extracting a run of payload symbols of a scattered plan [see embedSymbols], bits after endBit are not written
+    template <typename View>
+    inline auto extractSymbols(const View& carrier, uint64_t firstSymbol, uint64_t count, unsigned char* payload,
+                               uint64_t bitOffset, uint64_t endBit, const plans::Plan& plan) -> void {
+        const int density = plan.density();
+        const auto low = static_cast<unsigned char>((1u << density) - 1);
+        bits::BitWriter writer(payload, bitOffset);
+        for (uint64_t symbol = firstSymbol; symbol < firstSymbol + count && bitOffset < endBit; ++symbol, bitOffset += density) {
+            const auto bits = static_cast<int>(std::min<uint64_t>(density, endBit - bitOffset));
+            writer.write((carrier.at(plan.symbolIndex(symbol)) & low) >> (density - bits), bits);
+        }
+        writer.flush();
+    }
+
+    /// Embedding a run of payload symbols of a scattered plan, large runs are split across cores.
+    /// Returns CRC32C of the whole payload bytes of the run [see checksumOfBits].
+    template <typename View>
+    inline auto embedScattered(const View& carrier, uint64_t firstSymbol, uint64_t count, const unsigned char* payload,
+                               uint64_t bitOffset, uint64_t endBit, const plans::Plan& plan) -> crc::Part {
+        return checksumBands(firstSymbol, count, [&](uint64_t bandFirst, uint64_t bandCount) {
+            const uint64_t bandBit = bitOffset + (bandFirst - firstSymbol) * plan.density();
+            embedSymbols(carrier, bandFirst, bandCount, payload, bandBit, endBit, plan);
+            return checksumOfBits(payload, endBit / 8, bandBit, bandBit + bandCount * plan.density());
+        }, scatterBandSymbols, scatterThreshold);
+    }
+
+    /// Extracting a run of payload symbols of a scattered plan, large runs are split across cores.
+    /// Returns CRC32C of the whole bytes among the first length ones extracted by the run.
+    template <typename View>
+    inline auto extractScattered(const View& carrier, uint64_t firstSymbol, uint64_t count, unsigned char* payload,
+                                 uint64_t bitOffset, uint64_t endBit, uint64_t length, const plans::Plan& plan) -> crc::Part {
+        return checksumBands(firstSymbol, count, [&](uint64_t bandFirst, uint64_t bandCount) {
+            const uint64_t bandBit = bitOffset + (bandFirst - firstSymbol) * plan.density();
+            extractSymbols(carrier, bandFirst, bandCount, payload, bandBit, endBit, plan);
+            return checksumOfBits(payload, length, bandBit, bandBit + bandCount * plan.density());
+        }, scatterBandSymbols, scatterThreshold);
+    }
+
+    /**
+     * @brief Embedding bits of a scattered payload that fall into a span of carrier bytes
+     * @function embedSwept
+     * @param carrier -> first byte of the span<br>
+     * @param first -> carrier index of the first byte<br>
+     * @param count -> number of carrier bytes<br>
+     * @param payload -> whole payload<br>
+     * @param payloadBits -> number of payload bits<br>
+     * @param plan -> scattered plan<br>
+     * @details Every used byte finds its symbol by the inverse permutation [plan.symbolOf], bytes holding no symbol
+     *          of the payload are left untouched. Serves carriers walked in stored order [streamed rows], where
+     *          every band may hold any bit of the payload.
+     */
+
+    inline auto embedSwept(unsigned char* carrier, uint64_t first, std::size_t count, const unsigned char* payload,
+                           uint64_t payloadBits, const plans::Plan& plan) -> void {
+        const int density = plan.density();
+        const auto low = static_cast<unsigned char>((1u << density) - 1);
+        const uint64_t symbols = (payloadBits + density - 1) / density;
+        const auto payloadBytes = static_cast<std::size_t>((payloadBits + 7) / 8);
+        std::size_t i = first < plan.payloadStart() ? static_cast<std::size_t>(std::min<uint64_t>(count, plan.payloadStart() - first)) : 0;
+        for (uint64_t slot = plan.slots(first + i); i < count; ++i) {
+            if (!plan.everyByte() && !plan.isUsed(first + i)) continue;
+            const uint64_t symbol = plan.symbolOf(slot++);
+            if (symbol >= symbols) continue;
+            const uint64_t bit = symbol * density;
+            const auto bits = static_cast<int>(std::min<uint64_t>(density, payloadBits - bit));
+            const auto byte = static_cast<std::size_t>(bit / 8);
+            unsigned pair = unsigned(payload[byte]) << 8 | (byte + 1 < payloadBytes ? payload[byte + 1] : 0u);
+            unsigned value = (pair >> (16 - bit % 8 - bits)) & ((1u << bits) - 1);
+            carrier[i] = static_cast<unsigned char>((carrier[i] & ~low) | (value << (density - bits)));
+        }
+    }
+
+    /**
+     * @brief Extracting bits of a scattered payload that fall into a span of carrier bytes
+     * @function extractSwept
+     * @param carrier -> first byte of the span<br>
+     * @param first -> carrier index of the first byte<br>
+     * @param count -> number of carrier bytes<br>
+     * @param message -> destination buffer of the whole message, zeroed before the first span<br>
+     * @param header -> parsed header<br>
+     * @param plan -> scattered plan of the header<br>
+     * @details Counterpart of embedSwept. Bits are ORed into message bytes atomically, so spans of different bands
+     *          may be extracted at once although their symbols share message bytes.
+     */
+
+    inline auto extractSwept(const unsigned char* carrier, uint64_t first, std::size_t count, unsigned char* message,
+                             const PayloadHeader& header, const plans::Plan& plan) -> void {
+        const int density = plan.density();
+        const auto low = static_cast<unsigned char>((1u << density) - 1);
+        const uint64_t payloadBits = storedBytes(header) * 8;
+        const uint64_t symbols = symbolsOf(header, plan);
+        auto store = [&](std::size_t byte, unsigned bits) {
+            if (bits) std::atomic_ref<unsigned char>(message[byte]).fetch_or(static_cast<unsigned char>(bits), std::memory_order_relaxed);
+        };
+        std::size_t i = first < plan.payloadStart() ? static_cast<std::size_t>(std::min<uint64_t>(count, plan.payloadStart() - first)) : 0;
+        for (uint64_t slot = plan.slots(first + i); i < count; ++i) {
+            if (!plan.everyByte() && !plan.isUsed(first + i)) continue;
+            const uint64_t symbol = plan.symbolOf(slot++);
+            if (symbol >= symbols) continue;
+            const uint64_t bit = symbol * density;
+            const auto bits = static_cast<int>(std::min<uint64_t>(density, payloadBits - bit));
+            const auto byte = static_cast<std::size_t>(bit / 8);
+            unsigned pair = ((carrier[i] & low) >> (density - bits)) << (16 - bit % 8 - bits);
+            store(byte, pair >> 8);
+            if (pair & 0xFFu) store(byte + 1, pair & 0xFFu);
+        }
+    }
+
+    /**
+     * @brief Embedding a few payload bits where the plan puts them
+     * @function embedBits
+     * @param carrier -> pixels::RowView over the whole carrier<br>
+     * @param bytes -> bits to embed, MSB-first<br>
+     * @param bitOffset -> payload bit of the first of them<br>
+     * @param count -> number of bits<br>
+     * @param plan -> plan of the payload<br>
+     * @details Bits are set one by one in their symbols [plan.symbolIndex], so a symbol shared with the bits before
+     *          keeps them. Remaining LSBs of a partial last symbol are cleared, as by every embed. Serves the
+     *          checksum stored after a message embedded straight from memory.
+     */
+
+    template <typename View>
+    inline auto embedBits(const View& carrier, const unsigned char* bytes, uint64_t bitOffset, uint64_t count,
+                          const plans::Plan& plan) -> void {
+        const int density = plan.density();
+        const uint64_t end = bitOffset + count;
+        for (uint64_t bit = bitOffset; bit < end || bit % density; ++bit) {
+            auto& byte = carrier.at(plan.symbolIndex(bit / density));
+            const auto mask = static_cast<unsigned char>(1u << (density - 1 - bit % density));
+            const bool set = bit < end && (bytes[(bit - bitOffset) / 8] >> (7 - (bit - bitOffset) % 8)) & 1;
+            byte = static_cast<unsigned char>(set ? byte | mask : byte & ~mask);
+        }
+    }
+
+    /**
+     * @brief Reading header from the first carrier bytes
+     * @function readHeader
+     * @param carrier -> pixels::RowView over at least plans::headerCarrierOf its format carrier bytes<br>
+     * @param header -> object of PayloadHeader struct<br>
+     * @details Header may span several rows of a narrow image
+     */
+
+    template <typename View>
+    inline auto readHeader(const View& carrier, PayloadHeader& header) -> bool {
+        using Format = typename View::format;
+        std::array<unsigned char, headerBytes> bytes{};
+        carrier.forEachSpan(0, plans::headerCarrierOf<Format>, [&](const unsigned char* span, uint64_t first, std::size_t size) {
+            plans::extractHeader(span, first, size, bytes.data(), Format::sampleBytes);
+        });
+        return parse(bytes.data(), header);
+    }
+
+    /**
+     * @brief Embedding header and message into the whole carrier
+     * @function embedMessage
+     * @param carrier -> pixels::RowView over the image(pixel) data<br>
+     * @param message -> message bytes<br>
+     * @param length -> message size (in 'bytes')<br>
+     * @param plan -> carrier bytes and bits holding the payload<br>
+     * @param flags -> flags stored in the header [flagCompressed when message is already compressed]<br>
+     * @details Returns false when message and its checksum do not fit into the carrier. Symbols of a scattered plan
+     *          go to their keyed bytes [embedScattered], the header to the first samples as always. Bands checksum
+     *          the bytes they embed, the joined CRC is embedded after the message [embedBits].
+     */
+
+    template <typename View>
+    inline auto embedMessage(const View& carrier, const unsigned char* message,
+                             uint64_t length, const plans::Plan& plan, uint8_t flags = 0) -> bool {
+        if (length > capacityOf(plan, carrier.carrierBytes())) return false;
+        stats::Timer timer(stats::Phase::Embed);
+        PayloadHeader header = headerOf(plan, length, flags);
+        auto headerBytes = serialize(header);
+        crc::Part checksum;
+        if (plan.scattered()) {
+            embedRange(carrier, 0, std::min(carrier.carrierBytes(), plan.headerEnd()), headerBytes.data(), nullptr, plan, 0);
+            checksum = embedScattered(carrier, 0, (length * 8 + plan.density() - 1) / plan.density(), message, 0, length * 8, plan);
+        }
+        else checksum = embedRange(carrier, 0, plan.endOf(length * 8), headerBytes.data(), message, plan, length * 8);
+        auto trailer = serializeChecksum(checksum.value);
+        embedBits(carrier, trailer.data(), length * 8, checksumBytes * 8, plan);
+        return true;
+    }
+
+    /**
+     * @brief Extracting message described by the embedded header
+     * @function extractMessage
+     * @param carrier -> pixels::RowView over the image(pixel) data<br>
+     * @param header -> object of PayloadHeader struct<br>
+     * @param message -> extracted stored bytes [payload and its checksum, see verify and unpack]<br>
+     * @param checksum -> CRC32C of the payload computed by the bands while they extract it<br>
+     * @param key -> key of a scattered payload [see unlocks]<br>
+     * @details Returns false when carrier holds no header, the key does not open it or the header describes more
+     *          bytes than carrier holds. Plan is read from the header. Only carrier bytes holding the message are
+     *          touched.
+     */
+
+    template <typename View>
+    inline auto extractMessage(const View& carrier, PayloadHeader& header, std::vector<unsigned char>& message,
+                               uint32_t& checksum, const scatter::Key& key = {}) -> bool {
+        const uint64_t carrierBytes = carrier.carrierBytes();
+        plans::Plan plan;
+        if (carrierBytes < plans::headerCarrierOf<typename View::format> || !readHeader(carrier, header)) return false;
+        if (!planOf<typename View::format>(header, key, carrierBytes, plan) || !fits(header, plan, carrierBytes))
+            return false;
+        stats::Timer timer(stats::Phase::Extract);
+        message.assign(static_cast<std::size_t>(storedBytes(header)), 0);
+        checksum = plan.scattered()
+            ? extractScattered(carrier, 0, symbolsOf(header, plan), message.data(), 0, storedBytes(header) * 8, header.length, plan).value
+            : extractRange(carrier, 0, carrierBytesNeeded(header, plan), message.data(), header, plan).value;
+        return true;
+    }
+
+    /**
+     * @brief Reading header straight from the file
+     * @function readHeaderAt
+     * @param file -> opened file(image)<br>
+     * @param dataOffset -> offset of the image(pixel) data in the file (in 'bytes')<br>
+     * @param geometry -> rows of the image<br>
+     * @param header -> object of PayloadHeader struct<br>
+     * @details Only stored bytes holding the header carrier bytes [plans::headerCarrierOf] are read.
+     *          Returns false when they cannot be read or hold no header.
+     */
+
+    template <typename Format>
+    inline auto readHeaderAt(RangeFile& file, uint64_t dataOffset, const pixels::Geometry<Format>& geometry,
+                             PayloadHeader& header) -> bool {
+        if (geometry.carrierBytes() < plans::headerCarrierOf<Format>) return false;
+        uint64_t offset = 0;
+        uint64_t size = 0;
+        uint64_t base = geometry.storedRange(0, plans::headerCarrierOf<Format>, offset, size);
+        auto stored = buffers::acquire(static_cast<std::size_t>(size));
+        return file.readAt(dataOffset + offset, stored.size(), stored.data())
+            && readHeader(pixels::RowView<Format, const unsigned char>(stored.data(), geometry, base), header);
+    }
+
+    /// Size of the pages a short scattered payload is read by, page-aligned in the file
+    inline constexpr uint64_t pageBytes = 4096;
+    /// Payload symbols whose pages are read as one batch [at most that many pages per task]
+    inline constexpr uint64_t pageBatchSymbols = 1024;
+
+    /**
+     * @brief Extracting a scattered payload straight from the file
+     * @function readScattered
+     * @param file -> opened file(image)<br>
+     * @param dataOffset -> offset of the image(pixel) data in the file (in 'bytes')<br>
+     * @param geometry -> rows of the image<br>
+     * @param header -> parsed header<br>
+     * @param plan -> scattered plan of the header<br>
+     * @param message -> destination buffer of the whole stored payload, zeroed<br>
+     * @param checksum -> CRC32C of the payload<br>
+     * @details Short payload [fewer symbols than a quarter of the pages of pixel data] is read batch by batch:
+     *          stored offsets of pageBatchSymbols symbols are computed, their pages are sorted, neighbouring ones
+     *          merged into runs and every run is read with one pread. Longer payload touches most pages anyway,
+     *          so pixel data is read in bands of the plan in stored order and every used byte finds its symbol
+     *          by the inverse permutation [extractSwept]. Batches and bands run in parallel. Every batch checksums
+     *          its bytes, swept payload is complete only after the last band, so it is checksummed then.
+     */
+
+    template <typename Format>
+    inline auto readScattered(RangeFile& file, uint64_t dataOffset, const pixels::Geometry<Format>& geometry,
+                              const PayloadHeader& header, const plans::Plan& plan, std::vector<unsigned char>& message,
+                              uint32_t& checksum) -> bool {
+        const uint64_t symbols = symbolsOf(header, plan);
+        const uint64_t pages = (geometry.storedBytes() + pageBytes - 1) / pageBytes;
+        std::atomic<bool> failed{false};
+        if (symbols * 4 >= pages) {
+            const uint64_t start = plan.payloadStart();
+            forBands(start, geometry.carrierBytes() - start, [&](uint64_t first, uint64_t count) {
+                for (uint64_t end = first + count; first < end && !failed.load();) {
+                    uint64_t size = std::min(plan.bandBytes(), end - first);
+                    uint64_t offset = 0;
+                    uint64_t storedSize = 0;
+                    uint64_t base = geometry.storedRange(first, size, offset, storedSize);
+                    auto chunk = buffers::acquire(static_cast<std::size_t>(storedSize));
+                    if (!file.readAt(dataOffset + offset, chunk.size(), chunk.data())) {
+                        failed.store(true);
+                        return;
+                    }
+                    stats::Timer timer(stats::Phase::Extract);
+                    pixels::RowView<Format, const unsigned char> view(chunk.data(), geometry, base);
+                    view.forEachSpan(first, size, [&](const unsigned char* span, uint64_t spanFirst, std::size_t spanSize) {
+                        extractSwept(span, spanFirst, spanSize, message.data(), header, plan);
+                    });
+                    first += size;
+                }
+            }, plan.bandBytes());
+            checksum = crc::update(0, message.data(), static_cast<std::size_t>(header.length));
+            return !failed.load();
+        }
+
+        const int density = plan.density();
+        const auto low = static_cast<unsigned char>((1u << density) - 1);
+        const uint64_t payloadBits = storedBytes(header) * 8;
+        checksum = checksumBands(0, symbols, [&](uint64_t first, uint64_t count) {
+            const uint64_t firstBit = first * density;
+            const uint64_t endBit = (first + count) * density;
+            std::vector<uint64_t> offsets;
+            std::vector<uint64_t> batchPages;
+            for (uint64_t end = first + count; first < end && !failed.load(); first += pageBatchSymbols) {
+                const auto batch = static_cast<std::size_t>(std::min(pageBatchSymbols, end - first));
+
+                /// Pages holding the symbols of the batch, sorted and without repeats
+                offsets.resize(batch);
+                batchPages.resize(batch);
+                for (std::size_t i = 0; i < batch; ++i) {
+                    offsets[i] = dataOffset + geometry.storedOffset(plan.symbolIndex(first + i));
+                    batchPages[i] = offsets[i] / pageBytes;
+                }
+                std::sort(batchPages.begin(), batchPages.end());
+                batchPages.erase(std::unique(batchPages.begin(), batchPages.end()), batchPages.end());
+
+                /// Runs of neighbouring pages are read at once, page j of the batch lands at j * pageBytes
+                auto chunk = buffers::acquire(static_cast<std::size_t>(batchPages.size() * pageBytes));
+                for (std::size_t run = 0; run < batchPages.size();) {
+                    std::size_t last = run + 1;
+                    while (last < batchPages.size() && batchPages[last] == batchPages[last - 1] + 1) ++last;
+                    uint64_t offset = batchPages[run] * pageBytes;
+                    uint64_t size = std::min<uint64_t>(batchPages[last - 1] * pageBytes + pageBytes, file.size()) - offset;
+                    if (!file.readAt(offset, static_cast<std::size_t>(size), chunk.data() + run * pageBytes)) {
+                        failed.store(true);
+                        return crc::Part{};
+                    }
+                    run = last;
+                }
+
+                stats::Timer timer(stats::Phase::Extract);
+                uint64_t bit = first * density;
+                bits::BitWriter writer(message.data(), bit);
+                for (std::size_t i = 0; i < batch && bit < payloadBits; ++i, bit += density) {
+                    auto page = std::lower_bound(batchPages.begin(), batchPages.end(), offsets[i] / pageBytes) - batchPages.begin();
+                    unsigned char byte = chunk.data()[page * pageBytes + offsets[i] % pageBytes];
+                    const auto bits = static_cast<int>(std::min<uint64_t>(density, payloadBits - bit));
+                    writer.write((byte & low) >> (density - bits), bits);
+                }
+                writer.flush();
+            }
+            return checksumOfBits(message.data(), header.length, firstBit, endBit);
+        }, pageBatchSymbols, 2 * pageBatchSymbols).value;
+        return !failed.load();
+    }
+
+    /**
+     * @brief Extracting message straight from the file, reading only carrier bytes that hold it
+     * @function readMessage
+     * @param file -> opened file(image)<br>
+     * @param dataOffset -> offset of the image(pixel) data in the file (in 'bytes')<br>
+     * @param geometry -> rows of the image<br>
+     * @param header -> object of PayloadHeader struct<br>
+     * @param message -> extracted stored bytes [payload and its checksum, see verify and unpack]<br>
+     * @param checksum -> CRC32C of the payload, every band checksums the bytes it has just extracted<br>
+     * @param key -> key of a scattered payload [see unlocks]<br>
+     * @details Header carrier bytes are read first, then the exact byte range given by the payload length
+     *          is read band by band [one band of the plan each, whole rows when rows are padded], so a short message
+     *          costs a few KB of I/O for any image size. Bands of a long message are read and extracted in
+     *          parallel, once one of them fails the remaining ones are skipped. Scattered payload is read by
+     *          readScattered.
+     *          Returns false when carrier holds no header, the key does not open it or the file is shorter than
+     *          the header describes.
+     */
+
+    template <typename Format>
+    inline auto readMessage(RangeFile& file, uint64_t dataOffset, const pixels::Geometry<Format>& geometry,
+                            PayloadHeader& header, std::vector<unsigned char>& message, uint32_t& checksum,
+                            const scatter::Key& key = {}) -> bool {
+        plans::Plan plan;
+        if (!readHeaderAt(file, dataOffset, geometry, header)) return false;
+        if (!planOf<Format>(header, key, geometry.carrierBytes(), plan) || !fits(header, plan, geometry.carrierBytes()))
+            return false;
+
+        message.assign(static_cast<std::size_t>(storedBytes(header)), 0);
+        if (plan.scattered()) return readScattered(file, dataOffset, geometry, header, plan, message, checksum);
+        const uint64_t start = plan.payloadStart();
+        const uint64_t needed = carrierBytesNeeded(header, plan);
+        std::atomic<bool> failed{false};
+        checksum = checksumBands(start, std::max(needed, start) - start, [&](uint64_t first, uint64_t count) {
+            crc::Part part;
+            for (uint64_t end = first + count; first < end && !failed.load();) {
+                uint64_t size = std::min(plan.bandBytes(), end - first);
+                uint64_t offset = 0;
+                uint64_t storedSize = 0;
+                uint64_t base = geometry.storedRange(first, size, offset, storedSize);
+                auto chunk = buffers::acquire(static_cast<std::size_t>(storedSize));
+                if (!file.readAt(dataOffset + offset, chunk.size(), chunk.data())) {
+                    failed.store(true);
+                    return part;
+                }
+                stats::Timer timer(stats::Phase::Extract);
+                pixels::RowView<Format, const unsigned char> view(chunk.data(), geometry, base);
+                view.forEachSpan(first, size, [&](const unsigned char* span, uint64_t spanFirst, std::size_t spanSize) {
+                    extractSpan(span, spanFirst, spanSize, message.data(), header, plan);
+                });
+                part = crc::join(part, checksumOf(message.data(), header.length, first, first + size, plan));
+                first += size;
+            }
+            return part;
+        }, plan.bandBytes()).value;
+        return !failed.load();
+    }
+}
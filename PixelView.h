@@ -0,0 +1,215 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+/**
+ * @file PixelView.h
+ * @brief Pixel data seen as rows of carrier bytes in memory order
+ * @details Carrier is the sequence of pixel bytes in the order they are stored, padding at the end of a row is
+ *          not part of it. Carrier index of a byte is therefore row * rowBytes + column, its stored offset is
+ *          row * stride + column. Loops never compute a pixel index, they are handed contiguous spans of a row
+ *          [or of the whole image when rows follow each other without padding].
+ */
+
+namespace pixels {
+
+    /// Order of color channels inside of a pixel
+    enum class Order : uint8_t { BGR, RGB };
+
+    /**
+     * @struct Layout
+     * @brief Compile-time description of how a format stores its pixels
+     * @var
+     * <b>order</b> -> order of color channels<br>
+     * <b>channelCount</b> -> number of samples in a pixel [1 gray, 2 gray and alpha, 3 color, 4 color and alpha]<br>
+     * <b>sampleBytes</b> -> size of one channel sample (in 'bytes'), wide samples are big-endian<br>
+     * <b>bytesPerPixel</b> -> size of one pixel (in 'bytes')<br>
+     * <b>alignment</b> -> stored rows are padded to a multiple of it (in 'bytes'), 1 when rows are not padded<br>
+     * <b>bottomUp</b> -> first stored row is the bottom row of the image<br>
+     * <b>red</b>, <b>green</b>, <b>blue</b>, <b>alpha</b> -> index of the byte holding the LSBs of the channel
+     * inside of a pixel [last byte of a big-endian sample], every color channel of a gray pixel is its gray sample
+     */
+
+    template <Order channelOrder, std::size_t channels, std::size_t bytesPerSample, std::size_t rowAlignment,
+              bool storedBottomUp>
+    struct Layout {
+        static constexpr Order order = channelOrder;
+        static constexpr std::size_t channelCount = channels;
+        static constexpr std::size_t sampleBytes = bytesPerSample;
+        static constexpr std::size_t bytesPerPixel = channels * bytesPerSample;
+        static constexpr std::size_t alignment = rowAlignment;
+        static constexpr bool bottomUp = storedBottomUp;
+        static constexpr bool hasAlpha = channels == 2 || channels == 4;
+        static constexpr bool gray = channels < 3;
+        static constexpr std::size_t red = (gray || order == Order::RGB ? 0 : 2) * sampleBytes + sampleBytes - 1;
+        static constexpr std::size_t green = (gray ? 0 : 1) * sampleBytes + sampleBytes - 1;
+        static constexpr std::size_t blue = (gray || order == Order::BGR ? 0 : 2) * sampleBytes + sampleBytes - 1;
+        static constexpr std::size_t alpha = (channels - 1) * sampleBytes + sampleBytes - 1;
+    };
+
+    /// 24-bit BMP [B, G, R, rows padded to 4 bytes, bottom row first]
+    using BMP24 = Layout<Order::BGR, 3, 1, 4, true>;
+    /// 32-bit BMP [B, G, R, A, rows always whole 4 bytes, bottom row first]
+    using BMP32 = Layout<Order::BGR, 4, 1, 4, true>;
+    /// Binary 8-bit PPM [R, G, B, rows not padded, top row first]
+    using PPM24 = Layout<Order::RGB, 3, 1, 1, false>;
+    /// Binary 16-bit PPM [R, G, B as big-endian 2-byte samples, rows not padded, top row first]
+    using PPM48 = Layout<Order::RGB, 3, 2, 1, false>;
+    /// Binary PGM and gray PAM [one sample of 8 or 16 bits]
+    using PGM8 = Layout<Order::RGB, 1, 1, 1, false>;
+    using PGM16 = Layout<Order::RGB, 1, 2, 1, false>;
+    /// PAM GRAYSCALE_ALPHA [gray, alpha of 8 or 16 bits]
+    using PAMGA16 = Layout<Order::RGB, 2, 1, 1, false>;
+    using PAMGA32 = Layout<Order::RGB, 2, 2, 1, false>;
+    /// PAM RGB_ALPHA [R, G, B, A of 8 or 16 bits]
+    using PAM32 = Layout<Order::RGB, 4, 1, 1, false>;
+    using PAM64 = Layout<Order::RGB, 4, 2, 1, false>;
+    /// Plain run of carrier bytes [buffers without image rows, benchmarks]
+    using Bytes = Layout<Order::RGB, 1, 1, 1, false>;
+
+    /**
+     * @class Geometry
+     * @brief Size of rows and of the whole pixel data of one image
+     * @var
+     * <b>rowBytes</b> -> carrier bytes of one row<br>
+     * <b>stride</b> -> stored bytes of one row [rowBytes and padding]<br>
+     * <b>rows</b> -> number of rows
+     */
+
+    template <typename Format>
+    class Geometry {
+    public:
+        using format = Format;
+
+        constexpr Geometry() = default;
+
+        constexpr Geometry(uint64_t width, uint64_t rows)
+            : rowBytes(width * Format::bytesPerPixel),
+              stride((rowBytes + Format::alignment - 1) / Format::alignment * Format::alignment), rows(rows) {}
+
+        /// Rows follow each other without padding [known at compile time for formats that never pad]
+        constexpr auto contiguous() const -> bool {
+            if constexpr (Format::alignment == 1) return true;
+            return stride == rowBytes;
+        }
+
+        constexpr auto carrierBytes() const -> uint64_t { return rowBytes * rows; }
+        constexpr auto storedBytes() const -> uint64_t { return stride * rows; }
+        constexpr auto rowSize() const -> uint64_t { return rowBytes; }
+        constexpr auto rowStride() const -> uint64_t { return stride; }
+        constexpr auto rowCount() const -> uint64_t { return rows; }
+
+        /// Stored offset of the carrier byte with the given index
+        constexpr auto storedOffset(uint64_t index) const -> uint64_t {
+            if (contiguous()) return index;
+            return index / rowBytes * stride + index % rowBytes;
+        }
+
+        /**
+         * @brief Finding stored bytes that hold a range of carrier bytes
+         * @function storedRange
+         * @param first -> carrier index of the first byte<br>
+         * @param count -> number of carrier bytes, at least 1<br>
+         * @param offset -> stored offset of the range (in 'bytes')<br>
+         * @param size -> stored size of the range (in 'bytes')<br>
+         * @details Returns carrier index of the first stored byte of the range, which is 'first' for contiguous
+         *          rows and the start of its row otherwise [a RowView over the range starts there]
+         */
+
+        constexpr auto storedRange(uint64_t first, uint64_t count, uint64_t& offset, uint64_t& size) const -> uint64_t {
+            if (contiguous()) {
+                offset = first;
+                size = count;
+                return first;
+            }
+            uint64_t firstRow = first / rowBytes;
+            uint64_t lastRow = (first + count - 1) / rowBytes;
+            offset = firstRow * stride;
+            size = (lastRow - firstRow) * stride + rowBytes;
+            return firstRow * rowBytes;
+        }
+
+    private:
+        uint64_t rowBytes = 0;
+        uint64_t stride = 0;
+        uint64_t rows = 0;
+    };
+
+    /**
+     * @class RowView
+     * @brief Stored pixel bytes of an image [or of a band of its rows] walked as contiguous spans
+     * @var
+     * <b>data</b> -> first stored byte of the view<br>
+     * <b>geometry</b> -> rows of the whole image<br>
+     * <b>base</b> -> carrier index of the first stored byte [start of a row unless rows are contiguous]
+     * @details Same view serves a whole image in memory, a band of streamed rows and a range read from a file,
+     *          callers always use carrier indices of the whole image.
+     */
+
+    template <typename Format, typename Byte = unsigned char>
+    class RowView {
+    public:
+        using format = Format;
+
+        RowView(Byte* data, Geometry<Format> geometry, uint64_t base = 0) : data(data), geometry(geometry), base(base) {}
+
+        auto carrierBytes() const -> uint64_t { return geometry.carrierBytes(); }
+
+        /// Carrier bytes of the row with the given index in memory order
+        auto row(uint64_t index) const -> std::span<Byte> {
+            return {data + (index - base / geometry.rowSize()) * geometry.rowStride(),
+                    static_cast<std::size_t>(geometry.rowSize())};
+        }
+
+        /// Carrier byte with the given index [random access, the byte has to lie inside of the view]
+        auto at(uint64_t index) const -> Byte& {
+            const uint64_t local = index - base;
+            if (geometry.contiguous()) return data[local];
+            return data[local / geometry.rowSize() * geometry.rowStride() + local % geometry.rowSize()];
+        }
+
+        /**
+         * @brief Walking a range of carrier bytes as contiguous spans
+         * @function forEachSpan
+         * @param first -> carrier index of the first byte<br>
+         * @param count -> number of carrier bytes<br>
+         * @param body -> callable taking (first byte of the span, carrier index of it, size of the span)<br>
+         * @details Whole range is a single span when rows are contiguous, otherwise one span per row it touches
+         */
+
+        template <typename Body>
+        auto forEachSpan(uint64_t first, uint64_t count, Body&& body) const -> void {
+            if (count == 0) return;
+            uint64_t local = first - base;
+            if (geometry.contiguous()) {
+                body(data + local, first, static_cast<std::size_t>(count));
+                return;
+            }
+            const uint64_t rowBytes = geometry.rowSize();
+            Byte* position = data + local / rowBytes * geometry.rowStride() + local % rowBytes;
+            uint64_t column = local % rowBytes;
+            while (count > 0) {
+                auto size = std::min(rowBytes - column, count);
+                body(position, first, static_cast<std::size_t>(size));
+                position += geometry.rowStride() - column;
+                first += size;
+                count -= size;
+                column = 0;
+            }
+        }
+
+    private:
+        Byte* data;
+        Geometry<Format> geometry;
+        uint64_t base;
+    };
+
+    /// View over a plain run of carrier bytes
+    template <typename Byte>
+    inline auto contiguous(Byte* data, uint64_t size) -> RowView<Bytes, Byte> {
+        return {data, Geometry<Bytes>(size, 1)};
+    }
+}
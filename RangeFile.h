@@ -0,0 +1,134 @@
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <utility>
+
+#include "Stats.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#define STEG_POSIX 1
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/**
+ * @class RangeFile
+ * @brief Read-only file(image) that is read in explicit byte ranges
+ * @var
+ * <b>descriptor</b> -> file descriptor [POSIX]<br>
+ * <b>stream</b> -> file stream on platforms without pread<br>
+ * <b>length</b> -> file size (in 'bytes')
+ * @details Every readAt() is a single pread of exactly the requested bytes, nothing is mapped and there is no
+ *          read-ahead, so decoding a short message costs a few pages of I/O whatever the size of the image.
+ * @attention Object owns the descriptor, it can be moved but not copied
+ */
+
+class RangeFile {
+public:
+    RangeFile() = default;
+
+    explicit RangeFile(const std::string& path) { open(path); }
+
+    RangeFile(RangeFile&& other) noexcept { *this = std::move(other); }
+
+    auto operator=(RangeFile&& other) noexcept -> RangeFile& {
+        if (this != &other) {
+            close();
+            descriptor = other.descriptor;
+            stream = std::move(other.stream);
+            length = other.length;
+            other.descriptor = -1;
+            other.length = 0;
+        }
+        return *this;
+    }
+
+    RangeFile(const RangeFile&) = delete;
+    auto operator=(const RangeFile&) -> RangeFile& = delete;
+
+    ~RangeFile() { close(); }
+
+    /**
+     * @brief Opening file for reading
+     * @function open
+     * @param path -> path of the file<br>
+     */
+
+    auto open(const std::string& path) -> bool {
+        stats::Timer timer(stats::Phase::Open);
+        close();
+#if defined(STEG_POSIX)
+        descriptor = ::open(path.c_str(), O_RDONLY);
+        if (descriptor < 0) return false;
+        struct stat status{};
+        if (::fstat(descriptor, &status) != 0 || status.st_size <= 0) {
+            close();
+            return false;
+        }
+        length = static_cast<uint64_t>(status.st_size);
+#else
+        stream.open(path, std::ios::binary | std::ios::ate);
+        if (!stream) return false;
+        length = static_cast<uint64_t>(stream.tellg());
+        if (length == 0) {
+            close();
+            return false;
+        }
+        descriptor = 0;
+#endif
+        return true;
+    }
+
+    /**
+     * @brief Reading bytes from the given position of the file
+     * @function readAt
+     * @param offset -> offset of the first byte (in 'bytes')<br>
+     * @param size -> number of bytes to read<br>
+     * @param destination -> buffer of at least 'size' bytes<br>
+     * @details Returns false when the range does not lie inside of the file
+     */
+
+    auto readAt(uint64_t offset, std::size_t size, void* destination) -> bool {
+        if (!isOpen() || offset > length || size > length - offset) return false;
+        stats::Timer timer(stats::Phase::Read);
+        stats::addRead(size);
+        auto* out = static_cast<char*>(destination);
+#if defined(STEG_POSIX)
+        /// pread may return fewer bytes than requested [signals, large ranges]
+        while (size > 0) {
+            ssize_t done = ::pread(descriptor, out, size, static_cast<off_t>(offset));
+            if (done < 0 && errno == EINTR) continue;
+            if (done <= 0) return false;
+            out += done;
+            offset += static_cast<uint64_t>(done);
+            size -= static_cast<std::size_t>(done);
+        }
+        return true;
+#else
+        stream.clear();
+        stream.seekg(static_cast<std::streamoff>(offset), std::ios::beg);
+        return static_cast<bool>(stream.read(out, static_cast<std::streamsize>(size)));
+#endif
+    }
+
+    auto close() -> void {
+#if defined(STEG_POSIX)
+        if (descriptor >= 0) ::close(descriptor);
+#endif
+        if (stream.is_open()) stream.close();
+        descriptor = -1;
+        length = 0;
+    }
+
+    auto isOpen() const -> bool { return descriptor >= 0; }
+    auto size() const -> uint64_t { return length; }
+
+private:
+    int descriptor = -1;
+    std::ifstream stream;
+    uint64_t length = 0;
+};
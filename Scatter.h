@@ -0,0 +1,144 @@
+#pragma once
+
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <string_view>
+#include <utility>
+
+/**
+ * @file Scatter.h
+ * @brief Keyed order of payload symbols over the whole carrier
+ * @details Without a key symbol i of the payload [density bits] goes to the i-th used carrier byte, so the changes
+ *          form one strip at the start of the pixel data. With a key it goes to the used byte permutation(i) of
+ *          a keyed bijection over every used byte of the carrier. The bijection is a Feistel network on the
+ *          smallest number of bits covering the carrier, values past its end are walked through the network
+ *          again [cycle walking] until they fall inside. Nothing is tabulated, so memory does not depend
+ *          on the size of the image, and both directions cost a few rounds of a 64-bit mixer:<br>
+ *              &emsp;&emsp;- forward -> where a symbol is [in-memory carriers, short messages read page by page]<br>
+ *              &emsp;&emsp;- inverse -> which symbol a byte holds [carriers walked in stored order, streams]
+ */
+
+namespace scatter {
+
+    /// Finalizer of splitmix64, a bijective mixer of 64-bit words
+    constexpr auto mix(uint64_t word) -> uint64_t {
+        word += 0x9E3779B97F4A7C15ull;
+        word = (word ^ (word >> 30)) * 0xBF58476D1CE4E5B9ull;
+        word = (word ^ (word >> 27)) * 0x94D049BB133111EBull;
+        return word ^ (word >> 31);
+    }
+
+    /**
+     * @class Key
+     * @brief Seed of the permutation derived from the text given by the user
+     * @var
+     * <b>seed</b> -> FNV-1a hash of the text passed through the mixer<br>
+     * <b>present</b> -> key was given [empty text means no key]
+     * @details check() is stored in PayloadHeader of a scattered payload, so a wrong key is told apart from a damaged
+     *          message. It takes 16 bits of another mix of the seed, the seed itself is never stored.
+     */
+
+    class Key {
+    public:
+        Key() = default;
+
+        explicit Key(std::string_view text) : present(!text.empty()) {
+            uint64_t hash = 0xCBF29CE484222325ull;
+            for (char letter : text) hash = (hash ^ static_cast<unsigned char>(letter)) * 0x100000001B3ull;
+            seed = mix(hash);
+        }
+
+        auto empty() const -> bool { return !present; }
+        auto value() const -> uint64_t { return seed; }
+        auto check() const -> uint16_t { return static_cast<uint16_t>(mix(seed ^ 0x5CA77E12C4EC4ull) >> 48); }
+
+    private:
+        uint64_t seed = 0;
+        bool present = false;
+    };
+
+    /**
+     * @class Permutation
+     * @brief Keyed bijection of [0, domain) computed on the fly
+     * @var
+     * <b>domain</b> -> number of permuted values [used carrier bytes after the header]<br>
+     * <b>high</b>, <b>low</b> -> bits of the two halves of the Feistel block, together they cover domain - 1<br>
+     * <b>keys</b> -> round keys drawn from the seed of the key
+     * @details Halves differ by one bit at most [unbalanced Feistel: a round XORs the mixed right half into the left
+     *          one and swaps them, an even number of rounds brings their widths back]. Block is the bit width of
+     *          domain - 1, so it covers less than 2 * domain values and cycle walking takes fewer than 2 passes
+     *          on average. Domain of one value or none is left in order.
+     */
+
+    class Permutation {
+    public:
+        static constexpr int rounds = 4;
+
+        Permutation() = default;
+
+        Permutation(const Key& key, uint64_t domain) : domain(domain) {
+            const int width = domain > 1 ? std::bit_width(domain - 1) : 0;
+            low = width / 2;
+            high = width - low;
+            uint64_t state = key.value();
+            for (auto& round : keys) round = mix(state += 0x9E3779B97F4A7C15ull);
+        }
+
+        auto size() const -> uint64_t { return domain; }
+
+        /// Position of the value [value below size()]
+        auto forward(uint64_t value) const -> uint64_t {
+            if (domain < 2) return value;
+            do value = encrypt(value);
+            while (value >= domain);
+            return value;
+        }
+
+        /// Value placed at the position [position below size()]
+        auto inverse(uint64_t position) const -> uint64_t {
+            if (domain < 2) return position;
+            do position = decrypt(position);
+            while (position >= domain);
+            return position;
+        }
+
+    private:
+        static constexpr auto maskOf(int bits) -> uint64_t { return (uint64_t{1} << bits) - 1; }
+
+        auto round(uint64_t word, int index, int bits) const -> uint64_t { return mix(word ^ keys[index]) & maskOf(bits); }
+
+        auto encrypt(uint64_t block) const -> uint64_t {
+            int leftBits = high;
+            int rightBits = low;
+            uint64_t left = block >> rightBits;
+            uint64_t right = block & maskOf(rightBits);
+            for (int index = 0; index < rounds; ++index) {
+                uint64_t next = left ^ round(right, index, leftBits);
+                left = right;
+                right = next;
+                std::swap(leftBits, rightBits);
+            }
+            return left << rightBits | right;
+        }
+
+        auto decrypt(uint64_t block) const -> uint64_t {
+            int leftBits = high;
+            int rightBits = low;
+            uint64_t left = block >> rightBits;
+            uint64_t right = block & maskOf(rightBits);
+            for (int index = rounds - 1; index >= 0; --index) {
+                uint64_t previous = right ^ round(left, index, rightBits);
+                right = left;
+                left = previous;
+                std::swap(leftBits, rightBits);
+            }
+            return left << rightBits | right;
+        }
+
+        uint64_t domain = 0;
+        int high = 0;
+        int low = 0;
+        std::array<uint64_t, rounds> keys{};
+    };
+}
@@ -0,0 +1,222 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <string>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define STEG_POSIX 1
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+namespace stats {
+
+    /// Phases of a command, every one is timed separately
+    enum class Phase { Open, Header, Read, Embed, Extract, Write, Fsync };
+
+    inline constexpr std::array<const char*, 7> phaseNames{"open", "header", "read", "embed", "extract", "write", "fsync"};
+
+    /**
+     * @struct Counters
+     * @brief Process-wide measurements of the --stats flag
+     * @var
+     * <b>enabled</b> -> set by --stats, nothing is measured otherwise<br>
+     * <b>nanoseconds</b> -> time spent in every phase<br>
+     * <b>bytesRead</b> -> bytes read from files and streams<br>
+     * <b>bytesWritten</b> -> bytes written to files and streams from user space<br>
+     * <b>bytesCopied</b> -> bytes of written files reflinked or copied by the kernel [FileCopy.h]<br>
+     * <b>carrierBytes</b> -> carrier bytes passed to embed/extract kernels<br>
+     * <b>pixels</b> -> pixels whose bytes hold payload bits, counted by spans of the plan of the format [EmbedPlan.h, keyed payloads are not counted]<br>
+     * <b>command</b> -> flag of the command being measured<br>
+     * <b>start</b> -> start of the command
+     * @details Counters are atomic, so batch jobs and parallel bands add to them without locks. Time of phases
+     *          running on several threads at once is summed, so phases may add up to more than the wall time.
+     */
+
+    struct Counters {
+        std::atomic<bool> enabled{false};
+        std::array<std::atomic<uint64_t>, phaseNames.size()> nanoseconds{};
+        std::atomic<uint64_t> bytesRead{0};
+        std::atomic<uint64_t> bytesWritten{0};
+        std::atomic<uint64_t> bytesCopied{0};
+        std::atomic<uint64_t> carrierBytes{0};
+        std::atomic<uint64_t> pixels{0};
+        std::string command;
+        std::chrono::steady_clock::time_point start;
+    };
+
+    inline auto counters() -> Counters& {
+        static Counters instance;
+        return instance;
+    }
+
+    inline auto enabled() -> bool { return counters().enabled.load(std::memory_order_relaxed); }
+
+    inline auto addRead(uint64_t bytes) -> void {
+        if (enabled()) counters().bytesRead.fetch_add(bytes, std::memory_order_relaxed);
+    }
+
+    inline auto addWritten(uint64_t bytes) -> void {
+        if (enabled()) counters().bytesWritten.fetch_add(bytes, std::memory_order_relaxed);
+    }
+
+    inline auto addCopied(uint64_t bytes) -> void {
+        if (enabled()) counters().bytesCopied.fetch_add(bytes, std::memory_order_relaxed);
+    }
+
+    inline auto addCarrier(uint64_t bytes) -> void {
+        if (enabled()) counters().carrierBytes.fetch_add(bytes, std::memory_order_relaxed);
+    }
+
+    inline auto addPixels(uint64_t count) -> void {
+        if (enabled()) counters().pixels.fetch_add(count, std::memory_order_relaxed);
+    }
+
+    /// Adding time measured apart from a Timer to the phase [e.g. from submission to completion of an io_uring fsync]
+    inline auto addTime(Phase phase, std::chrono::steady_clock::duration elapsed) -> void {
+        if (!enabled()) return;
+        counters().nanoseconds[static_cast<std::size_t>(phase)].fetch_add(
+            static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()),
+            std::memory_order_relaxed);
+    }
+
+    /**
+     * @class Timer
+     * @brief Adding time from its construction to its destruction to the phase
+     * @details Does not read the clock at all when --stats is not given
+     */
+
+    class Timer {
+    public:
+        explicit Timer(Phase phase) : phase(phase), active(enabled()) {
+            if (active) start = std::chrono::steady_clock::now();
+        }
+
+        Timer(const Timer&) = delete;
+        auto operator=(const Timer&) -> Timer& = delete;
+
+        ~Timer() { stop(); }
+
+        /// Ending the phase before the end of the scope
+        auto stop() -> void {
+            if (!active) return;
+            active = false;
+            addTime(phase, std::chrono::steady_clock::now() - start);
+        }
+
+    private:
+        Phase phase;
+        bool active;
+        std::chrono::steady_clock::time_point start;
+    };
+
+    /// Set by --fsync: written files are flushed to the device before the command reports success [--stats only times it]
+    inline auto syncRequested() -> std::atomic<bool>& {
+        static std::atomic<bool> requested{false};
+        return requested;
+    }
+
+    /**
+     * @brief Flushing written file to the device
+     * @function syncFile
+     * @param path -> path of the written file<br>
+     * @details Done only with --fsync, so measuring a command never changes what it does. With --stats its time
+     *          is the fsync phase, apart from the write phase that ends in the page cache.
+     */
+
+    inline auto syncFile(const std::string& path) -> void {
+        if (!syncRequested().load(std::memory_order_relaxed)) return;
+        Timer timer(Phase::Fsync);
+#if defined(STEG_POSIX)
+        int descriptor = ::open(path.c_str(), O_RDONLY);
+        if (descriptor < 0) return;
+        ::fsync(descriptor);
+        ::close(descriptor);
+#else
+        (void)path;
+#endif
+    }
+
+    /// Peak resident set size of the process (in 'kilobytes')
+    inline auto peakRss() -> uint64_t {
+#if defined(STEG_POSIX)
+        struct rusage usage{};
+        if (::getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#if defined(__APPLE__)
+        return static_cast<uint64_t>(usage.ru_maxrss) / 1024; // bytes on macOS
+#else
+        return static_cast<uint64_t>(usage.ru_maxrss);
+#endif
+#else
+        return 0;
+#endif
+    }
+
+    /**
+     * @brief Writing all measurements as one JSON line on std::cerr
+     * @function emit
+     * @details Times are in milliseconds, e.g.<br>
+     *          {"command":"-e","wall_ms":12.3,"phases_ms":{"open":0.1,...},"bytes_read":...,"bytes_written":...,
+     *          "bytes_copied":...,"carrier_bytes":...,"pixels":...,"peak_rss_kb":...}
+     */
+
+    inline auto emit() -> void {
+        auto& all = counters();
+        auto milliseconds = [](uint64_t nanoseconds) { return static_cast<double>(nanoseconds) / 1e6; };
+        auto wall = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - all.start);
+
+        std::string json = "{\"command\":\"" + all.command + "\"";
+        char number[64];
+        std::snprintf(number, sizeof(number), ",\"wall_ms\":%.3f", milliseconds(static_cast<uint64_t>(wall.count())));
+        json += number;
+        json += ",\"phases_ms\":{";
+        for (std::size_t i = 0; i < phaseNames.size(); ++i) {
+            std::snprintf(number, sizeof(number), "%s\"%s\":%.3f", i ? "," : "", phaseNames[i],
+                          milliseconds(all.nanoseconds[i].load()));
+            json += number;
+        }
+        json += "},\"bytes_read\":" + std::to_string(all.bytesRead.load())
+              + ",\"bytes_written\":" + std::to_string(all.bytesWritten.load())
+              + ",\"bytes_copied\":" + std::to_string(all.bytesCopied.load())
+              + ",\"carrier_bytes\":" + std::to_string(all.carrierBytes.load())
+              + ",\"pixels\":" + std::to_string(all.pixels.load())
+              + ",\"peak_rss_kb\":" + std::to_string(peakRss()) + "}";
+        std::cerr << json << std::endl;
+    }
+
+    /**
+     * @class Session
+     * @brief Enabling measurements for the whole command when --stats is among the arguments
+     * @details Created at the start of main, JSON line is written when it is destroyed [main returns]
+     */
+
+    class Session {
+    public:
+        Session(int argc, char* argv[]) {
+            bool requested = false;
+            std::string command;
+            for (int i = 1; i < argc; ++i) {
+                std::string arg = argv[i];
+                if (arg == "--stats") requested = true;
+                else if (command.empty() && arg.size() > 1 && arg[0] == '-') command = arg;
+            }
+            if (!requested) return;
+            counters().command = command;
+            counters().start = std::chrono::steady_clock::now();
+            counters().enabled.store(true);
+        }
+
+        Session(const Session&) = delete;
+        auto operator=(const Session&) -> Session& = delete;
+
+        ~Session() {
+            if (enabled()) emit();
+        }
+    };
+}
@@ -0,0 +1,650 @@
+#include "Steg.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <fstream>
+#include <streambuf>
+
+#include "Cipher.h"
+#include "Compression.h"
+#include "EmbedPlan.h"
+#include "FileCopy.h"
+#include "FileReadOrWrite.h"
+#include "PayloadHeader.h"
+#include "PixelView.h"
+#include "RangeFile.h"
+#include "Scatter.h"
+#include "Stats.h"
+#include "StreamCodec.h"
+
+/**
+ * @file Steg.cpp
+ * @brief Implementation of the steg library [see Steg.h]
+ * @details Calls only the parts of FileReadOrWrite.h, PayloadHeader.h and StreamCodec.h that print nothing,
+ *          every failure is returned as a Status
+ */
+
+namespace steg {
+
+    namespace {
+
+        /**
+         * @class MemoryBuffer
+         * @brief Stream buffer over bytes owned by the caller [message given as a buffer]
+         * @details Seekable, so the size of the message is known to stream::storedLength
+         */
+
+        class MemoryBuffer : public std::streambuf {
+        public:
+            MemoryBuffer(const unsigned char* data, std::size_t size) {
+                char* begin = const_cast<char*>(reinterpret_cast<const char*>(data));
+                setg(begin, begin, begin + size);
+            }
+
+        protected:
+            auto seekoff(off_type offset, std::ios::seekdir direction, std::ios::openmode) -> pos_type override {
+                off_type base = direction == std::ios::beg ? 0 : direction == std::ios::cur ? gptr() - eback() : egptr() - eback();
+                if (base + offset < 0 || base + offset > egptr() - eback()) return pos_type(off_type(-1));
+                setg(eback(), eback() + base + offset, egptr());
+                return pos_type(base + offset);
+            }
+
+            auto seekpos(pos_type position, std::ios::openmode mode) -> pos_type override {
+                return seekoff(off_type(position), std::ios::beg, mode);
+            }
+        };
+
+        /**
+         * @brief Calling body with the row geometry of the carrier
+         * @function withGeometry
+         * @param info -> properties of the carrier<br>
+         * @param body -> callable taking pixels::Geometry of the format [BMP rows are padded, Netpbm rows are not]<br>
+         * @details Format is chosen once per call, loops inside of the body are compiled for it. Netpbm layouts
+         *          differ by the samples per pixel and the size of one sample.
+         */
+
+        template <typename Body>
+        auto withGeometry(const Info& info, Body&& body) {
+            if (info.format == Format::BMP) {
+                if (info.bitsPerPixel == 32) return body(pixels::Geometry<pixels::BMP32>(info.width, info.height));
+                return body(pixels::Geometry<pixels::BMP24>(info.width, info.height));
+            }
+            const bool wide = info.bitsPerPixel == 16 * info.samples;
+            switch (info.samples) {
+                case 1: return wide ? body(pixels::Geometry<pixels::PGM16>(info.width, info.height))
+                                    : body(pixels::Geometry<pixels::PGM8>(info.width, info.height));
+                case 2: return wide ? body(pixels::Geometry<pixels::PAMGA32>(info.width, info.height))
+                                    : body(pixels::Geometry<pixels::PAMGA16>(info.width, info.height));
+                case 4: return wide ? body(pixels::Geometry<pixels::PAM64>(info.width, info.height))
+                                    : body(pixels::Geometry<pixels::PAM32>(info.width, info.height));
+                default: return wide ? body(pixels::Geometry<pixels::PPM48>(info.width, info.height))
+                                     : body(pixels::Geometry<pixels::PPM24>(info.width, info.height));
+            }
+        }
+
+        /// Plan of the density and channels of the carrier [checked by choosePlan], scattered over it by a non-empty key
+        template <typename Geometry>
+        auto planFor(const Info& info, const Geometry& geometry, const std::string& key = {}) -> plans::Plan {
+            plans::Plan plan;
+            plans::Plan::of<typename Geometry::format>(info.density, info.channels, plan);
+            if (!key.empty()) plan.scatterBy(scatter::Key(key), geometry.carrierBytes());
+            return plan;
+        }
+
+        /// Size and capacity of the carrier with the default plan of its format [format, size and density are set]
+        auto setDefaults(Info& info) -> void {
+            info.carrierBytes = uint64_t(info.width) * info.height * (info.bitsPerPixel / 8);
+            info.channels = plans::allChannels;
+            info.capacity = withGeometry(info, [&](auto geometry) {
+                return payload::capacityOf(planFor(info, geometry), geometry.carrierBytes());
+            });
+        }
+
+        /// Properties of a Netpbm carrier out of its parsed header [checked by netpbm::isSupported]
+        auto layoutOf(const PPM_FileHeader& imageHeader, Info& info) -> void {
+            info.format = Format::PPM;
+            info.width = imageHeader.width;
+            info.height = imageHeader.height;
+            info.samples = imageHeader.depth;
+            info.bitsPerPixel = static_cast<int>(8 * imageHeader.depth * netpbm::sampleBytes(imageHeader));
+            info.plain = netpbm::isPlain(imageHeader);
+            info.density = ppm::density;
+        }
+
+        /**
+         * @brief Reading layout of the carrier from the first bytes of its file
+         * @function parseLayout
+         * @param data -> first bytes of the file<br>
+         * @param size -> number of bytes available<br>
+         * @param info -> properties of the carrier<br>
+         * @param dataOffset -> offset of the image(pixel) data (in 'bytes')<br>
+         * @details Format is recognized by the magic number ['BM' - .bmp, 'P2'..'P7' - .pgm, .ppm, .pam]. Masks
+         *          of a 32-bit BI_BITFIELDS BMP follow its headers, they have to be within the bytes.
+         */
+
+        auto parseLayout(const unsigned char* data, std::size_t size, Info& info, std::size_t& dataOffset) -> Status {
+            if (size >= 2 && data[0] == 'B' && data[1] == 'M') {
+                constexpr std::size_t headersSize = sizeof(BMP_FileHeader) + sizeof(BMP_FileInfoHeader);
+                BMP_FileHeader fileHeader;
+                BMP_FileInfoHeader fileInfoHeader;
+                if (!bmp::parseBMPHeaders(data, size, fileHeader, fileInfoHeader)) return Status::InvalidImage;
+                const bool hasMasks = fileInfoHeader.compression == bmp::bitFields;
+                if (hasMasks && size < headersSize + bmp::maskBytes) return Status::InvalidImage;
+                if (!bmp::isSupported(fileInfoHeader, hasMasks ? data + headersSize : nullptr)) return Status::UnsupportedFormat;
+                if (fileInfoHeader.width <= 0 || fileInfoHeader.height <= 0
+                    || fileHeader.dataOffset < headersSize + (hasMasks ? bmp::maskBytes : 0)) return Status::InvalidImage;
+                info.format = Format::BMP;
+                info.width = fileInfoHeader.width;
+                info.height = fileInfoHeader.height;
+                info.bitsPerPixel = fileInfoHeader.bitCount;
+                info.samples = fileInfoHeader.bitCount / 8;
+                info.density = bmp::density;
+                dataOffset = fileHeader.dataOffset;
+            } else if (size >= 2 && data[0] == 'P') {
+                PPM_FileHeader imageHeader;
+                if (!ppm::parsePPMHeader(data, size, imageHeader, dataOffset)) return Status::InvalidImage;
+                if (!netpbm::isSupported(imageHeader)) return Status::UnsupportedFormat;
+                layoutOf(imageHeader, info);
+            } else {
+                return Status::UnsupportedFormat;
+            }
+            setDefaults(info);
+            return Status::Ok;
+        }
+
+        /**
+         * @brief Applying density and channels of the options to the properties of the carrier
+         * @function choosePlan
+         * @param info -> properties of the carrier, density, channels and capacity are changed<br>
+         * @param options -> EncodeOptions, zero fields keep the defaults of the format<br>
+         * @details Returns false when the format has no plan for them [info is left unchanged]
+         */
+
+        auto choosePlan(Info& info, const EncodeOptions& options) -> bool {
+            const int density = options.density ? options.density : info.density;
+            const uint8_t channels = options.channels ? options.channels : plans::allChannels;
+            return withGeometry(info, [&](auto geometry) {
+                plans::Plan plan;
+                if (!plans::Plan::of<typename decltype(geometry)::format>(density, channels, plan)) return false;
+                info.density = density;
+                info.channels = channels;
+                const uint64_t capacity = payload::capacityOf(plan, geometry.carrierBytes());
+                const uint64_t overhead = options.secret.empty() ? 0 : cipher::overheadBytes;
+                info.capacity = capacity > overhead ? capacity - overhead : 0;
+                return true;
+            });
+        }
+
+        /// Number of stored payload bytes [cipher prefix and tag included] that fit into the carrier with the chosen plan
+        auto storedCapacity(const Info& info) -> uint64_t {
+            return withGeometry(info, [&](auto geometry) {
+                return payload::capacityOf(planFor(info, geometry), geometry.carrierBytes());
+            });
+        }
+
+        /**
+         * @brief Checking that the whole pixel data [padding of rows included] lies inside of a file of the given size
+         * @function fits
+         * @details Text of a plain raster is checked when it is read, but every sample takes at least a digit and a
+         *          separator [the last one may end the file], so a header promising more samples is rejected before
+         *          their binary buffer is allocated
+         */
+
+        auto fits(const Info& info, uint64_t dataOffset, uint64_t fileSize) -> bool {
+            if (dataOffset > fileSize) return false;
+            if (info.plain) return uint64_t(info.width) * info.height * info.samples <= (fileSize - dataOffset + 1) / 2;
+            uint64_t stored = withGeometry(info, [](auto geometry) { return geometry.storedBytes(); });
+            return stored <= fileSize - dataOffset;
+        }
+
+        /**
+         * @brief Opening the file and reading layout of the carrier from its headers
+         * @function openLayout
+         * @param path -> path of the file(image)<br>
+         * @param file -> opened file<br>
+         * @param info -> properties of the carrier<br>
+         * @param dataOffset -> offset of the image(pixel) data (in 'bytes')<br>
+         */
+
+        auto openLayout(const std::string& path, RangeFile& file, Info& info, std::size_t& dataOffset) -> Status {
+            if (path.empty()) return Status::InvalidArgument;
+            if (!file.open(path)) return Status::IoError;
+            std::vector<unsigned char> head(static_cast<std::size_t>(std::min<uint64_t>(file.size(), headBytes)));
+            if (!file.readAt(0, head.size(), head.data())) return Status::IoError;
+            auto status = parseLayout(head.data(), head.size(), info, dataOffset);
+            if (status != Status::Ok) return status;
+            return fits(info, dataOffset, file.size()) ? Status::Ok : Status::InvalidImage;
+        }
+
+        /**
+         * @brief Reading headers of the image streamed from the input
+         * @function readStreamLayout
+         * @param in -> input stream positioned at the start of the file(image)<br>
+         * @param out -> output stream receiving the headers, nullptr when they are only skipped<br>
+         * @param info -> properties of the carrier<br>
+         * @param imageHeader -> parsed Netpbm header [PlainReader of a plain raster needs it]<br>
+         * @details Input is left at the first byte of pixel data. BMP headers and bytes up to the pixel data are
+         *          copied unchanged, so is the Netpbm header [its comments included].
+         */
+
+        auto readStreamLayout(std::istream& in, std::ostream* out, Info& info, PPM_FileHeader& imageHeader) -> Status {
+            std::size_t dataOffset = 0;
+            if (in.peek() == 'B') {
+                constexpr std::size_t headersSize = sizeof(BMP_FileHeader) + sizeof(BMP_FileInfoHeader);
+                std::array<unsigned char, headersSize + bmp::maskBytes> head{};
+                std::size_t size = headersSize;
+                if (!in.read(reinterpret_cast<char*>(head.data()), headersSize)) return Status::InvalidImage;
+
+                /// Masks of a BI_BITFIELDS file are read as well [they are checked by parseLayout]
+                BMP_FileHeader fileHeader;
+                BMP_FileInfoHeader fileInfoHeader;
+                bmp::parseBMPHeaders(head.data(), size, fileHeader, fileInfoHeader);
+                if (fileInfoHeader.compression == bmp::bitFields) {
+                    if (!in.read(reinterpret_cast<char*>(head.data() + size), bmp::maskBytes)) return Status::InvalidImage;
+                    size += bmp::maskBytes;
+                }
+                stats::addRead(size);
+                auto status = parseLayout(head.data(), size, info, dataOffset);
+                if (status != Status::Ok) return status;
+                if (out && !out->write(reinterpret_cast<const char*>(head.data()), size)) return Status::IoError;
+                return stream::copyBytes(in, out, dataOffset - size) ? Status::Ok : Status::InvalidImage;
+            }
+            if (in.peek() == 'P') {
+                std::string head;
+                {
+                    stats::Timer timer(stats::Phase::Header);
+                    if (!netpbm::readHeader(in, head, imageHeader)) return in.bad() ? Status::IoError : Status::InvalidImage;
+                }
+                stats::addRead(head.size());
+                if (!netpbm::isSupported(imageHeader)) return Status::UnsupportedFormat;
+                layoutOf(imageHeader, info);
+                setDefaults(info);
+                if (out && !out->write(head.data(), static_cast<std::streamsize>(head.size()))) return Status::IoError;
+                return Status::Ok;
+            }
+            return in ? Status::UnsupportedFormat : Status::IoError;
+        }
+
+        auto flagsOf(const EncodeOptions& options) -> uint8_t {
+            return (options.compress ? payload::flagCompressed : 0) | (options.secret.empty() ? 0 : payload::flagEncrypted);
+        }
+
+        /// Reading the whole carrier, embedding the message and saving the carrier into the output
+        auto encodeWhole(const std::string& input, const std::string& output, std::istream& message,
+                         const EncodeOptions& options) -> Status {
+            Carrier carrier;
+            auto status = carrier.open(input);
+            if (status == Status::Ok) status = carrier.encode(message, options);
+            return status == Status::Ok ? carrier.save(output) : status;
+        }
+
+        /// Prefix of the file holding header and message of the given stored length [carrier is checked by parseLayout]
+        auto patchOf(Info info, std::size_t dataOffset, uint64_t length, const EncodeOptions& options, Patch& patch) -> Status {
+            if (!choosePlan(info, options)) return Status::UnsupportedPlan;
+            if (length > storedCapacity(info)) return Status::MessageTooLarge;
+            patch.info = info;
+            patch.dataOffset = dataOffset;
+            patch.length = length;
+            patch.prefixBytes = 0;
+
+            /// Text of a plain raster changes its length with the samples, so the whole file is written again
+            if (info.plain) return Status::Ok;
+            withGeometry(info, [&](auto geometry) {
+                const auto plan = planFor(info, geometry, options.key);
+                uint64_t offset = 0;
+                uint64_t stored = 0;
+                /// Scattered message may change any byte of the pixel data
+                const uint64_t needed = plan.scattered() ? geometry.carrierBytes()
+                                                         : payload::carrierBytesNeeded(payload::headerOf(plan, length), plan);
+                geometry.storedRange(0, needed, offset, stored);
+                patch.prefixBytes = dataOffset + static_cast<std::size_t>(stored);
+            });
+            return Status::Ok;
+        }
+
+        /**
+         * @brief Embedding message into the carrier bytes it needs, the rest of the file is copied unchanged
+         * @function patchFile
+         * @param input -> path of the file(image)<br>
+         * @param output -> path of the encrypted file(image)<br>
+         * @param message -> message stream of a known size<br>
+         * @param length -> size of the message as it is stored (in 'bytes')<br>
+         * @param options -> EncodeOptions<br>
+         * @details Only headers and the carrier bytes holding header and message are read and written from user
+         *          space, the untouched rest of the pixel data goes through filecopy::writePatched
+         */
+
+        auto patchFile(const std::string& input, const std::string& output, std::istream& message, uint64_t length,
+                       const EncodeOptions& options) -> Status {
+            RangeFile file;
+            Info info;
+            std::size_t dataOffset = 0;
+            auto status = openLayout(input, file, info, dataOffset);
+            if (status != Status::Ok) return status;
+            Patch patch;
+            status = patchOf(info, dataOffset, length, options, patch);
+            if (status != Status::Ok) return status;
+            if (patch.prefixBytes == 0) {
+                file.close();
+                return encodeWhole(input, output, message, options);
+            }
+
+            /// Reading headers and the prefix of pixel data embedding changes
+            auto prefix = buffers::acquire(patch.prefixBytes);
+            if (!file.readAt(0, prefix.size(), prefix.data())) return Status::IoError;
+            file.close();
+            status = applyPatch(patch, prefix.data(), message, options);
+            if (status != Status::Ok) return status;
+            return filecopy::writePatched(input, output, prefix.data(), prefix.size()) ? Status::Ok : Status::IoError;
+        }
+
+        /**
+         * @brief Checking layout of the bytes and taking them into the carrier
+         * @function adopt
+         * @param bytes -> bytes of the whole file<br>
+         * @param file, dataOffset, properties -> members of the carrier, changed only when the bytes are valid<br>
+         * @details Text of a plain raster is converted into binary samples following the header bytes
+         */
+
+        auto adopt(buffers::Buffer&& bytes, buffers::Buffer& file, std::size_t& dataOffset, Info& properties) -> Status {
+            Info info;
+            std::size_t offset = 0;
+            auto status = parseLayout(bytes.data(), bytes.size(), info, offset);
+            if (status != Status::Ok) return status;
+            if (!fits(info, offset, bytes.size())) return Status::InvalidImage;
+            if (info.plain) {
+                PPM_FileHeader imageHeader;
+                std::size_t rasterOffset = 0;
+                ppm::parsePPMHeader(bytes.data(), bytes.size(), imageHeader, rasterOffset);
+                auto converted = buffers::acquire(offset + static_cast<std::size_t>(info.carrierBytes));
+                std::memcpy(converted.data(), bytes.data(), offset);
+                if (!netpbm::readPlain(bytes.data() + offset, bytes.size() - offset, imageHeader, converted.data() + offset)) {
+                    return Status::InvalidImage;
+                }
+                bytes = std::move(converted);
+            }
+            file = std::move(bytes);
+            dataOffset = offset;
+            properties = info;
+            return Status::Ok;
+        }
+
+        /// Checking extracted payload against its checksum, then decrypting and decompressing it [decode paths end here]
+        auto finish(const PayloadHeader& header, std::vector<unsigned char>& message, uint32_t checksum,
+                    const DecodeOptions& options) -> Status {
+            if (!payload::verify(header, message, checksum)) return Status::ChecksumMismatch;
+            if (header.flags & payload::flagEncrypted) {
+                if (options.secret.empty()) {
+                    message.clear();
+                    return Status::SecretRequired;
+                }
+                if (!cipher::open(options.secret, message)) return Status::DecryptionFailed;
+            }
+            return payload::unpack(header, message) ? Status::Ok : Status::CorruptedMessage;
+        }
+    }
+
+    auto describe(Status status) -> const char* {
+        switch (status) {
+            case Status::Ok: return "ok";
+            case Status::InvalidArgument: return "path or buffer is empty";
+            case Status::IoError: return "unable to read or write the file";
+            case Status::UnsupportedFormat: return "unsupported image format [24/32-bit BMP or Netpbm P2/P3/P5/P6/P7 expected]";
+            case Status::InvalidImage: return "image headers are damaged or pixel data is missing";
+            case Status::MessageTooLarge: return "message is bigger than carrier can store";
+            case Status::UnknownLength: return "size of the message is not known, read it from a file";
+            case Status::NoMessage: return "no hidden message found";
+            case Status::CorruptedMessage: return "hidden message is damaged";
+            case Status::UnsupportedPlan: return "density or channels are not supported for this image";
+            case Status::KeyRequired: return "message is hidden with a key, the key is missing or wrong";
+            case Status::ChecksumMismatch: return "hidden message does not match its checksum, carrier was modified";
+            case Status::SecretRequired: return "message is encrypted, give the passphrase or keyfile it was encrypted with";
+            case Status::DecryptionFailed: return "message cannot be decrypted, the passphrase or keyfile is wrong or the message was forged";
+        }
+        return "unknown status";
+    }
+
+    auto Carrier::load(const std::vector<unsigned char>& bytes) -> Status {
+        if (bytes.empty()) return Status::InvalidArgument;
+        auto buffer = buffers::acquire(bytes.size());
+        std::memcpy(buffer.data(), bytes.data(), bytes.size());
+        return adopt(std::move(buffer), file, dataOffset, properties);
+    }
+
+    auto Carrier::open(const std::string& path) -> Status {
+        if (path.empty()) return Status::InvalidArgument;
+        RangeFile source;
+        if (!source.open(path)) return Status::IoError;
+
+        /// Pooled buffer is not zeroed, it is overwritten by the file right away
+        auto buffer = buffers::acquire(static_cast<std::size_t>(source.size()));
+        if (!source.readAt(0, buffer.size(), buffer.data())) return Status::IoError;
+        return adopt(std::move(buffer), file, dataOffset, properties);
+    }
+
+    auto Carrier::encode(const unsigned char* message, std::size_t length, const EncodeOptions& options) -> Status {
+        if (file.empty()) return Status::InvalidArgument;
+        Info info = properties;
+        if (!choosePlan(info, options)) return Status::UnsupportedPlan;
+        if (!options.compress && options.secret.empty()) {
+            /// Message size is known, so nothing is changed when it does not fit
+            return withGeometry(info, [&](auto geometry) {
+                return payload::embedMessage(pixels::RowView(file.data() + dataOffset, geometry), message, length,
+                                             planFor(info, geometry, options.key));
+            }) ? Status::Ok : Status::MessageTooLarge;
+        }
+        /// Encrypted message is sealed while it streams into the carrier, its stored size is known as well
+        if (!options.compress && length > info.capacity) return Status::MessageTooLarge;
+        MemoryBuffer buffer(message, length);
+        std::istream in(&buffer);
+        return encode(in, options);
+    }
+
+    auto Carrier::encode(std::istream& message, const EncodeOptions& options) -> Status {
+        if (file.empty()) return Status::InvalidArgument;
+        Info info = properties;
+        if (!choosePlan(info, options)) return Status::UnsupportedPlan;
+        lz::CompressBuffer buffer(message);
+        std::istream packed(&buffer);
+        stream::PayloadStream source(options.compress ? packed : message, stream::PayloadStream::unknownLength, options.secret);
+        uint64_t length = 0;
+        bool embedded = withGeometry(info, [&](auto geometry) {
+            return stream::embedMessage(pixels::RowView(file.data() + dataOffset, geometry), info.carrierBytes,
+                                        source, planFor(info, geometry, options.key), length, flagsOf(options));
+        });
+        if (!embedded) return Status::MessageTooLarge;
+        return message.bad() ? Status::IoError : Status::Ok;
+    }
+
+    auto Carrier::decode(std::vector<unsigned char>& message, const DecodeOptions& options) const -> Status {
+        if (file.empty()) return Status::InvalidArgument;
+        const scatter::Key key(options.key);
+        return withGeometry(properties, [&](auto geometry) {
+            pixels::RowView carrier(file.data() + dataOffset, geometry);
+            PayloadHeader header;
+            if (geometry.carrierBytes() < plans::headerCarrierOf<typename decltype(geometry)::format>
+                || !payload::readHeader(carrier, header))
+                return Status::NoMessage;
+            if (!payload::unlocks(header, key)) return Status::KeyRequired;
+            uint32_t checksum = 0;
+            if (!payload::extractMessage(carrier, header, message, checksum, key)) return Status::CorruptedMessage;
+            return finish(header, message, checksum, options);
+        });
+    }
+
+    auto Carrier::save(const std::string& path) const -> Status {
+        if (path.empty() || file.empty()) return Status::InvalidArgument;
+        stats::Timer timer(stats::Phase::Write);
+        std::ofstream out(path, std::ios::binary);
+        if (properties.plain) {
+            /// Header bytes as they were read, binary samples as text again
+            netpbm::PlainWriter writer(out, static_cast<std::size_t>(properties.bitsPerPixel / (8 * properties.samples)));
+            if (!out.write(reinterpret_cast<const char*>(file.data()), static_cast<std::streamsize>(dataOffset))
+                || writer.sputn(reinterpret_cast<const char*>(file.data() + dataOffset),
+                                static_cast<std::streamsize>(file.size() - dataOffset))
+                       != static_cast<std::streamsize>(file.size() - dataOffset)
+                || !writer.finish()) {
+                return Status::IoError;
+            }
+        } else if (!out.write(reinterpret_cast<const char*>(file.data()), static_cast<std::streamsize>(file.size()))) {
+            return Status::IoError;
+        }
+        const auto written = static_cast<uint64_t>(out.tellp());
+        out.close();
+        if (!out) return Status::IoError;
+        timer.stop();
+        stats::addWritten(written);
+        stats::syncFile(path);
+        return Status::Ok;
+    }
+
+    auto planPatch(const unsigned char* head, std::size_t size, uint64_t fileSize, std::istream& message,
+                   const EncodeOptions& options, Patch& patch) -> Status {
+        if (!head || size == 0) return Status::InvalidArgument;
+        Info info;
+        std::size_t dataOffset = 0;
+        auto status = parseLayout(head, size, info, dataOffset);
+        if (status != Status::Ok) return status;
+        if (!fits(info, dataOffset, fileSize)) return Status::InvalidImage;
+        const uint64_t length = stream::storedLength(message, options.compress, !options.secret.empty());
+        if (length == stream::PayloadStream::unknownLength) return Status::UnknownLength;
+        return patchOf(info, dataOffset, length, options, patch);
+    }
+
+    auto applyPatch(const Patch& patch, unsigned char* prefix, std::istream& message, const EncodeOptions& options) -> Status {
+        if (!prefix || patch.prefixBytes == 0) return Status::InvalidArgument;
+        return withGeometry(patch.info, [&](auto geometry) {
+            const auto plan = planFor(patch.info, geometry, options.key);
+            const uint64_t needed = plan.scattered() ? geometry.carrierBytes()
+                                                     : payload::carrierBytesNeeded(payload::headerOf(plan, patch.length), plan);
+            lz::CompressBuffer buffer(message);
+            std::istream packed(&buffer);
+            stream::PayloadStream source(options.compress ? packed : message, patch.length, options.secret);
+            uint64_t embedded = 0;
+            if (!stream::embedMessage(pixels::RowView(prefix + patch.dataOffset, geometry), needed, source, plan,
+                                      embedded, flagsOf(options))
+                || embedded != patch.length || message.bad()) return Status::IoError;
+            return Status::Ok;
+        });
+    }
+
+    auto inspect(const std::string& path, Info& info, const EncodeOptions& options) -> Status {
+        RangeFile file;
+        std::size_t dataOffset = 0;
+        auto status = openLayout(path, file, info, dataOffset);
+        if (status != Status::Ok) return status;
+        return choosePlan(info, options) ? Status::Ok : Status::UnsupportedPlan;
+    }
+
+    auto encodeFile(const std::string& input, const std::string& output, std::istream& message,
+                    const EncodeOptions& options) -> Status {
+        if (output.empty()) return Status::InvalidArgument;
+        const uint64_t length = stream::storedLength(message, options.compress, !options.secret.empty());
+        if (length != stream::PayloadStream::unknownLength) return patchFile(input, output, message, length, options);
+
+        /// Size of a piped message is found only by embedding it, so the whole carrier is read
+        return encodeWhole(input, output, message, options);
+    }
+
+    auto encodeFile(const std::string& input, const std::string& output, const unsigned char* message,
+                    std::size_t length, const EncodeOptions& options) -> Status {
+        MemoryBuffer buffer(message, length);
+        std::istream in(&buffer);
+        return encodeFile(input, output, in, options);
+    }
+
+    auto decodeFile(const std::string& path, std::vector<unsigned char>& message, const DecodeOptions& options) -> Status {
+        RangeFile file;
+        Info info;
+        std::size_t dataOffset = 0;
+        auto status = openLayout(path, file, info, dataOffset);
+        if (status != Status::Ok) return status;
+
+        /// Text of a plain raster is not at fixed offsets, it is read from the start as a stream
+        if (info.plain) {
+            file.close();
+            std::ifstream in(path, std::ios::binary);
+            return in ? decodeStream(in, message, options) : Status::IoError;
+        }
+
+        const scatter::Key key(options.key);
+        return withGeometry(info, [&](auto geometry) {
+            /// Header first, so a carrier without a message is told apart from a damaged message or a wrong key
+            PayloadHeader header;
+            if (!payload::readHeaderAt(file, dataOffset, geometry, header)) return Status::NoMessage;
+            if (!payload::unlocks(header, key)) return Status::KeyRequired;
+            uint32_t checksum = 0;
+            if (!payload::readMessage(file, dataOffset, geometry, header, message, checksum, key)) return Status::CorruptedMessage;
+            return finish(header, message, checksum, options);
+        });
+    }
+
+    auto encodeStream(std::istream& in, std::ostream& out, std::istream& message, const EncodeOptions& options) -> Status {
+        Info info;
+        PPM_FileHeader imageHeader;
+        auto status = readStreamLayout(in, &out, info, imageHeader);
+        if (status != Status::Ok) return status;
+        if (!choosePlan(info, options)) return Status::UnsupportedPlan;
+
+        /// Header goes before the message, so its size has to be known [compressed once to count it]
+        const uint64_t length = stream::storedLength(message, options.compress, !options.secret.empty());
+        if (length == stream::PayloadStream::unknownLength) return Status::UnknownLength;
+        if (length > storedCapacity(info)) return Status::MessageTooLarge;
+        lz::CompressBuffer buffer(message);
+        std::istream packed(&buffer);
+        stream::PayloadStream source(options.compress ? packed : message, length, options.secret);
+
+        /// Embedding header and message band by band, bytes after the pixel data are copied unchanged
+        auto embed = [&](std::istream& rasterIn, std::ostream& rasterOut) {
+            return withGeometry(info, [&](auto geometry) {
+                const auto plan = planFor(info, geometry, options.key);
+                auto headerBytes = payload::serialize(payload::headerOf(plan, length, flagsOf(options)));
+                return stream::embedRows(rasterIn, rasterOut, geometry, headerBytes.data(), source, plan);
+            });
+        };
+        if (info.plain) {
+            /// Samples of a plain raster are read and written as text, it ends with the last of them
+            netpbm::PlainReader reader(in, imageHeader);
+            netpbm::PlainWriter writer(out, netpbm::sampleBytes(imageHeader));
+            std::istream rasterIn(&reader);
+            std::ostream rasterOut(&writer);
+            if (!embed(rasterIn, rasterOut) || !writer.finish() || !out.flush()) {
+                return reader.complete() || in.bad() ? Status::IoError : Status::InvalidImage;
+            }
+            return Status::Ok;
+        }
+        if (!embed(in, out) || !stream::copyRest(in, out) || !out.flush()) return Status::IoError;
+        return Status::Ok;
+    }
+
+    auto decodeStream(std::istream& in, std::vector<unsigned char>& message, const DecodeOptions& options) -> Status {
+        Info info;
+        PPM_FileHeader imageHeader;
+        auto status = readStreamLayout(in, nullptr, info, imageHeader);
+        if (status != Status::Ok) return status;
+
+        PayloadHeader header;
+        uint32_t checksum = 0;
+        bool found = false;
+        const scatter::Key key(options.key);
+        auto extract = [&](std::istream& rasterIn) {
+            return withGeometry(info, [&](auto geometry) {
+                return stream::extractRows(rasterIn, geometry, header, message, checksum, found, key);
+            });
+        };
+        bool read = true;
+        if (info.plain) {
+            netpbm::PlainReader reader(in, imageHeader);
+            std::istream rasterIn(&reader);
+            read = extract(rasterIn);
+            if (!read && !reader.complete() && !in.bad()) return Status::InvalidImage;
+        } else {
+            read = extract(in);
+        }
+        if (!read) return Status::IoError;
+        if (!found) return Status::NoMessage;
+        if (!payload::unlocks(header, key)) return Status::KeyRequired;
+        return finish(header, message, checksum, options);
+    }
+}
@@ -0,0 +1,246 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "BufferPool.h"
+
+/**
+ * @file Steg.h
+ * @brief Public interface of the steg library [libsteg]
+ * @details Everything the command line tool does is available here without console output or fixed paths:<br>
+ *              &emsp;&emsp;- Carrier -> BMP or PPM image held in memory, loaded from a buffer or a file<br>
+ *              &emsp;&emsp;- encodeFile -> file to file, only the changed bytes pass through memory<br>
+ *              &emsp;&emsp;- decodeFile -> message read straight from a file [only byte ranges holding it]<br>
+ *              &emsp;&emsp;- encodeStream/decodeStream -> images streamed band by band [bounded memory]<br>
+ *          Every call reports its result as a Status, describe() turns it into text.
+ * @attention Calls are reentrant, they keep no state outside of their arguments. Different Carriers may be used
+ *            from different threads at once, a Carrier being decoded may be shared by threads as long as none of
+ *            them encodes into it. Large images are split into bands on the shared ThreadPool [STEG_THREADS].
+ */
+
+namespace steg {
+
+    /// Result of every library call
+    enum class Status : uint8_t {
+        Ok,
+        InvalidArgument,    // empty path or buffer
+        IoError,            // file or stream cannot be read or written
+        UnsupportedFormat,  // not a 24/32-bit uncompressed BMP or a Netpbm image (P2, P3, P5, P6, P7) of 8/16-bit samples
+        InvalidImage,       // headers are malformed or pixel data does not fit into the file
+        MessageTooLarge,    // message does not fit into the carrier
+        UnknownLength,      // message size is needed in advance [streams] and cannot be found
+        NoMessage,          // carrier holds no PayloadHeader
+        CorruptedMessage,   // header is found, but the message it describes cannot be read
+        UnsupportedPlan,    // density or channels of EncodeOptions are out of range
+        KeyRequired,        // message is scattered by a key, no key or another one is given
+        ChecksumMismatch,   // message is read, but it does not match the CRC32C stored after it
+        SecretRequired,     // message is encrypted and no passphrase or keyfile is given
+        DecryptionFailed    // message is encrypted, the secret is wrong or the message was forged
+    };
+
+    /// Short description of the status [e.g. "message is bigger than carrier can store"]
+    auto describe(Status status) -> const char*;
+
+    /// Format of the carrier [PPM stands for the whole Netpbm family: PGM, PPM and PAM, plain or binary]
+    enum class Format : uint8_t { Unknown, BMP, PPM };
+
+    /**
+     * @struct Info
+     * @brief Properties of a carrier read from its headers
+     * @var
+     * <b>format</b> -> BMP or PPM<br>
+     * <b>width</b>, <b>height</b> -> image size (in 'pixels')<br>
+     * <b>bitsPerPixel</b> -> size of one pixel in binary form [BMP 24 or 32 with alpha, Netpbm samples * 8 or 16]<br>
+     * <b>samples</b> -> samples per pixel [1 gray, 2 gray and alpha, 3 color, 4 color and alpha]<br>
+     * <b>plain</b> -> pixel data is text [P2, P3], it is converted into binary samples and back<br>
+     * <b>carrierBytes</b> -> size of the image(pixel) data (in 'bytes')<br>
+     * <b>density</b> -> payload bits per used carrier byte [default of the format or of EncodeOptions]<br>
+     * <b>channels</b> -> color channels holding the payload [1 red, 2 green, 4 blue, 8 alpha]<br>
+     * <b>capacity</b> -> number of message bytes the carrier can store with this density and channels [uncompressed, checksum aside, less the cipher prefix and tag when a secret is given]
+     */
+
+    struct Info {
+        Format format = Format::Unknown;
+        int32_t width = 0;
+        int32_t height = 0;
+        int bitsPerPixel = 0;
+        int samples = 0;
+        bool plain = false;
+        uint64_t carrierBytes = 0;
+        int density = 0;
+        uint8_t channels = 0;
+        uint64_t capacity = 0;
+    };
+
+    /// Options of encoding, decoding reads all of them but the key and the secret from the embedded header
+    struct EncodeOptions {
+        bool compress = false; // message is compressed with lz before embedding
+        int density = 0;       // payload bits per used byte [1..4], 0 for the default of the format [BMP 2, PPM 1]
+        uint8_t channels = 0;  // color channels holding the payload [1 red | 2 green | 4 blue | 8 alpha], 0 for red, green and blue
+        std::string key;       // message bits are scattered over the whole carrier in the order of the key, empty to embed them in order
+        std::string secret;    // passphrase or keyfile contents the message is encrypted with [ChaCha20-Poly1305], empty to store it as it is
+    };
+
+    /// Options of decoding
+    struct DecodeOptions {
+        std::string key;       // key the message was encoded with, unused when the message is not scattered
+        std::string secret;    // secret the message was encrypted with, unused when the message is not encrypted
+    };
+
+    /**
+     * @class Carrier
+     * @brief Image held in memory as the bytes of its file
+     * @var
+     * <b>file</b> -> bytes of the whole file in a pooled buffer, encode changes pixel data in place [binary samples of a plain raster]<br>
+     * <b>dataOffset</b> -> offset of the image(pixel) data in the file<br>
+     * <b>properties</b> -> format, size and capacity read from the headers
+     * @details Format is recognized by the content ['BM' or 'P2'..'P7'], not by the file name. Headers and bytes around
+     *          the pixel data are kept as they are, so bytes() is a complete file again after encode(). Text of
+     *          a plain raster [P2, P3] is held as binary samples, save() writes it as text again.
+     *          Bytes live in a buffer of buffers::Pool::shared(), so carriers opened one after another [batch, daemon]
+     *          reuse memory instead of allocating and zeroing it. Copy of a Carrier copies its bytes.
+     */
+
+    class Carrier {
+    public:
+        /// Copying bytes of a whole file into the carrier
+        auto load(const std::vector<unsigned char>& bytes) -> Status;
+
+        /// Reading the whole file
+        auto open(const std::string& path) -> Status;
+
+        /**
+         * @brief Embedding header and message into pixel data
+         * @function encode
+         * @param message -> message bytes<br>
+         * @param length -> message size (in 'bytes')<br>
+         * @param options -> EncodeOptions<br>
+         * @details Uncompressed message is checked against capacity before any pixel is changed
+         */
+
+        auto encode(const unsigned char* message, std::size_t length, const EncodeOptions& options = {}) -> Status;
+
+        /**
+         * @brief Embedding header and message pulled from the stream
+         * @function encode
+         * @param message -> message stream [file, standard input, ...], its size does not have to be known<br>
+         * @param options -> EncodeOptions<br>
+         * @attention Message of unknown size is found too large only once pixels are changed, load the carrier
+         *            again before reusing it after MessageTooLarge
+         */
+
+        auto encode(std::istream& message, const EncodeOptions& options = {}) -> Status;
+
+        /// Extracting message [decompressed when it was encoded with compress]
+        auto decode(std::vector<unsigned char>& message, const DecodeOptions& options = {}) const -> Status;
+
+        /// Writing bytes of the file
+        auto save(const std::string& path) const -> Status;
+
+        auto bytes() const -> std::span<const unsigned char> { return {file.data(), file.size()}; }
+        auto info() const -> const Info& { return properties; }
+
+    private:
+        buffers::Buffer file;
+        std::size_t dataOffset = 0;
+        Info properties;
+    };
+
+    /// Bytes read from the start of a file to parse its headers [Netpbm header is expected within them]
+    inline constexpr std::size_t headBytes = 4096;
+
+    /**
+     * @struct Patch
+     * @brief Start of a carrier file that encoding a message changes, everything after it stays as it is
+     * @var
+     * <b>info</b> -> properties of the carrier with the density and channels of the options<br>
+     * <b>dataOffset</b> -> offset of the image(pixel) data in the file<br>
+     * <b>prefixBytes</b> -> headers and the pixel data holding header and message, 0 when the whole file has to be
+     * written again [plain raster, use encodeFile]<br>
+     * <b>length</b> -> size of the message as it is stored [compressed when compress is set]
+     * @details Lets the caller do the I/O of encodeFile itself [batch pipeline]: planPatch on the first headBytes
+     *          of the file, reading prefixBytes, applyPatch, writing them in front of the unchanged rest.
+     */
+
+    struct Patch {
+        Info info;
+        std::size_t dataOffset = 0;
+        std::size_t prefixBytes = 0;
+        uint64_t length = 0;
+    };
+
+    /**
+     * @brief Finding the prefix of the file the message changes
+     * @function planPatch
+     * @param head -> first bytes of the file [headBytes of them, or the whole file when it is shorter]<br>
+     * @param size -> number of bytes in head<br>
+     * @param fileSize -> size of the whole file (in 'bytes')<br>
+     * @param message -> seekable message stream, it is left at its position<br>
+     * @param options -> EncodeOptions<br>
+     */
+
+    auto planPatch(const unsigned char* head, std::size_t size, uint64_t fileSize, std::istream& message,
+                   const EncodeOptions& options, Patch& patch) -> Status;
+
+    /// Embedding header and message into the prefix [prefixBytes read from the start of the file, see planPatch]
+    auto applyPatch(const Patch& patch, unsigned char* prefix, std::istream& message, const EncodeOptions& options = {}) -> Status;
+
+    /// Reading properties of the carrier from the headers of the file, capacity is given for the options [pixel data is not read]
+    auto inspect(const std::string& path, Info& info, const EncodeOptions& options = {}) -> Status;
+
+    /**
+     * @brief Embedding message into the file(image) and writing the encrypted file
+     * @function encodeFile
+     * @param input -> path of the file(image)<br>
+     * @param output -> path of the encrypted file(image), it may be the input itself<br>
+     * @param message -> message stream [file, standard input, ...]<br>
+     * @param options -> EncodeOptions<br>
+     * @details Only headers and the carrier bytes holding the message are read and written, the unchanged rest of
+     *          the file is reflinked or copied by the kernel [copy_file_range, sendfile]. Message of unknown size
+     *          [pipe] goes through a Carrier holding the whole file.
+     *          Message scattered by a key changes bytes all over the pixel data, so all of it is read and written.
+     */
+
+    auto encodeFile(const std::string& input, const std::string& output, std::istream& message,
+                    const EncodeOptions& options = {}) -> Status;
+
+    /// Embedding message given as a buffer [see encodeFile above]
+    auto encodeFile(const std::string& input, const std::string& output, const unsigned char* message,
+                    std::size_t length, const EncodeOptions& options = {}) -> Status;
+
+    /**
+     * @brief Extracting message straight from the file
+     * @function decodeFile
+     * @param path -> path of the file(image)<br>
+     * @param message -> extracted message<br>
+     * @param options -> DecodeOptions<br>
+     * @details Only headers and the byte range holding the message are read, a short message costs a few KB
+     *          of I/O for any image size. Short message scattered by a key is read page by page, a long one with
+     *          one pass over the pixel data.
+     */
+
+    auto decodeFile(const std::string& path, std::vector<unsigned char>& message, const DecodeOptions& options = {}) -> Status;
+
+    /**
+     * @brief Embedding message into the image while it streams from input to output
+     * @function encodeStream
+     * @param in -> input stream with the file(image)<br>
+     * @param out -> output stream receiving the encrypted file(image)<br>
+     * @param message -> message stream, its size has to be known [seekable stream] as the header goes first<br>
+     * @param options -> EncodeOptions<br>
+     * @details Pixel data goes through fixed-size bands of rows, so memory does not grow with image size
+     *          [message scattered by a key is held in memory, any band may hold any of its bits]
+     */
+
+    auto encodeStream(std::istream& in, std::ostream& out, std::istream& message,
+                      const EncodeOptions& options = {}) -> Status;
+
+    /// Extracting message from the image read from the stream, reading stops once the message is complete [at the end of pixel data when it is scattered]
+    auto decodeStream(std::istream& in, std::vector<unsigned char>& message, const DecodeOptions& options = {}) -> Status;
+}
@@ -0,0 +1,477 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <istream>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "BufferPool.h"
+#include "Checksum.h"
+#include "Cipher.h"
+#include "Compression.h"
+#include "LSBKernels.h"
+#include "PayloadHeader.h"
+#include "PixelView.h"
+#include "Stats.h"
+
+namespace stream {
+
+    /// Size of one band of rows kept in memory (in 'bytes'), a band always holds at least one row
+    inline constexpr std::size_t bandBytes = std::size_t{4} << 20;
+
+    /**
+     * @brief Copying bytes from input to output through a bounded buffer
+     * @function copyBytes
+     * @param in -> input stream<br>
+     * @param out -> output stream, nullptr to only skip input bytes<br>
+     * @param count -> number of bytes to copy<br>
+     */
+
+    inline auto copyBytes(std::istream& in, std::ostream* out, uint64_t count) -> bool {
+        std::vector<char> buffer(static_cast<std::size_t>(std::min<uint64_t>(count, 1 << 16)));
+        while (count > 0) {
+            auto chunk = static_cast<std::size_t>(std::min<uint64_t>(count, buffer.size()));
+            {
+                stats::Timer timer(stats::Phase::Read);
+                if (!in.read(buffer.data(), static_cast<std::streamsize>(chunk))) return false;
+            }
+            stats::addRead(chunk);
+            if (out) {
+                stats::Timer timer(stats::Phase::Write);
+                if (!out->write(buffer.data(), static_cast<std::streamsize>(chunk))) return false;
+                stats::addWritten(chunk);
+            }
+            count -= chunk;
+        }
+        return true;
+    }
+
+    /**
+     * @brief Copying the rest of the input to the output
+     * @function copyRest
+     * @details Used for bytes following the pixel data, which are kept as they are
+     */
+
+    inline auto copyRest(std::istream& in, std::ostream& out) -> bool {
+        std::vector<char> buffer(1 << 16);
+        while (in.read(buffer.data(), static_cast<std::streamsize>(buffer.size())) || in.gcount() > 0) {
+            stats::addRead(static_cast<uint64_t>(in.gcount()));
+            stats::Timer timer(stats::Phase::Write);
+            if (!out.write(buffer.data(), in.gcount())) return false;
+            stats::addWritten(static_cast<uint64_t>(in.gcount()));
+        }
+        return true;
+    }
+
+    /**
+     * @class PayloadStream
+     * @brief Payload pulled from a stream in small windows
+     * @var
+     * <b>in</b> -> payload stream [file, standard input or in-memory message]<br>
+     * <b>window</b> -> payload bytes currently held in memory<br>
+     * <b>windowStart</b> -> index of the first window byte within the payload<br>
+     * <b>declared</b> -> payload size as stored when it is known in advance, unknownLength otherwise<br>
+     * <b>checksum</b> -> CRC32C of the payload bytes read so far<br>
+     * <b>sealer</b> -> cipher of an encrypted payload [empty secret leaves the bytes as they are read]
+     * @details Embedding loops ask for the bits of the carrier bytes they are about to write, bytes before them
+     *          are dropped, so the whole payload is never held in memory. Bytes are checksummed as they are read,
+     *          and once the payload ends its CRC32C follows it in the stream [payload::flagChecksum], so the
+     *          loops embed it as 4 more payload bytes.
+     *          With a secret the stream starts with the cipher prefix and the bytes read are encrypted and
+     *          authenticated in runs of runBytes, each run is checksummed right after while it is still in
+     *          cache. Tag of the cipher goes between the last byte read and the checksum [payload::flagEncrypted].
+     */
+
+    class PayloadStream {
+    public:
+        static constexpr uint64_t unknownLength = ~uint64_t{0};
+
+        PayloadStream(std::istream& in, uint64_t length = unknownLength, std::string_view secret = {})
+            : in(in), declared(length) {
+            if (secret.empty()) return;
+            sealer.emplace(secret);
+            const auto& prefix = sealer->prefix();
+            window.assign(prefix.begin(), prefix.end());
+            checksum = crc::update(checksum, prefix.data(), prefix.size());
+        }
+
+        /**
+         * @brief Making payload bits available
+         * @function fetch
+         * @param bit -> first payload bit needed [never smaller than in the previous call]<br>
+         * @param bits -> number of bits needed<br>
+         * @param available -> number of bits available from 'bit' [smaller than 'bits' only at the end of the payload]<br>
+         * @details Returns pointer to the payload byte holding 'bit', so the bits start at offset bit % 8 of it
+         */
+
+        auto fetch(uint64_t bit, uint64_t bits, uint64_t& available) -> const unsigned char* {
+            uint64_t firstByte = bit / 8;
+            uint64_t lastByte = (bit + bits + 7) / 8;
+
+            /// Dropping bytes that were already embedded
+            auto drop = static_cast<std::size_t>(std::min<uint64_t>(firstByte - windowStart, window.size()));
+            window.erase(window.begin(), window.begin() + static_cast<std::ptrdiff_t>(drop));
+            windowStart += drop;
+
+            /// Reading bytes up to the last one needed, tag and checksum are appended where the input ends
+            if (lastByte > windowStart + window.size() && !ended) {
+                const uint64_t inputEnd = declared == unknownLength || !sealer ? declared : declared - cipher::tagBytes;
+                auto have = window.size();
+                auto wanted = static_cast<std::size_t>(std::min(lastByte, inputEnd) - (windowStart + have));
+                window.resize(have + wanted);
+                in.read(reinterpret_cast<char*>(window.data() + have), static_cast<std::streamsize>(wanted));
+                auto got = static_cast<std::size_t>(in.gcount());
+                stats::addRead(got);
+                window.resize(have + got);
+                for (std::size_t done = 0; done < got; done += runBytes) {
+                    auto* run = window.data() + have + done;
+                    auto size = std::min(runBytes, got - done);
+                    if (sealer) sealer->seal(run, size);
+                    checksum = crc::update(checksum, run, size);
+                }
+                if (got < wanted || windowStart + window.size() == inputEnd) {
+                    if (sealer) {
+                        auto tag = sealer->tag();
+                        window.insert(window.end(), tag.begin(), tag.end());
+                        checksum = crc::update(checksum, tag.data(), tag.size());
+                    }
+                    auto trailer = payload::serializeChecksum(checksum);
+                    window.insert(window.end(), trailer.begin(), trailer.end());
+                    ended = true;
+                }
+            }
+
+            uint64_t end = (windowStart + window.size()) * 8;
+            available = end > bit ? std::min(bits, end - bit) : 0;
+            return window.data() + std::min<uint64_t>(firstByte - windowStart, window.size());
+        }
+
+        /// Checking whether there are payload bytes after the given bit
+        auto hasMore(uint64_t bit) -> bool {
+            uint64_t available = 0;
+            fetch(bit, 8, available);
+            return available > 0;
+        }
+
+        /// Declared payload size as stored [cipher prefix and tag included], checksum not included
+        auto length() const -> uint64_t { return declared; }
+
+    private:
+        /// Bytes encrypted and checksummed in one go
+        static constexpr std::size_t runBytes = std::size_t{16} << 10;
+
+        std::istream& in;
+        std::vector<unsigned char> window;
+        uint64_t windowStart = 0;
+        uint64_t declared;
+        uint32_t checksum = 0;
+        std::optional<cipher::Sealer> sealer;
+        bool ended = false;
+    };
+
+    /**
+     * @brief Finding size of the payload stream without reading it
+     * @function streamLength
+     * @param in -> payload stream<br>
+     * @details Returns PayloadStream::unknownLength for pipes and terminals, stream is left at its position
+     */
+
+    inline auto streamLength(std::istream& in) -> uint64_t {
+        auto position = in.tellg();
+        if (position < 0 || !in.seekg(0, std::ios::end)) {
+            in.clear();
+            return PayloadStream::unknownLength;
+        }
+        auto end = in.tellg();
+        in.seekg(position);
+        return end >= position ? static_cast<uint64_t>(end - position) : PayloadStream::unknownLength;
+    }
+
+    /**
+     * @brief Finding size of the payload as it will be stored
+     * @function storedLength
+     * @param in -> payload stream<br>
+     * @param compress -> payload is compressed before embedding<br>
+     * @param encrypt -> payload is sealed after compression [cipher prefix and tag are added]<br>
+     * @details Compressed size is found by compressing the payload once [lz::compressedLength], stream is left at
+     *          its position. Returns PayloadStream::unknownLength for pipes and terminals.
+     */
+
+    inline auto storedLength(std::istream& in, bool compress, bool encrypt = false) -> uint64_t {
+        uint64_t length = streamLength(in);
+        if (compress && length != PayloadStream::unknownLength && !lz::compressedLength(in, length))
+            return PayloadStream::unknownLength;
+        return encrypt && length != PayloadStream::unknownLength ? length + cipher::overheadBytes : length;
+    }
+
+    /**
+     * @brief Writing decrypted message
+     * @function writeMessage
+     * @param message -> decrypted message<br>
+     * @param output -> file receiving raw message bytes, "-" for standard output, empty to print the message<br>
+     * @details Raw output is written byte for byte, so binary payloads survive unchanged
+     */
+
+    inline auto writeMessage(const std::vector<unsigned char>& message, const std::string& output) -> bool {
+        if (output.empty()) {
+            std::cout << "Decrypted message: " << std::string(message.begin(), message.end()) << std::endl;
+            return true;
+        }
+        stats::Timer timer(stats::Phase::Write);
+        std::ofstream file;
+        std::ostream* out = &std::cout;
+        if (output != "-") {
+            file.open(output, std::ios::binary);
+            out = &file;
+        }
+        if (!out->write(reinterpret_cast<const char*>(message.data()), static_cast<std::streamsize>(message.size()))
+            || !out->flush()) {
+            std::cerr << "Error writing message! Path provided: " << output << std::endl;
+            return false;
+        }
+        stats::addWritten(message.size());
+        if (output != "-") {
+            file.close();
+            timer.stop();
+            stats::syncFile(output);
+        }
+        return true;
+    }
+
+    /**
+     * @brief Embedding header and payload pulled from the stream into the whole carrier
+     * @function embedMessage
+     * @param carrier -> pixels::RowView over the image(pixel) data<br>
+     * @param carrierBytes -> number of carrier bytes available [less than the view holds for a prefix of it]<br>
+     * @param source -> payload stream, its length does not have to be known<br>
+     * @param plan -> carrier bytes and bits holding the payload<br>
+     * @param length -> number of embedded payload bytes, checksum not included<br>
+     * @param flags -> flags stored in the header [payload::flagCompressed for a compressed stream, flagEncrypted for a sealed one]<br>
+     * @details Payload is pulled in chunks of at most 1 MB and embedded right away together with the checksum
+     *          that follows it in the stream, header is embedded last once the length is known. Returns false
+     *          when payload and checksum do not fit into the carrier.
+     *          Order of a scattered plan does not depend on the payload length, so its chunks are embedded the same
+     *          way, symbol by symbol into their keyed bytes [carrierBytes has to be the whole carrier then].
+     */
+
+    template <typename View>
+    inline auto embedMessage(const View& carrier, uint64_t carrierBytes, PayloadStream& source, const plans::Plan& plan,
+                             uint64_t& length, uint8_t flags = 0) -> bool {
+        constexpr uint64_t chunkBits = uint64_t{8} << 20;
+        const int density = plan.density();
+        uint64_t bit = 0;
+        if (plan.scattered()) {
+            const uint64_t slots = plan.slots(carrierBytes);
+            for (uint64_t symbol = 0; symbol < slots;) {
+                uint64_t available = 0;
+                auto bits = std::min(slots - symbol, chunkBits / density / 8 * 8) * density;
+                stats::Timer read(stats::Phase::Read);
+                const unsigned char* bytes = source.fetch(bit, bits, available);
+                read.stop();
+                if (available == 0) break;
+                stats::Timer timer(stats::Phase::Embed);
+                auto symbols = (available + density - 1) / density;
+                payload::embedScattered(carrier, symbol, symbols, bytes, bit % 8, bit % 8 + available, plan);
+                bit += available;
+                symbol += symbols;
+                if (available < bits) break;
+            }
+        } else {
+            for (uint64_t first = plan.payloadStart(); first < carrierBytes;) {
+                uint64_t available = 0;
+                auto last = std::min(carrierBytes, plan.advance(first, chunkBits / density / 8 * 8));
+                auto bits = plan.bitOf(last) - bit;
+                stats::Timer read(stats::Phase::Read);
+                const unsigned char* bytes = source.fetch(bit, bits, available);
+                read.stop();
+                if (available == 0) break;
+                stats::Timer timer(stats::Phase::Embed);
+
+                /// Every chunk but the last covers a multiple of 8 used bytes, so it starts on a whole payload byte
+                auto used = plan.advance(first, (available + density - 1) / density);
+                payload::forBands(first, used - first, [&](uint64_t bandFirst, uint64_t bandCount) {
+                    carrier.forEachSpan(bandFirst, bandCount, [&](unsigned char* span, uint64_t spanFirst, std::size_t size) {
+                        plan.embed(span, spanFirst, size, bytes, bit % 8 + plan.bitOf(spanFirst) - bit, bit % 8 + available);
+                    });
+                }, plan.bandBytes());
+                bit += available;
+                first = used;
+                if (available < bits) break;
+            }
+        }
+        if (bit % 8 != 0 || source.hasMore(bit)) return false;
+
+        stats::Timer timer(stats::Phase::Embed);
+        length = bit / 8 - payload::checksumBytes;
+        auto headerBytes = payload::serialize(payload::headerOf(plan, length, flags));
+        carrier.forEachSpan(0, std::min<uint64_t>(carrierBytes, plan.headerEnd()),
+                            [&](unsigned char* span, uint64_t first, std::size_t size) {
+            plans::embedHeader(span, first, size, headerBytes.data(), plan.sampleBytes());
+        });
+        return true;
+    }
+
+    /**
+     * @brief Embedding header and payload into pixel rows while they stream from input to output
+     * @function embedRows
+     * @param in -> input stream positioned at the first stored row<br>
+     * @param out -> output stream<br>
+     * @param geometry -> rows of the image, padding of every row is copied unchanged<br>
+     * @param header -> serialized PayloadHeader<br>
+     * @param source -> payload stream, its length has to be known [written in the header before the payload]<br>
+     * @param plan -> carrier bytes and bits holding the payload<br>
+     * @details Rows are read in bands of at most bandBytes [one pooled buffer] and payload is pulled only for the band being written,
+     *          so peak memory depends neither on image size nor on payload size. Carrier index of every band is
+     *          known from its position, so the same bits are placed as by the in-memory encoder.
+     *          Any band may hold any bit of a scattered payload, so it is pulled as a whole before the first band
+     *          and every used byte finds its symbol by the inverse permutation [payload::embedSwept].
+     *          Returns false when a stream ends too early.
+     */
+
+    template <typename Format>
+    inline auto embedRows(std::istream& in, std::ostream& out, const pixels::Geometry<Format>& geometry,
+                          const unsigned char* header, PayloadStream& source, const plans::Plan& plan) -> bool {
+        const uint64_t rows = geometry.rowCount();
+        const uint64_t stride = geometry.rowStride();
+        uint64_t bandRows = std::max<uint64_t>(1, bandBytes / std::max<uint64_t>(stride, 1));
+        auto band = buffers::acquire(static_cast<std::size_t>(std::min(bandRows, rows) * stride));
+        const uint64_t payloadBits = (source.length() + payload::checksumBytes) * 8;
+        const uint64_t payloadEnd = plan.scattered() ? geometry.carrierBytes() : plan.endOf(payloadBits);
+        const unsigned char* whole = nullptr;
+        if (plan.scattered()) {
+            uint64_t available = 0;
+            stats::Timer read(stats::Phase::Read);
+            whole = source.fetch(0, payloadBits, available);
+            if (available < payloadBits) return false;
+        }
+
+        for (uint64_t row = 0; row < rows; row += bandRows) {
+            auto stored = static_cast<std::size_t>(std::min(bandRows, rows - row) * stride);
+            uint64_t first = row * geometry.rowSize();
+            uint64_t count = std::min(bandRows, rows - row) * geometry.rowSize();
+            stats::Timer read(stats::Phase::Read);
+            if (!in.read(reinterpret_cast<char*>(band.data()), static_cast<std::streamsize>(stored))) return false;
+            read.stop();
+            stats::addRead(stored);
+            pixels::RowView<Format> view(band.data(), geometry, first);
+
+            /// Header carrier bytes [first band only]
+            stats::Timer embed(stats::Phase::Embed);
+            view.forEachSpan(first, std::min<uint64_t>(count, std::max(first, plan.headerEnd()) - first),
+                             [&](unsigned char* span, uint64_t spanFirst, std::size_t size) {
+                payload::embedSpan(span, spanFirst, size, header, nullptr, plan, 0);
+            });
+
+            /// Payload carrier bytes of this band
+            uint64_t begin = std::max<uint64_t>(first, plan.payloadStart());
+            uint64_t end = std::min<uint64_t>(first + count, payloadEnd);
+            if (begin < end && plan.scattered()) {
+                payload::forBands(begin, end - begin, [&](uint64_t bandFirst, uint64_t bandCount) {
+                    view.forEachSpan(bandFirst, bandCount, [&](unsigned char* span, uint64_t spanFirst, std::size_t size) {
+                        payload::embedSwept(span, spanFirst, size, whole, payloadBits, plan);
+                    });
+                }, plan.bandBytes());
+            } else if (begin < end) {
+                uint64_t bitOffset = plan.bitOf(begin);
+                uint64_t bits = std::min(plan.bitOf(end), payloadBits) - bitOffset;
+                uint64_t available = 0;
+                embed.stop();
+                const unsigned char* bytes = source.fetch(bitOffset, bits, available);
+                if (available < bits) return false;
+                stats::Timer payloadEmbed(stats::Phase::Embed);
+                payload::forBands(begin, end - begin, [&](uint64_t bandFirst, uint64_t bandCount) {
+                    view.forEachSpan(bandFirst, bandCount, [&](unsigned char* span, uint64_t spanFirst, std::size_t size) {
+                        plan.embed(span, spanFirst, size, bytes, bitOffset % 8 + plan.bitOf(spanFirst) - bitOffset,
+                                   bitOffset % 8 + bits);
+                    });
+                }, plan.bandBytes());
+            }
+            embed.stop();
+            stats::Timer write(stats::Phase::Write);
+            if (!out.write(reinterpret_cast<const char*>(band.data()), static_cast<std::streamsize>(stored))) return false;
+            stats::addWritten(stored);
+        }
+        return true;
+    }
+
+    /**
+     * @brief Extracting message from pixel rows read from the stream
+     * @function extractRows
+     * @param in -> input stream positioned at the first stored row<br>
+     * @param geometry -> rows of the image<br>
+     * @param header -> object of PayloadHeader struct<br>
+     * @param message -> extracted message<br>
+     * @param checksum -> CRC32C of the payload<br>
+     * @param found -> false when the image holds no header<br>
+     * @param key -> key of a scattered payload<br>
+     * @details Header is read from the first rows, then rows are read in bands only until the message is complete,
+     *          the rest of the stream is not touched. Message is returned as stored with its checksum
+     *          [payload::verify checks it, payload::unpack decompresses it], every band checksums the bytes it
+     *          completes. Scattered payload may end in the last row, so every row is read [payload::extractSwept]
+     *          and it is checksummed after that. Reading stops right after the header when the key does not open
+     *          it [payload::unlocks tells it]. Returns false when the stream ends too early.
+     */
+
+    template <typename Format>
+    inline auto extractRows(std::istream& in, const pixels::Geometry<Format>& geometry, PayloadHeader& header,
+                            std::vector<unsigned char>& message, uint32_t& checksum, bool& found,
+                            const scatter::Key& key = {}) -> bool {
+        const uint64_t carrierBytes = geometry.carrierBytes();
+        const uint64_t rows = geometry.rowCount();
+        const uint64_t stride = geometry.rowStride();
+        uint64_t bandRows = std::max<uint64_t>(1, bandBytes / std::max<uint64_t>(stride, 1));
+        auto band = buffers::acquire(static_cast<std::size_t>(std::min(bandRows, rows) * stride));
+        std::array<unsigned char, payload::headerBytes> headerBytes{};
+        plans::Plan plan;
+        constexpr uint64_t headerCarrierBytes = plans::headerCarrierOf<Format>;
+        uint64_t needed = headerCarrierBytes;
+        crc::Part part;
+        found = false;
+
+        for (uint64_t row = 0; row < rows && row * geometry.rowSize() < std::min(needed, carrierBytes); row += bandRows) {
+            auto stored = static_cast<std::size_t>(std::min(bandRows, rows - row) * stride);
+            uint64_t first = row * geometry.rowSize();
+            uint64_t count = std::min(bandRows, rows - row) * geometry.rowSize();
+            stats::Timer read(stats::Phase::Read);
+            if (!in.read(reinterpret_cast<char*>(band.data()), static_cast<std::streamsize>(stored))) return false;
+            read.stop();
+            stats::addRead(stored);
+            pixels::RowView<Format, const unsigned char> view(band.data(), geometry, first);
+
+            /// Collecting header bits, header may span several bands of a narrow image
+            if (!found && first < headerCarrierBytes) {
+                auto headerPart = std::min<uint64_t>(count, headerCarrierBytes - first);
+                view.forEachSpan(first, headerPart, [&](const unsigned char* span, uint64_t spanFirst, std::size_t size) {
+                    plans::extractHeader(span, spanFirst, size, headerBytes.data(), Format::sampleBytes);
+                });
+                if (first + headerPart < headerCarrierBytes) continue;
+                if (!payload::parse(headerBytes.data(), header) || !payload::planOf<Format>(header, plan)
+                    || !payload::fits(header, plan, carrierBytes)) return true;
+                found = true;
+                if (!payload::unlocks(header, key)) return true;
+                if (header.flags & payload::flagScattered) plan.scatterBy(key, carrierBytes);
+                needed = plan.scattered() ? carrierBytes : payload::carrierBytesNeeded(header, plan);
+                message.assign(static_cast<std::size_t>(payload::storedBytes(header)), 0);
+            }
+            stats::Timer timer(stats::Phase::Extract);
+            if (plan.scattered()) {
+                payload::forBands(first, count, [&](uint64_t bandFirst, uint64_t bandCount) {
+                    view.forEachSpan(bandFirst, bandCount, [&](const unsigned char* span, uint64_t spanFirst, std::size_t size) {
+                        payload::extractSwept(span, spanFirst, size, message.data(), header, plan);
+                    });
+                }, plan.bandBytes());
+                continue;
+            }
+            part = crc::join(part, payload::extractRange(view, first, count, message.data(), header, plan));
+        }
+        checksum = plan.scattered() ? crc::update(0, message.data(), static_cast<std::size_t>(header.length)) : part.value;
+        return true;
+    }
+}
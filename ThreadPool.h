@@ -0,0 +1,188 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdlib>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @class ThreadPool
+ * @brief Fixed set of worker threads sharing tasks by work stealing
+ * @var
+ * <b>queues</b> -> one task queue per worker<br>
+ * <b>workers</b> -> worker threads<br>
+ * <b>queued</b> -> number of tasks waiting in all queues<br>
+ * <b>pending</b> -> number of tasks submitted and not finished yet<br>
+ * <b>stopping</b> -> set by the destructor, workers leave once it is set
+ * @details Every worker takes tasks from the back of its own queue and, when it is empty, steals from the front
+ *          of the other queues, so long jobs on one worker do not leave the others idle. Tasks submitted from the
+ *          outside are spread round-robin, tasks submitted by a worker go to its own queue.
+ * @attention Tasks must not throw, wait() must not be called from a worker [use forEach() there]
+ */
+
+class ThreadPool {
+public:
+    explicit ThreadPool(std::size_t threads = std::thread::hardware_concurrency()) {
+        threads = std::max<std::size_t>(threads, 1);
+        for (std::size_t i = 0; i < threads; ++i) queues.push_back(std::make_unique<Queue>());
+        for (std::size_t i = 0; i < threads; ++i) workers.emplace_back([this, i] { work(i); });
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    auto operator=(const ThreadPool&) -> ThreadPool& = delete;
+
+    ~ThreadPool() {
+        {
+            std::lock_guard lock(mutex);
+            stopping = true;
+        }
+        available.notify_all();
+        for (auto& worker : workers) worker.join();
+    }
+
+    /**
+     * @brief Adding task to the pool
+     * @function submit
+     * @param task -> callable without arguments<br>
+     */
+
+    auto submit(std::function<void()> task) -> void {
+        pending.fetch_add(1);
+        std::size_t index = current.pool == this ? current.index : next.fetch_add(1) % queues.size();
+        {
+            std::lock_guard lock(mutex);
+            ++queued; // counted before the push, so take() never sees more tasks than queued
+        }
+        {
+            std::lock_guard lock(queues[index]->mutex);
+            queues[index]->tasks.push_back(std::move(task));
+        }
+        available.notify_one();
+    }
+
+    /// Blocking until every submitted task is finished
+    auto wait() -> void {
+        std::unique_lock lock(mutex);
+        finished.wait(lock, [this] { return pending.load() == 0; });
+    }
+
+    /**
+     * @brief Running body(0) .. body(count - 1) on the pool and waiting for them
+     * @function forEach
+     * @param count -> number of calls<br>
+     * @param body -> callable taking index of the call<br>
+     * @details Calling thread runs queued tasks while there are any, so forEach() can be used from inside of
+     *          another task [e.g. a batch job splitting its image into bands] without blocking a worker. Once
+     *          nothing is left to take, it sleeps until the last call of its own finishes.
+     */
+
+    auto forEach(std::size_t count, const std::function<void(std::size_t)>& body) -> void {
+        std::atomic<std::size_t> left{count};
+        for (std::size_t i = 0; i < count; ++i) {
+            submit([this, &body, &left, i] {
+                body(i);
+                if (left.fetch_sub(1) == 1) {
+                    std::lock_guard lock(mutex);
+                    finished.notify_all();
+                }
+            });
+        }
+        std::size_t index = current.pool == this ? current.index : 0;
+        std::function<void()> task;
+        while (left.load() > 0 && take(index, task)) run(task);
+
+        /// Remaining calls are running on other threads, the last of them wakes the caller
+        std::unique_lock lock(mutex);
+        finished.wait(lock, [&left] { return left.load() == 0; });
+    }
+
+    /**
+     * @brief Pool shared by the whole process
+     * @function shared
+     * @details Sized to the number of cores, STEG_THREADS environment variable overrides it
+     */
+
+    static auto shared() -> ThreadPool& {
+        static ThreadPool pool([] {
+            const char* forced = std::getenv("STEG_THREADS");
+            return forced ? static_cast<std::size_t>(std::strtoul(forced, nullptr, 10))
+                          : std::size_t(std::thread::hardware_concurrency());
+        }());
+        return pool;
+    }
+
+    auto size() const -> std::size_t { return workers.size(); }
+
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    /// Worker currently running on this thread [pool and queue index]
+    struct Worker {
+        const ThreadPool* pool;
+        std::size_t index;
+    };
+    static inline thread_local Worker current{nullptr, 0};
+
+    /// Taking next task [own queue first, then stealing from the others]
+    auto take(std::size_t index, std::function<void()>& task) -> bool {
+        for (std::size_t i = 0; i < queues.size(); ++i) {
+            auto& queue = *queues[(index + i) % queues.size()];
+            std::lock_guard lock(queue.mutex);
+            if (queue.tasks.empty()) continue;
+            if (i == 0) {
+                task = std::move(queue.tasks.back());
+                queue.tasks.pop_back();
+            } else {
+                task = std::move(queue.tasks.front());
+                queue.tasks.pop_front();
+            }
+            queued.fetch_sub(1);
+            return true;
+        }
+        return false;
+    }
+
+    /// Running taken task and marking it as finished
+    auto run(std::function<void()>& task) -> void {
+        task();
+        task = nullptr;
+        if (pending.fetch_sub(1) == 1) {
+            std::lock_guard lock(mutex);
+            finished.notify_all();
+        }
+    }
+
+    auto work(std::size_t index) -> void {
+        current = {this, index};
+        std::function<void()> task;
+        while (true) {
+            if (take(index, task)) {
+                run(task);
+                continue;
+            }
+            std::unique_lock lock(mutex);
+            available.wait(lock, [this] { return stopping || queued.load() > 0; });
+            if (stopping && queued.load() == 0) return;
+        }
+    }
+
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable available;
+    std::condition_variable finished;
+    std::atomic<std::size_t> queued{0};
+    std::atomic<std::size_t> pending{0};
+    std::atomic<std::size_t> next{0};
+    bool stopping = false;
+};
@@ -0,0 +1,343 @@
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <iterator>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "BitStream.h"
+#include "Checksum.h"
+#include "Cipher.h"
+#include "Compression.h"
+#include "FileReadOrWrite.h"
+#include "LSBKernels.h"
+#include "PayloadHeader.h"
+#include "Scatter.h"
+
+/**
+ * @file benchmark.cpp
+ * @brief Microbenchmark of the hot loops behind encrypt/decrypt
+ * @details Measures over synthetic in-memory images [no file I/O]:<br>
+ *              &emsp;&emsp;- embed/extract kernels of every instruction set the processor supports<br>
+ *              &emsp;&emsp;- whole message embed/extract [PayloadHeader, active kernel, row bands on the shared pool, keyed scatter]<br>
+ *              &emsp;&emsp;- bit packing [BitReader/BitWriter] and payload checksum [CRC32C, crc32 instruction and slicing-by-8]<br>
+ *              &emsp;&emsp;- payload cipher [ChaCha20 keystream of every instruction set, Poly1305, sealing, key derivation]<br>
+ *              &emsp;&emsp;- payload compression [lz, text-like payload]<br>
+ *              &emsp;&emsp;- header parsing [PayloadHeader, PPM header] and plain raster text [netpbm::PlainScanner]<br>
+ *          Usage: StegBenchmark [-mp 1,10,50,200] [-bits 1,2,4]<br>
+ *          Every result is the best of several runs, reported as MB/s of image(pixel) data and ns per pixel
+ *          [3 bytes]. Build with -DCMAKE_BUILD_TYPE=Release, numbers of an unoptimized build are meaningless.
+ */
+
+namespace {
+
+    /// Result of the benchmarked function is folded in here, so the compiler can not drop the work
+    volatile uint64_t sink = 0;
+
+    /**
+     * @brief Measuring the best time of a function
+     * @function bestOf
+     * @param body -> measured function<br>
+     * @details Function is repeated until 0.3 s are spent [at least twice, at most 20 times]
+     */
+
+    auto bestOf(const std::function<void()>& body) -> double {
+        using clock = std::chrono::steady_clock;
+        double best = 1e30, total = 0;
+        for (int run = 0; run < 20 && (run < 2 || total < 0.3); ++run) {
+            auto start = clock::now();
+            body();
+            double seconds = std::chrono::duration<double>(clock::now() - start).count();
+            best = std::min(best, seconds);
+            total += seconds;
+        }
+        return best;
+    }
+
+    auto report(const std::string& name, const std::string& variant, uint64_t pixels, int density, double seconds) -> void {
+        double bytes = pixels * 3.0;
+        std::printf("%-10s %-8s %8.1f MP  %d bit  %10.1f MB/s  %8.3f ns/pixel\n", name.c_str(), variant.c_str(),
+                    pixels / 1e6, density, bytes / seconds / 1e6, seconds * 1e9 / pixels);
+    }
+
+    auto parseList(const std::string& text) -> std::vector<double> {
+        std::vector<double> values;
+        std::stringstream in(text);
+        for (std::string item; std::getline(in, item, ',');) values.push_back(std::stod(item));
+        return values;
+    }
+
+    auto randomBytes(std::size_t size, uint64_t seed) -> std::vector<unsigned char> {
+        std::vector<unsigned char> bytes(size);
+        std::mt19937_64 random(seed);
+        for (std::size_t i = 0; i + 8 <= size; i += 8) {
+            uint64_t value = random();
+            std::memcpy(bytes.data() + i, &value, 8);
+        }
+        return bytes;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    std::vector<double> megapixels{1, 10, 50, 200};
+    std::vector<double> densities{1, 2, 4};
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string arg = argv[i];
+        if (arg == "-mp") megapixels = parseList(argv[i + 1]);
+        else if (arg == "-bits") densities = parseList(argv[i + 1]);
+    }
+#if (defined(__GNUC__) && !defined(__OPTIMIZE__)) || defined(_DEBUG)
+    std::cerr << "Warning! Benchmark is built without optimizations." << std::endl;
+#endif
+
+    /// Kernels supported by this processor [selectKernel falls back when one is not supported]
+    std::vector<kernels::Kernel> available;
+    for (const char* name : {"scalar", "sse2", "avx2", "avx512"}) {
+        auto kernel = kernels::selectKernel(name);
+        if (std::string(kernel.name) == name) available.push_back(kernel);
+    }
+    std::cout << "Active kernel: " << kernels::active().name << ", threads: " << ThreadPool::shared().size() << std::endl;
+
+    for (double mp : megapixels) {
+        auto pixels = static_cast<uint64_t>(mp * 1e6);
+        auto carrierBytes = static_cast<std::size_t>(pixels * 3);
+        auto carrier = randomBytes(carrierBytes, 1);
+        auto message = randomBytes(carrierBytes, 2); // enough for 8 bits per carrier byte
+        std::vector<unsigned char> extracted(carrierBytes);
+
+        for (double bits : densities) {
+            int density = static_cast<int>(bits);
+            std::cout << std::endl;
+
+            /// Kernels alone
+            for (const auto& kernel : available) {
+                report("embed", kernel.name, pixels, density, bestOf([&] {
+                    kernel.embed(carrier.data(), carrierBytes, message.data(), 0, density);
+                    sink = sink + carrier[carrierBytes / 2];
+                }));
+                report("extract", kernel.name, pixels, density, bestOf([&] {
+                    kernel.extract(carrier.data(), carrierBytes, extracted.data(), 0, density);
+                    sink = sink + extracted[0];
+                }));
+            }
+
+            /// Whole message with PayloadHeader [what encrypt/decrypt run on pixel data]
+            uint64_t length = payload::capacity(carrierBytes, density);
+            report("message", "embed", pixels, density, bestOf([&] {
+                payload::embedMessage(pixels::contiguous(carrier.data(), carrierBytes), message.data(), length, plans::Plan(density));
+            }));
+            PayloadHeader header;
+            std::vector<unsigned char> result;
+            uint32_t checksum = 0;
+            report("message", "extract", pixels, density, bestOf([&] {
+                payload::extractMessage(pixels::contiguous(carrier.data(), carrierBytes), header, result, checksum);
+                sink = sink + result.size();
+            }));
+
+            /// Some channels only [kernel instance of the plan, whole pixels per iteration]
+            pixels::RowView<pixels::PPM24> image(carrier.data(), pixels::Geometry<pixels::PPM24>(pixels, 1));
+            for (uint8_t channels : {plans::red, static_cast<uint8_t>(plans::red | plans::green)}) {
+                plans::Plan plan;
+                if (!plans::Plan::of<pixels::PPM24>(density, channels, plan)) continue;
+                const char* name = channels == plans::red ? "plan r" : "plan rg";
+                report(name, "embed", pixels, density, bestOf([&] {
+                    payload::embedMessage(image, message.data(), payload::capacityOf(plan, carrierBytes), plan);
+                }));
+                report(name, "extract", pixels, density, bestOf([&] {
+                    payload::extractMessage(image, header, result, checksum);
+                    sink = sink + result.size();
+                }));
+            }
+
+            /// Wide pixels over the same bytes [32-bit BMP without alpha, low bytes of 16-bit PPM samples]
+            auto wide = [&](const char* name, const auto& view) {
+                using Format = typename std::decay_t<decltype(view)>::format;
+                plans::Plan plan;
+                if (!plans::Plan::of<Format>(density, plans::allChannels, plan)) return;
+                report(name, "embed", pixels, density, bestOf([&] {
+                    payload::embedMessage(view, message.data(), payload::capacityOf(plan, view.carrierBytes()), plan);
+                }));
+                report(name, "extract", pixels, density, bestOf([&] {
+                    payload::extractMessage(view, header, result, checksum);
+                    sink = sink + result.size();
+                }));
+            };
+            wide("plan bgra", pixels::RowView<pixels::BMP32>(carrier.data(), pixels::Geometry<pixels::BMP32>(carrierBytes / 4, 1)));
+            wide("plan rgb48", pixels::RowView<pixels::PPM48>(carrier.data(), pixels::Geometry<pixels::PPM48>(carrierBytes / 6, 1)));
+
+            /// Payload scattered by a key [every symbol walks the keyed permutation, see Scatter.h]
+            const scatter::Key key("benchmark");
+            plans::Plan keyed(density);
+            keyed.scatterBy(key, carrierBytes);
+            report("plan keyed", "embed", pixels, density, bestOf([&] {
+                payload::embedMessage(pixels::contiguous(carrier.data(), carrierBytes), message.data(), payload::capacityOf(keyed, carrierBytes), keyed);
+            }));
+            report("plan keyed", "extract", pixels, density, bestOf([&] {
+                payload::extractMessage(pixels::contiguous(carrier.data(), carrierBytes), header, result, checksum, key);
+                sink = sink + result.size();
+            }));
+        }
+
+        /// Bit packing [density 2 chunks, as the scalar kernel reads them]
+        std::cout << std::endl;
+        report("bitreader", "read", pixels, 2, bestOf([&] {
+            bits::BitReader reader(message.data(), carrierBytes / 4);
+            uint64_t sum = 0;
+            for (std::size_t i = 0; i < carrierBytes; ++i) sum += reader.read(2);
+            sink = sink + sum;
+        }));
+        report("bitwriter", "write", pixels, 2, bestOf([&] {
+            bits::BitWriter writer(extracted.data());
+            for (std::size_t i = 0; i < carrierBytes; ++i) writer.write(carrier[i], 2);
+            writer.flush();
+            sink = sink + extracted[0];
+        }));
+
+        /// Payload checksum [MB/s of checksummed bytes]
+        std::pair<const char*, crc::UpdateFn> checksums[] = {{crc::activeName(), crc::active()}, {"slicing-by-8", crc::updateTable}};
+        for (auto [name, update] : checksums) {
+            double seconds = bestOf([&] { sink = sink + update(~0u, message.data(), carrierBytes); });
+            std::printf("%-18s %8.1f MB/s\n", (std::string("crc32c ") + name).c_str(), carrierBytes / seconds / 1e6);
+            if (update == crc::updateTable) break;
+        }
+
+        /// Payload cipher [MB/s of encrypted bytes], sealing is what PayloadStream does to every run of a secret payload
+        std::vector<std::pair<const char*, cipher::XorFn>> ciphers;
+#if defined(STEG_X86)
+        const kernels::CpuFeatures cpu = kernels::detectCpu();
+        if (cpu.avx2) ciphers.push_back({"avx2", cipher::xorAVX2});
+        if (cpu.sse2) ciphers.push_back({"sse2", cipher::xorSSE2});
+#endif
+        ciphers.push_back({"scalar", cipher::xorScalar});
+        const std::size_t cipherBlocks = carrierBytes / 64;
+        std::vector<uint32_t> state(16, 0x01234567u);
+        for (auto [name, apply] : ciphers) {
+            double seconds = bestOf([&] {
+                apply(state.data(), message.data(), extracted.data(), cipherBlocks);
+                sink = sink + extracted[0];
+            });
+            std::printf("%-18s %8.1f MB/s\n", (std::string("chacha20 ") + name).c_str(), cipherBlocks * 64 / seconds / 1e6);
+        }
+        std::array<unsigned char, cipher::keyBytes> key{};
+        double mac = bestOf([&] {
+            cipher::Poly1305 poly(key.data());
+            poly.update(message.data(), carrierBytes);
+            sink = sink + poly.finish()[0];
+        });
+        std::printf("%-18s %8.1f MB/s\n", "poly1305", carrierBytes / mac / 1e6);
+        double seal = bestOf([&] {
+            cipher::Aead aead(key, key.data(), key.size());
+            aead.encrypt(extracted.data(), carrierBytes);
+            sink = sink + aead.tag()[0];
+        });
+        std::printf("%-18s %8.1f MB/s\n", (std::string("seal ") + cipher::active().name).c_str(), carrierBytes / seal / 1e6);
+    }
+
+    /// Key derivation of a secret payload [once per encrypt and once per decrypt]
+    std::cout << std::endl;
+    {
+        std::array<unsigned char, cipher::saltBytes> salt{};
+        double derive = bestOf([&] { sink = sink + cipher::deriveKey("passphrase", salt.data(), cipher::defaultCost)[0]; });
+        std::printf("%-18s %8.1f ms per key\n", "pbkdf2-sha256", derive * 1e3);
+    }
+
+    /// Payload compression [text-like payload, MB/s of the uncompressed payload]
+    std::cout << std::endl;
+    {
+        std::string text;
+        std::mt19937_64 random(4);
+        const char* words[] = {"{\"id\":", "\"name\":", "\"value\":", "true", "false", "null", "steganography",
+                               "carrier", "payload", "},", "[", "]", " ", "\n"};
+        while (text.size() < (std::size_t{32} << 20)) {
+            text += words[random() % 14];
+            text += std::to_string(random() % 1000);
+        }
+        std::istringstream source(text);
+        lz::CompressBuffer buffer(source);
+        std::string packed(std::istreambuf_iterator<char>(&buffer), {});
+        std::vector<unsigned char> unpacked;
+        double compress = bestOf([&] {
+            std::istringstream in(text);
+            lz::CompressBuffer compressor(in);
+            std::vector<char> chunk(lz::blockBytes);
+            while (compressor.sgetn(chunk.data(), static_cast<std::streamsize>(chunk.size())) > 0) {}
+        });
+        double decompress = bestOf([&] {
+            lz::decompress(reinterpret_cast<const unsigned char*>(packed.data()), packed.size(), unpacked);
+            sink = sink + unpacked.size();
+        });
+        bool same = unpacked.size() == text.size() && std::memcmp(unpacked.data(), text.data(), text.size()) == 0;
+        std::printf("%-18s %8.1f MB/s  ratio %.2f%s\n", "lz compress", text.size() / compress / 1e6,
+                    double(text.size()) / packed.size(), same ? "" : "  [MISMATCH]");
+        std::printf("%-18s %8.1f MB/s\n", "lz decompress", text.size() / decompress / 1e6);
+    }
+
+    /// Header parsing [per call]
+    std::cout << std::endl;
+    constexpr int calls = 1000000;
+    PayloadHeader header;
+    header.length = 12345;
+    auto headerCarrier = randomBytes(payload::headerCarrierBytes, 3);
+    auto headerBytes = payload::serialize(header);
+    kernels::embed(headerCarrier.data(), headerCarrier.size(), headerBytes.data(), 0, 1);
+    double seconds = bestOf([&] {
+        for (int i = 0; i < calls; ++i) {
+            PayloadHeader parsed;
+            payload::readHeader(pixels::contiguous(headerCarrier.data(), headerCarrier.size()), parsed);
+            sink = sink + parsed.length;
+        }
+    });
+    std::printf("%-18s %8.1f ns/call\n", "payload header", seconds * 1e9 / calls);
+
+    const std::string ppmHeader = "P6\n1920 1080\n255\n";
+    seconds = bestOf([&] {
+        for (int i = 0; i < calls; ++i) {
+            PPM_FileHeader parsed;
+            std::size_t offset = 0;
+            ppm::readPPMHeader(reinterpret_cast<const unsigned char*>(ppmHeader.data()), ppmHeader.size(), parsed, offset);
+            sink = sink + offset;
+        }
+    });
+    std::printf("%-18s %8.1f ns/call\n", "ppm header", seconds * 1e9 / calls);
+
+    /// Plain raster text [P3 numbers of random samples, MB/s of the text]
+    {
+        PPM_FileHeader plain;
+        plain.magic_number = "P3";
+        plain.width = 1000;
+        plain.height = 1000;
+        plain.max_color_val = 255;
+        auto samples = randomBytes(std::size_t(plain.width) * plain.height * 3, 5);
+        std::ostringstream text;
+        {
+            netpbm::PlainWriter writer(text, 1);
+            writer.sputn(reinterpret_cast<const char*>(samples.data()), static_cast<std::streamsize>(samples.size()));
+            writer.finish();
+        }
+        const std::string raster = text.str();
+        std::vector<unsigned char> parsed(samples.size());
+        bool same = false;
+        double parse = bestOf([&] {
+            same = netpbm::readPlain(reinterpret_cast<const unsigned char*>(raster.data()), raster.size(), plain, parsed.data())
+                   && parsed == samples;
+        });
+        double write = bestOf([&] {
+            std::ostringstream out;
+            netpbm::PlainWriter writer(out, 1);
+            writer.sputn(reinterpret_cast<const char*>(samples.data()), static_cast<std::streamsize>(samples.size()));
+            writer.finish();
+            sink = sink + out.tellp();
+        });
+        std::printf("%-18s %8.1f MB/s%s\n", "netpbm plain parse", raster.size() / parse / 1e6, same ? "" : "  [MISMATCH]");
+        std::printf("%-18s %8.1f MB/s\n", "netpbm plain write", raster.size() / write / 1e6);
+    }
+    return 0;
+}
@@ -1,10 +1,169 @@
 #include <iostream>
+#include <fstream>
 #include <regex>
+#include <sstream>
+#if defined(_WIN32)
+#include <fcntl.h>
+#include <io.h>
+#endif
 
+#include "Steg.h"
 #include "MainFunctions.h"
+#include "Batch.h"
+#include "CarrierIndex.h"
+#include "Daemon.h"
+#include "Stats.h"
+
+/**
+ * @brief Switching standard input and output into binary mode
+ * @function useBinaryStdio
+ * @details Images are streamed through stdin/stdout byte by byte, text mode would translate line endings on Windows
+ */
+
+auto useBinaryStdio() -> void {
+#if defined(_WIN32)
+    _setmode(_fileno(stdin), _O_BINARY);
+    _setmode(_fileno(stdout), _O_BINARY);
+#endif
+}
+
+/**
+ * @brief Opening message given on the command line
+ * @function openPayload
+ * @param msg -> message argument, or --payload-file followed by a path ["-" for standard input]<br>
+ * @param argc, argv, i -> command line, i is moved past the path of the payload file<br>
+ * @param text -> stream used for a message given as argument<br>
+ * @param file -> stream used for a payload file<br>
+ * @details Returns nullptr when payload file cannot be opened
+ */
+
+auto openPayload(const std::string& msg, int argc, char* argv[], int& i,
+                 std::istringstream& text, std::ifstream& file) -> std::istream* {
+    if(msg != "--payload-file"){
+        text.str(msg);
+        return &text;
+    }
+    if(i + 1 >= argc){
+        std::cerr << "Path of the payload file was not provided!" << std::endl;
+        return nullptr;
+    }
+    std::string path = argv[++i];
+    if(path == "-"){
+        useBinaryStdio();
+        return &std::cin;
+    }
+    file.open(path, std::ios::binary);
+    if(!file){
+        std::cerr << "Unable to open file! Path provided: " << path << std::endl;
+        return nullptr;
+    }
+    return &file;
+}
+
+/**
+ * @brief Reading optional output of decrypt
+ * @function decryptOutput
+ * @details Returns path following -o OR -out anywhere after the image, empty when it is not given [message is printed].
+ *          Values of -key, -passphrase and -keyfile are skipped, so they are never taken for the option.
+ */
+
+auto decryptOutput(int argc, char* argv[], int i) -> std::string {
+    for (int j = i + 1; j + 1 < argc; ++j) {
+        std::string option = argv[j];
+        if(option == "-o" || option == "-out"){
+            if(std::string(argv[j + 1]) == "-") useBinaryStdio();
+            return argv[j + 1];
+        }
+        if(option == "-key" || option == "-passphrase" || option == "-keyfile") ++j;
+    }
+    return "";
+}
+
+/**
+ * @brief Exit code of decrypt
+ * @function exitCodeOf
+ * @details 0 when the message is written, 2 when it does not match its checksum, 1 on any other error
+ */
+
+auto exitCodeOf(steg::Status status) -> int {
+    if(status == steg::Status::Ok) return 0;
+    return status == steg::Status::ChecksumMismatch ? 2 : 1;
+}
+
+/// Checking whether an option without a value [e.g. --compress] is among the arguments
+auto hasOption(int argc, char* argv[], const std::string& option) -> bool {
+    for (int i = 1; i < argc; ++i) {
+        if(option == argv[i]) return true;
+    }
+    return false;
+}
+
+/**
+ * @brief Reading options of encrypt, -s and check given anywhere among the arguments
+ * @function encodeOptions
+ * @param options -> --compress, -bits N [1..4], -channels made of letters r, g, b, a [alpha of 32-bit BMP], -key text and
+ *                   -passphrase text or -keyfile path [whole file is the secret]<br>
+ * @details Returns false when a value is out of range [reason is printed]
+ */
+
+auto encodeOptions(int argc, char* argv[], steg::EncodeOptions& options) -> bool {
+    options.compress = hasOption(argc, argv, "--compress");
+    for (int i = 1; i + 1 < argc; ++i) {
+        std::string option = argv[i];
+        std::string value = argv[i + 1];
+        if(option == "-bits"){
+            options.density = value.size() == 1 && value[0] >= '1' && value[0] <= '4' ? value[0] - '0' : -1;
+            if(options.density < 0){
+                std::cerr << "Number of bits has to be 1, 2, 3 or 4! Value provided: " << value << std::endl;
+                return false;
+            }
+        }else if(option == "-channels"){
+            options.channels = 0;
+            for (char letter : value) {
+                options.channels |= letter == 'r' ? plans::red : letter == 'g' ? plans::green : letter == 'b' ? plans::blue
+                                   : letter == 'a' ? plans::alpha : 0x80;
+            }
+            if(options.channels == 0 || (options.channels & ~(plans::allChannels | plans::alpha))){
+                std::cerr << "Channels have to be made of letters r, g, b, a! Value provided: " << value << std::endl;
+                return false;
+            }
+        }else if(option == "-key"){
+            if(value.empty()){
+                std::cerr << "Key can not be empty!" << std::endl;
+                return false;
+            }
+            options.key = value;
+        }else if(option == "-passphrase" || option == "-keyfile"){
+            if(!options.secret.empty()){
+                std::cerr << "Use either -passphrase or -keyfile, not both!" << std::endl;
+                return false;
+            }
+            if(option == "-keyfile"){
+                std::ifstream keyfile(value, std::ios::binary);
+                std::ostringstream contents;
+                contents << keyfile.rdbuf();
+                value = keyfile ? contents.str() : std::string();
+            }
+            if(value.empty()){
+                if(option == "-keyfile") std::cerr << "Keyfile can not be read or is empty! Path provided: " << argv[i + 1] << std::endl;
+                else std::cerr << "Passphrase can not be empty!" << std::endl;
+                return false;
+            }
+            options.secret = value;
+        }
+    }
+    return true;
+}
 
 int main(int argc, char* argv[]) {
-    std::regex bmp_pattern(".*\\.bmp$"), ppm_pattern(".*\\.ppm$");
+    /// Measurements of --stats, printed as JSON on std::cerr when main returns
+    stats::Session session(argc, argv);
+    std::regex bmp_pattern(".*\\.bmp$"), ppm_pattern(".*\\.(ppm|pgm|pnm|pam)$");
+    /// Files written by -e, -s and -batch are flushed to the device only when --fsync is given
+    stats::syncRequested() = hasOption(argc, argv, "--fsync");
+    steg::EncodeOptions options;
+    if(!encodeOptions(argc, argv, options)) return 1;
+    const steg::DecodeOptions decodeOptions{options.key, options.secret};
     for (int i = 0; i < argc; ++i) {
         std::string arg = argv[i];
         if(arg == "-i" || arg == "-info" && i + 1 < argc){
@@ -16,23 +175,120 @@ int main(int argc, char* argv[]) {
         }else if(arg == "-e" || arg == "-encrypt" && i + 2 < argc){
             std::string path = argv[++i];
             std::string msg = argv[++i];
-            if(std::regex_match(path, bmp_pattern)) bmp::encrypt(path, msg);
-            else if(std::regex_match(path, ppm_pattern)) ppm::encrypt(path, msg);
+            std::istringstream text;
+            std::ifstream file;
+            std::istream* payload = openPayload(msg, argc, argv, i, text, file);
+            if(!payload) return 1;
+            if(std::regex_match(path, bmp_pattern)) bmp::encrypt(path, *payload, options);
+            else if(std::regex_match(path, ppm_pattern)) ppm::encrypt(path, *payload, options);
             else std::cerr << "Incorrect file type provided! Try using -h OR -help flag to get help information." << std::endl;
             return 0;
         }else if(arg == "-d" || arg == "-decrypt" && i + 1 < argc){
             std::string path = argv[++i];
-            if(std::regex_match(path, bmp_pattern)) bmp::decrypt(path);
-            else if(std::regex_match(path, ppm_pattern)) ppm::decrypt(path);
-            else std::cerr << "Incorrect file type provided! Try using -h OR -help flag to get help information." << std::endl;
+            std::string output = decryptOutput(argc, argv, i);
+            if(path == "-"){
+                /// Reading image from standard input, format is recognized by its magic number ['BM' - .bmp, 'P2'..'P7' - .pgm, .ppm, .pam]
+                useBinaryStdio();
+                std::vector<unsigned char> message;
+                steg::Status status = steg::decodeStream(std::cin, message, decodeOptions);
+                if(status != steg::Status::Ok){
+                    std::cerr << "Error! " << steg::describe(status) << "." << std::endl;
+                    return exitCodeOf(status);
+                }
+                return stream::writeMessage(message, output) ? 0 : 1;
+            }
+            if(std::regex_match(path, bmp_pattern)) return exitCodeOf(bmp::decrypt(path, output, decodeOptions));
+            if(std::regex_match(path, ppm_pattern)) return exitCodeOf(ppm::decrypt(path, output, decodeOptions));
+            std::cerr << "Incorrect file type provided! Try using -h OR -help flag to get help information." << std::endl;
+            return 1;
+        }else if((arg == "-s" || arg == "-stream") && i + 3 < argc){
+            std::string input = argv[++i];
+            std::string msg = argv[++i];
+            std::istringstream text;
+            std::ifstream file;
+            std::istream* payload = openPayload(msg, argc, argv, i, text, file);
+            if(!payload || i + 1 >= argc) return 1;
+            std::string output = argv[++i];
+            useBinaryStdio();
+            if(input == "-" && payload == &std::cin){
+                std::cerr << "Image and payload can not both be read from standard input!" << std::endl;
+                return 1;
+            }
+
+            /// Opening input and output ["-" stands for standard input/output]
+            std::ifstream inputFile;
+            std::ofstream outputFile;
+            std::istream* in = &std::cin;
+            std::ostream* out = &std::cout;
+            if(input != "-"){
+                inputFile.open(input, std::ios::binary);
+                in = &inputFile;
+            }
+            if(output != "-"){
+                outputFile.open(output, std::ios::binary);
+                out = &outputFile;
+            }
+            if(!*in || !*out){
+                std::cerr << "Unable to open file! Paths provided: " << input << ", " << output << std::endl;
+                return 1;
+            }
+
+            /// Embedding band by band, format is recognized by its magic number [status goes to std::cerr, std::cout may carry the image]
+            steg::Status status = steg::encodeStream(*in, *out, *payload, options);
+            if(status != steg::Status::Ok){
+                std::cerr << "Error! " << steg::describe(status) << "." << std::endl;
+                return 1;
+            }
+            if(output != "-"){
+                outputFile.close();
+                stats::syncFile(output);
+            }
+            std::cerr << "Message is successfully encrypted!" << std::endl;
             return 0;
         }else if(arg == "-c" || arg == "-check" && i + 2 < argc){
             std::string path = argv[++i];
             std::string msg = argv[++i];
-            if(std::regex_match(path, bmp_pattern)) bmp::check(path, msg);
-            else if(std::regex_match(path, ppm_pattern)) ppm::check(path, msg);
+            if(std::regex_match(path, bmp_pattern)) bmp::check(path, msg, options);
+            else if(std::regex_match(path, ppm_pattern)) ppm::check(path, msg, options);
             else std::cerr << "Incorrect file type provided! Try using -h OR -help flag to get help information." << std::endl;
             return 0;
+        }else if((arg == "-b" || arg == "-batch") && i + 1 < argc){
+            /// Running every job of the manifest in this process [--fsync, -depth N]
+            std::string manifest = argv[++i];
+            batch::Options pipeline;
+            pipeline.fsync = stats::syncRequested();
+            for(++i; i + 1 < argc; ++i){
+                if(std::string(argv[i]) == "-depth") pipeline.depth = std::max<std::size_t>(1, std::strtoul(argv[i + 1], nullptr, 10));
+            }
+            return batch::run(manifest, pipeline) ? 0 : 1;
+        }else if(arg == "-daemon" && i + 1 < argc){
+            /// Serving requests over a Unix domain socket [-workers N, -cache MB]
+            std::string socket = argv[++i];
+            std::size_t workers = std::thread::hardware_concurrency();
+            std::size_t cacheMegabytes = 256;
+            for(++i; i + 1 < argc; i += 2){
+                std::string option = argv[i];
+                if(option == "-workers") workers = std::strtoul(argv[i + 1], nullptr, 10);
+                else if(option == "-cache") cacheMegabytes = std::strtoul(argv[i + 1], nullptr, 10);
+            }
+            return server::run(socket, workers, cacheMegabytes << 20) ? 0 : 1;
+        }else if(arg == "-index" && i + 1 < argc){
+            /// Probing headers of all carriers in the directory
+            return catalog::index(argv[++i]) ? 0 : 1;
+        }else if(arg == "-pick" && i + 2 < argc){
+            /// Choosing the smallest carrier for the message from the index
+            std::string directory = argv[++i];
+            std::string msg = argv[++i];
+            std::istringstream text;
+            std::ifstream file;
+            std::istream* payload = openPayload(msg, argc, argv, i, text, file);
+            if(!payload) return 1;
+            uint64_t size = stream::streamLength(*payload);
+            if(size == stream::PayloadStream::unknownLength){
+                std::cerr << "Size of the message is not known, read it from a file!" << std::endl;
+                return 1;
+            }
+            return catalog::pick(directory, size) ? 0 : 1;
         }else if(arg == "-h" || arg == "-help"){
             help();
             return 0;